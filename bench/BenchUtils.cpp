@@ -0,0 +1,178 @@
+
+#include "BenchUtils.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include <yaml-cpp/yaml.h>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "libvideoio/ThreadPool.h"
+
+#include "test_files.h"
+
+namespace libvideoio {
+namespace bench {
+
+  const FrameSize FrameSizes[] = {
+    { "VGA",       640,  480 },
+    { "1080p",     1920, 1080 },
+    { "2048x1536", 2048, 1536 }
+  };
+
+  const int NumFrameSizes = sizeof(FrameSizes) / sizeof(FrameSizes[0]);
+
+  ImageSize frameSize( int index )
+  {
+    CHECK( index >= 0 && index < NumFrameSizes ) << "No frame size " << index;
+    return ImageSize( FrameSizes[index].width, FrameSizes[index].height );
+  }
+
+  void AllSizes( benchmark::internal::Benchmark *b )
+  {
+    b->ArgName( "size" );
+    for( int s = 0; s < NumFrameSizes; ++s ) b->Arg( s );
+  }
+
+  void AllSizesAndThreads( benchmark::internal::Benchmark *b )
+  {
+    const int maxThreads = ThreadPool::global().numWorkers() + 1;
+
+    b->ArgNames( { "size", "threads" } );
+    for( int s = 0; s < NumFrameSizes; ++s ) {
+      int t = 1;
+      for( ; t < maxThreads; t *= 2 ) b->Args( { s, t } );
+      b->Args( { s, maxThreads } );
+    }
+  }
+
+  static cv::Mat yamlMatrix( const YAML::Node &node, int rows, int cols )
+  {
+    const YAML::Node data( node["data"] );
+    CHECK( (int)data.size() == rows * cols ) << "Expected a " << rows << " x " << cols << " matrix";
+
+    cv::Mat m( rows, cols, CV_64F );
+    for( int i = 0; i < rows * cols; ++i ) m.at<double>( i / cols, i % cols ) = data[i].as<double>();
+    return m;
+  }
+
+  std::shared_ptr<OpenCVUndistorter> rosUndistorter( const ImageSize &size,
+                                                     const std::shared_ptr<Undistorter> &wrap )
+  {
+    const YAML::Node yaml( YAML::LoadFile( ROS_YAML ) );
+    const double sx = (double)size.width / yaml["image_width"].as<int>();
+    const double sy = (double)size.height / yaml["image_height"].as<int>();
+
+    cv::Mat k( yamlMatrix( yaml["camera_matrix"], 3, 3 ) );
+    cv::Mat projection( yamlMatrix( yaml["projection_matrix"], 3, 4 ) );
+    const cv::Mat distortion( yamlMatrix( yaml["distortion_coefficients"], 1, 5 ) );
+    const cv::Mat rectification( yamlMatrix( yaml["rectification_matrix"], 3, 3 ) );
+
+    // Pixel coordinates scale about the corner of the image
+    k.row(0) *= sx;
+    k.row(1) *= sy;
+    projection.row(0) *= sx;
+    projection.row(1) *= sy;
+
+    return std::make_shared<OpenCVUndistorter>( k, projection, rectification, distortion, size, wrap );
+  }
+
+  std::shared_ptr<PTAMUndistorter> ptamUndistorter( const ImageSize &size )
+  {
+    // The PTAM intrinsics are fractions of the image size
+    std::ifstream legacy( PTAM_LEGACY );
+    float fx, fy, cx, cy;
+    CHECK( legacy >> fx >> fy >> cx >> cy ) << "Unable to read " << PTAM_LEGACY;
+
+    const boost::filesystem::path config( scratchDirectory() /
+                                          boost::filesystem::unique_path( "ptam-%%%%-%%%%.txt" ) );
+    {
+      std::ofstream out( config.string() );
+      out << fx << " " << fy << " " << cx << " " << cy << " 0.9\n"
+          << size.width << " " << size.height << "\n"
+          << "crop\n"
+          << size.width << " " << size.height << "\n";
+    }
+
+    std::shared_ptr<PTAMUndistorter> undistorter( new PTAMUndistorter( config.string().c_str() ) );
+    boost::filesystem::remove( config );
+
+    CHECK( undistorter->isValid() ) << "Invalid PTAM configuration";
+    return undistorter;
+  }
+
+  cv::Mat randomImage( const ImageSize &size, int type )
+  {
+    cv::Mat image( size(), type );
+    cv::randu( image, cv::Scalar::all(0), cv::Scalar::all(255) );
+    return image;
+  }
+
+  cv::Mat syntheticFrame( const ImageSize &size, int index )
+  {
+    cv::Mat frame( size(), CV_8UC3 );
+    for( int y = 0; y < frame.rows; ++y ) {
+      cv::Vec3b *row = frame.ptr<cv::Vec3b>(y);
+      for( int x = 0; x < frame.cols; ++x )
+        row[x] = cv::Vec3b( x * 255 / frame.cols, y * 255 / frame.rows, (x + y + 4*index) & 0xFF );
+    }
+
+    const int radius = std::max( 4, size.height / 8 );
+    for( int i = 0; i < 6; ++i ) {
+      const cv::Point centre( (size.width * (i+1) / 7 + 8*index*(i+1)) % size.width,
+                              (size.height * ((i*3) % 6 + 1) / 7 + 4*index) % size.height );
+      cv::circle( frame, centre, radius, cv::Scalar( 40*i, 255 - 40*i, 128 ), -1 );
+    }
+
+    cv::Mat noise( frame.size(), CV_8UC3 );
+    cv::RNG rng( index );
+    rng.fill( noise, cv::RNG::UNIFORM, cv::Scalar::all(0), cv::Scalar::all(8) );
+    return frame + noise;
+  }
+
+  static boost::filesystem::path ScratchDirectory;
+
+  const boost::filesystem::path &scratchDirectory()
+  {
+    if( ScratchDirectory.empty() ) {
+      ScratchDirectory = boost::filesystem::temp_directory_path() /
+                         boost::filesystem::unique_path( "videoio-bench-%%%%-%%%%" );
+      boost::filesystem::create_directories( ScratchDirectory );
+    }
+
+    return ScratchDirectory;
+  }
+
+  void removeScratchDirectory()
+  {
+    if( ScratchDirectory.empty() ) return;
+
+    boost::system::error_code ec;
+    boost::filesystem::remove_all( ScratchDirectory, ec );
+    ScratchDirectory.clear();
+  }
+
+  void setFrameCounters( benchmark::State &state, const ImageSize &size )
+  {
+    const double frames = state.iterations();
+
+    state.SetItemsProcessed( state.iterations() );
+    state.counters["Mpix/s"] = benchmark::Counter( frames * size.width * size.height / 1e6, benchmark::Counter::kIsRate );
+  }
+
+  ScopedNumThreads::ScopedNumThreads( int n )
+    : _previous( Undistorter::defaultNumThreads() )
+  {
+    Undistorter::setDefaultNumThreads( n );
+  }
+
+  ScopedNumThreads::~ScopedNumThreads()
+  {
+    Undistorter::setDefaultNumThreads( _previous );
+  }
+
+}
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <memory>
+
+#include <benchmark/benchmark.h>
+
+#include <boost/filesystem.hpp>
+
+#include "libvideoio/Undistorter.h"
+
+// Shared setup for the benchmarks:  calibrations scaled to the benchmark
+// frame sizes, test frames and the per-frame counters.
+
+namespace libvideoio {
+namespace bench {
+
+  struct FrameSize {
+    const char *name;
+    int width, height;
+  };
+
+  // VGA, 1080p and the native size of the ROS calibration (2048x1536)
+  extern const FrameSize FrameSizes[];
+  extern const int NumFrameSizes;
+
+  ImageSize frameSize( int index );
+
+  // Registers every frame size ("size" argument)
+  void AllSizes( benchmark::internal::Benchmark *b );
+
+  // Registers every frame size with 1, 2, 4 ... threads up to one per
+  // ThreadPool worker plus the caller ("size", "threads" arguments)
+  void AllSizesAndThreads( benchmark::internal::Benchmark *b );
+
+  // OpenCVUndistorter for the ROS calibration in the test data, with the
+  // camera and projection matrices scaled to size
+  std::shared_ptr<OpenCVUndistorter> rosUndistorter( const ImageSize &size,
+                                                     const std::shared_ptr<Undistorter> &wrap = nullptr );
+
+  // PTAMUndistorter with the intrinsics of the legacy PTAM test file, an
+  // ATAN distortion of w = 0.9 (the test file has none, which is passed
+  // through) and "crop" output, for input and output of the given size
+  std::shared_ptr<PTAMUndistorter> ptamUndistorter( const ImageSize &size );
+
+  // Uniform noise, so no kernel benefits from flat regions
+  cv::Mat randomImage( const ImageSize &size, int type );
+
+  // Deterministic 8UC3 frame `index` of a sequence:  gradients and moving
+  // discs with a little noise, so encoders see realistic content and
+  // successive video frames differ
+  cv::Mat syntheticFrame( const ImageSize &size, int index );
+
+  // Scratch directory for generated inputs and outputs, created on first
+  // use.  main() removes it after the run.
+  const boost::filesystem::path &scratchDirectory();
+  void removeScratchDirectory();
+
+  // Reports frames/s (items_per_second) and Mpix/s for frames of the
+  // given size, one frame per iteration.  With UseRealTime() the time
+  // column is wall-clock ns per frame.
+  void setFrameCounters( benchmark::State &state, const ImageSize &size );
+
+  // Undistorter::setDefaultNumThreads() for the lifetime of the object
+  class ScopedNumThreads {
+  public:
+    explicit ScopedNumThreads( int n );
+    ~ScopedNumThreads();
+
+  private:
+    int _previous;
+  };
+
+}
+}
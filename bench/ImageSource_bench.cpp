@@ -0,0 +1,374 @@
+
+#include "BenchUtils.h"
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "libvideoio/ImageSource.h"
+#include "libvideoio/ParallelVideoSource.h"
+#include "libvideoio/PrefetchingSource.h"
+
+using namespace libvideoio;
+using namespace libvideoio::bench;
+
+namespace fs = boost::filesystem;
+
+// Input throughput, end to end and broken into stages:
+//
+//   FileRead      open/read/close of the encoded file (syscalls;  the
+//                 page cache is warm, so this excludes the disk)
+//   Decode        cv::imdecode from memory
+//   Conversion    BGR to gray and 8U to 32F, as fed to most trackers
+//   VideoGrab     demux and decode of the next video frame
+//   VideoRetrieve conversion of the decoded frame to BGR
+//
+// Bytes/s counts encoded bytes for file and decode stages and decoded
+// bytes for conversions.
+
+static const int NumFiles = 16;
+static const int NumVideoFrames = 60;
+
+// NumFiles frames of the given size written as `ext` (".png", ".jpg" or
+// ".pgm", uncompressed), generated once per process
+static const std::vector<fs::path> &imageFiles( const std::string &ext, const ImageSize &size )
+{
+  static std::map< std::string, std::vector<fs::path> > files;
+
+  std::vector<fs::path> &paths( files[ ext + std::to_string(size.width) + "x" + std::to_string(size.height) ] );
+  if( paths.empty() ) {
+    const fs::path dir( scratchDirectory() / ( "images" + ext.substr(1) + std::to_string(size.width) ) );
+    fs::create_directories( dir );
+
+    for( int i = 0; i < NumFiles; ++i ) {
+      cv::Mat frame( syntheticFrame( size, i ) ), gray;
+      cv::cvtColor( frame, gray, cv::COLOR_BGR2GRAY );
+
+      char name[32];
+      snprintf( name, sizeof(name), "%04d%s", i, ext.c_str() );
+      paths.push_back( dir / name );
+      cv::imwrite( paths.back().string(), gray );
+    }
+  }
+
+  return paths;
+}
+
+// NumVideoFrames-frame clip with the given fourcc, or an empty path if
+// the OpenCV build has no encoder for it
+static fs::path videoFile( const std::string &fourcc, const std::string &ext, const ImageSize &size )
+{
+  static std::map< std::string, fs::path > files;
+
+  const std::string key( fourcc + std::to_string(size.width) + "x" + std::to_string(size.height) );
+  if( files.count( key ) ) return files[key];
+
+  const fs::path path( scratchDirectory() / ( key + ext ) );
+  cv::VideoWriter writer( path.string(), cv::VideoWriter::fourcc( fourcc[0], fourcc[1], fourcc[2], fourcc[3] ),
+                          30, size() );
+
+  if( writer.isOpened() ) {
+    for( int i = 0; i < NumVideoFrames; ++i ) writer.write( syntheticFrame( size, i ) );
+    writer.release();
+    files[key] = path;
+  } else {
+    files[key] = fs::path();
+  }
+
+  return files[key];
+}
+
+static std::vector<char> readFile( const fs::path &path )
+{
+  std::ifstream in( path.string(), std::ios::binary );
+  return std::vector<char>( std::istreambuf_iterator<char>( in ), std::istreambuf_iterator<char>() );
+}
+
+//==== Image files ====
+
+static void BM_FileRead( benchmark::State &state, const std::string &ext )
+{
+  const ImageSize size( frameSize( state.range(0) ) );
+  state.SetLabel( FrameSizes[state.range(0)].name );
+
+  const std::vector<fs::path> &paths( imageFiles( ext, size ) );
+  size_t bytes = 0;
+  int i = 0;
+
+  for( auto _ : state ) {
+    const std::vector<char> data( readFile( paths[ i++ % NumFiles ] ) );
+    bytes += data.size();
+    benchmark::DoNotOptimize( data.data() );
+  }
+
+  state.SetBytesProcessed( bytes );
+  setFrameCounters( state, size );
+}
+BENCHMARK_CAPTURE( BM_FileRead, png, std::string(".png") )->Apply( AllSizes );
+BENCHMARK_CAPTURE( BM_FileRead, jpeg, std::string(".jpg") )->Apply( AllSizes );
+BENCHMARK_CAPTURE( BM_FileRead, raw, std::string(".pgm") )->Apply( AllSizes );
+
+static void BM_Decode( benchmark::State &state, const std::string &ext )
+{
+  const ImageSize size( frameSize( state.range(0) ) );
+  state.SetLabel( FrameSizes[state.range(0)].name );
+
+  std::vector< std::vector<char> > encoded;
+  for( const fs::path &path : imageFiles( ext, size ) ) encoded.push_back( readFile( path ) );
+
+  size_t bytes = 0;
+  int i = 0;
+  cv::Mat image;
+
+  for( auto _ : state ) {
+    const std::vector<char> &data( encoded[ i++ % NumFiles ] );
+    image = cv::imdecode( data, cv::IMREAD_GRAYSCALE );
+    bytes += data.size();
+    benchmark::DoNotOptimize( image.data );
+  }
+
+  state.SetBytesProcessed( bytes );
+  setFrameCounters( state, size );
+}
+BENCHMARK_CAPTURE( BM_Decode, png, std::string(".png") )->Apply( AllSizes );
+BENCHMARK_CAPTURE( BM_Decode, jpeg, std::string(".jpg") )->Apply( AllSizes );
+BENCHMARK_CAPTURE( BM_Decode, raw, std::string(".pgm") )->Apply( AllSizes );
+
+// ImageFilesSource::grab() and getImage(), i.e. read and decode
+static void BM_ImageFilesSource( benchmark::State &state, const std::string &ext )
+{
+  const ImageSize size( frameSize( state.range(0) ) );
+  state.SetLabel( FrameSizes[state.range(0)].name );
+
+  const std::vector<fs::path> &paths( imageFiles( ext, size ) );
+  size_t bytes = 0;
+  for( const fs::path &path : paths ) bytes += fs::file_size( path );
+
+  std::unique_ptr<ImageFilesSource> source( new ImageFilesSource( paths ) );
+  cv::Mat image;
+
+  for( auto _ : state ) {
+    if( !source->grab() ) {
+      state.PauseTiming();
+      source.reset( new ImageFilesSource( paths ) );
+      source->grab();
+      state.ResumeTiming();
+    }
+
+    source->getImage( image );
+    benchmark::DoNotOptimize( image.data );
+  }
+
+  state.SetBytesProcessed( state.iterations() * bytes / NumFiles );
+  setFrameCounters( state, size );
+}
+BENCHMARK_CAPTURE( BM_ImageFilesSource, png, std::string(".png") )->Apply( AllSizes );
+BENCHMARK_CAPTURE( BM_ImageFilesSource, jpeg, std::string(".jpg") )->Apply( AllSizes );
+BENCHMARK_CAPTURE( BM_ImageFilesSource, raw, std::string(".pgm") )->Apply( AllSizes );
+
+// As BM_ImageFilesSource with decoding on a PrefetchingSource thread, so
+// the consumer only waits when it outpaces a single decoder
+static void BM_PrefetchingImageFilesSource( benchmark::State &state, const std::string &ext )
+{
+  const ImageSize size( frameSize( state.range(0) ) );
+  state.SetLabel( FrameSizes[state.range(0)].name );
+
+  const std::vector<fs::path> &paths( imageFiles( ext, size ) );
+  size_t bytes = 0;
+  for( const fs::path &path : paths ) bytes += fs::file_size( path );
+
+  std::unique_ptr<PrefetchingSource> source( new PrefetchingSource( std::make_shared<ImageFilesSource>( paths ) ) );
+  cv::Mat image;
+
+  for( auto _ : state ) {
+    if( !source->grab() ) {
+      state.PauseTiming();
+      source.reset( new PrefetchingSource( std::make_shared<ImageFilesSource>( paths ) ) );
+      source->grab();
+      state.ResumeTiming();
+    }
+
+    source->getImage( image );
+    benchmark::DoNotOptimize( image.data );
+  }
+
+  state.SetBytesProcessed( state.iterations() * bytes / NumFiles );
+  setFrameCounters( state, size );
+}
+BENCHMARK_CAPTURE( BM_PrefetchingImageFilesSource, png, std::string(".png") )->Apply( AllSizes )->UseRealTime();
+BENCHMARK_CAPTURE( BM_PrefetchingImageFilesSource, jpeg, std::string(".jpg") )->Apply( AllSizes )->UseRealTime();
+
+static void BM_Conversion( benchmark::State &state )
+{
+  const ImageSize size( frameSize( state.range(0) ) );
+  state.SetLabel( FrameSizes[state.range(0)].name );
+
+  const cv::Mat frame( syntheticFrame( size, 0 ) );
+  cv::Mat gray, grayF;
+
+  for( auto _ : state ) {
+    cv::cvtColor( frame, gray, cv::COLOR_BGR2GRAY );
+    gray.convertTo( grayF, CV_32F, 1.0/255 );
+    benchmark::DoNotOptimize( grayF.data );
+  }
+
+  state.SetBytesProcessed( state.iterations() * frame.total() * frame.elemSize() );
+  setFrameCounters( state, size );
+}
+BENCHMARK( BM_Conversion )->Apply( AllSizes );
+
+//==== Video ====
+
+// Opens the clip, or skips the benchmark if it couldn't be generated
+static bool openClip( benchmark::State &state, const std::string &fourcc, const std::string &ext,
+                      std::unique_ptr<VideoSource> &source, size_t &bytesPerFrame )
+{
+  const ImageSize size( frameSize( state.range(0) ) );
+  state.SetLabel( FrameSizes[state.range(0)].name );
+
+  const fs::path clip( videoFile( fourcc, ext, size ) );
+  if( clip.empty() ) {
+    state.SkipWithError( ( "No " + fourcc + " encoder in this OpenCV build" ).c_str() );
+    return false;
+  }
+
+  source.reset( new VideoSource( clip.string() ) );
+  if( !source->isOpened() ) {
+    state.SkipWithError( ( "Unable to decode " + fourcc ).c_str() );
+    return false;
+  }
+
+  bytesPerFrame = fs::file_size( clip ) / NumVideoFrames;
+  return true;
+}
+
+// Rewinds at the end of the clip, outside the timed region
+static void nextFrame( benchmark::State &state, VideoSource &source )
+{
+  if( source.frameNum() >= NumVideoFrames ) {
+    state.PauseTiming();
+    source.skipTo( 0 );
+    state.ResumeTiming();
+  }
+
+  source.grab();
+}
+
+static void BM_VideoGrab( benchmark::State &state, const std::string &fourcc, const std::string &ext )
+{
+  std::unique_ptr<VideoSource> source;
+  size_t bytesPerFrame;
+  if( !openClip( state, fourcc, ext, source, bytesPerFrame ) ) return;
+
+  for( auto _ : state ) nextFrame( state, *source );
+
+  state.SetBytesProcessed( state.iterations() * bytesPerFrame );
+  setFrameCounters( state, frameSize( state.range(0) ) );
+}
+BENCHMARK_CAPTURE( BM_VideoGrab, h264, std::string("avc1"), std::string(".mp4") )->Apply( AllSizes );
+BENCHMARK_CAPTURE( BM_VideoGrab, mjpeg, std::string("MJPG"), std::string(".avi") )->Apply( AllSizes );
+
+// Converts the same decoded frame repeatedly
+static void BM_VideoRetrieve( benchmark::State &state, const std::string &fourcc, const std::string &ext )
+{
+  std::unique_ptr<VideoSource> source;
+  size_t bytesPerFrame;
+  if( !openClip( state, fourcc, ext, source, bytesPerFrame ) ) return;
+
+  source->grab();
+  cv::Mat image;
+
+  for( auto _ : state ) {
+    source->getRawImage( 0, image );
+    benchmark::DoNotOptimize( image.data );
+  }
+
+  state.SetBytesProcessed( state.iterations() * image.total() * image.elemSize() );
+  setFrameCounters( state, frameSize( state.range(0) ) );
+}
+BENCHMARK_CAPTURE( BM_VideoRetrieve, h264, std::string("avc1"), std::string(".mp4") )->Apply( AllSizes );
+BENCHMARK_CAPTURE( BM_VideoRetrieve, mjpeg, std::string("MJPG"), std::string(".avi") )->Apply( AllSizes );
+
+static void BM_VideoSource( benchmark::State &state, const std::string &fourcc, const std::string &ext )
+{
+  std::unique_ptr<VideoSource> source;
+  size_t bytesPerFrame;
+  if( !openClip( state, fourcc, ext, source, bytesPerFrame ) ) return;
+
+  cv::Mat image;
+
+  for( auto _ : state ) {
+    nextFrame( state, *source );
+    source->getImage( image );
+    benchmark::DoNotOptimize( image.data );
+  }
+
+  state.SetBytesProcessed( state.iterations() * bytesPerFrame );
+  setFrameCounters( state, frameSize( state.range(0) ) );
+}
+BENCHMARK_CAPTURE( BM_VideoSource, h264, std::string("avc1"), std::string(".mp4") )->Apply( AllSizes );
+BENCHMARK_CAPTURE( BM_VideoSource, mjpeg, std::string("MJPG"), std::string(".avi") )->Apply( AllSizes );
+
+// In-order frames from a ParallelVideoSource with `threads` workers, each
+// decoding one chunk of the clip
+static void BM_ParallelVideoSource( benchmark::State &state, const std::string &fourcc, const std::string &ext )
+{
+  std::unique_ptr<VideoSource> probe;
+  size_t bytesPerFrame;
+  if( !openClip( state, fourcc, ext, probe, bytesPerFrame ) ) return;
+
+  // Indexes the clip once, outside the timed region
+  probe->useIndex();
+
+  const std::string clip( videoFile( fourcc, ext, frameSize( state.range(0) ) ).string() );
+  const int workers = state.range(1);
+  const int chunkFrames = std::max( 1, NumVideoFrames / workers );
+
+  std::unique_ptr<ParallelVideoSource> source( new ParallelVideoSource( clip, workers, chunkFrames ) );
+  cv::Mat image;
+
+  for( auto _ : state ) {
+    if( !source->grab() ) {
+      state.PauseTiming();
+      source.reset( new ParallelVideoSource( clip, workers, chunkFrames ) );
+      source->grab();
+      state.ResumeTiming();
+    }
+
+    source->getImage( image );
+    benchmark::DoNotOptimize( image.data );
+  }
+
+  state.SetBytesProcessed( state.iterations() * bytesPerFrame );
+  setFrameCounters( state, frameSize( state.range(0) ) );
+}
+BENCHMARK_CAPTURE( BM_ParallelVideoSource, h264, std::string("avc1"), std::string(".mp4") )->Apply( AllSizesAndThreads )->UseRealTime();
+BENCHMARK_CAPTURE( BM_ParallelVideoSource, mjpeg, std::string("MJPG"), std::string(".avi") )->Apply( AllSizesAndThreads )->UseRealTime();
+
+// The whole clip per iteration through ParallelVideoSource::forEachFrame()
+static void BM_ParallelVideoForEachFrame( benchmark::State &state, const std::string &fourcc, const std::string &ext )
+{
+  std::unique_ptr<VideoSource> probe;
+  size_t bytesPerFrame;
+  if( !openClip( state, fourcc, ext, probe, bytesPerFrame ) ) return;
+  probe->useIndex();
+
+  const ImageSize size( frameSize( state.range(0) ) );
+  const std::string clip( videoFile( fourcc, ext, size ).string() );
+
+  for( auto _ : state ) {
+    ParallelVideoSource::forEachFrame( clip, []( int, const cv::Mat &image ) {
+      benchmark::DoNotOptimize( image.data );
+    }, state.range(1) );
+  }
+
+  const double frames = double(state.iterations()) * NumVideoFrames;
+  state.SetBytesProcessed( state.iterations() * bytesPerFrame * NumVideoFrames );
+  state.SetItemsProcessed( frames );
+  state.counters["Mpix/s"] = benchmark::Counter( frames * size.width * size.height / 1e6, benchmark::Counter::kIsRate );
+}
+BENCHMARK_CAPTURE( BM_ParallelVideoForEachFrame, h264, std::string("avc1"), std::string(".mp4") )->Apply( AllSizesAndThreads )->UseRealTime();
+BENCHMARK_CAPTURE( BM_ParallelVideoForEachFrame, mjpeg, std::string("MJPG"), std::string(".avi") )->Apply( AllSizesAndThreads )->UseRealTime();
@@ -0,0 +1,141 @@
+
+#include "BenchUtils.h"
+
+#include <fstream>
+
+#include <opencv2/highgui/highgui.hpp>
+
+#include "libvideoio/ImageOutput.h"
+#include "libvideoio/VideoOutput.h"
+
+using namespace libvideoio;
+using namespace libvideoio::bench;
+
+namespace fs = boost::filesystem;
+
+// Output throughput, end to end and broken into stages:
+//
+//   Encode        cv::imencode to memory
+//   FileWrite     open/write/close of the encoded bytes (syscalls;  the
+//                 page cache absorbs the write, so this excludes the disk)
+//
+// Bytes/s counts encoded bytes.  Outputs cycle over NumFrames file names,
+// so the scratch directory stays small.
+
+static const int NumFrames = 16;
+
+static std::vector<cv::Mat> outputFrames( const ImageSize &size )
+{
+  std::vector<cv::Mat> frames;
+  for( int i = 0; i < NumFrames; ++i ) frames.push_back( syntheticFrame( size, i ) );
+  return frames;
+}
+
+static void BM_Encode( benchmark::State &state, const std::string &ext )
+{
+  const ImageSize size( frameSize( state.range(0) ) );
+  state.SetLabel( FrameSizes[state.range(0)].name );
+
+  const std::vector<cv::Mat> frames( outputFrames( size ) );
+  std::vector<uchar> encoded;
+  size_t bytes = 0;
+  int i = 0;
+
+  for( auto _ : state ) {
+    cv::imencode( ext, frames[ i++ % NumFrames ], encoded );
+    bytes += encoded.size();
+  }
+
+  state.SetBytesProcessed( bytes );
+  setFrameCounters( state, size );
+}
+BENCHMARK_CAPTURE( BM_Encode, png, std::string(".png") )->Apply( AllSizes );
+BENCHMARK_CAPTURE( BM_Encode, jpeg, std::string(".jpg") )->Apply( AllSizes );
+
+static void BM_FileWrite( benchmark::State &state, const std::string &ext )
+{
+  const ImageSize size( frameSize( state.range(0) ) );
+  state.SetLabel( FrameSizes[state.range(0)].name );
+
+  std::vector<uchar> encoded;
+  cv::imencode( ext, syntheticFrame( size, 0 ), encoded );
+
+  const fs::path dir( scratchDirectory() / "write" );
+  fs::create_directories( dir );
+  int i = 0;
+
+  for( auto _ : state ) {
+    const fs::path path( dir / ( std::to_string( i++ % NumFrames ) + ext ) );
+    std::ofstream out( path.string(), std::ios::binary );
+    out.write( reinterpret_cast<const char *>( encoded.data() ), encoded.size() );
+  }
+
+  state.SetBytesProcessed( state.iterations() * encoded.size() );
+  setFrameCounters( state, size );
+}
+BENCHMARK_CAPTURE( BM_FileWrite, png, std::string(".png") )->Apply( AllSizes );
+BENCHMARK_CAPTURE( BM_FileWrite, jpeg, std::string(".jpg") )->Apply( AllSizes );
+
+// ImageOutput::write(), i.e. PNG encode and write
+static void BM_ImageOutput( benchmark::State &state )
+{
+  const ImageSize size( frameSize( state.range(0) ) );
+  state.SetLabel( FrameSizes[state.range(0)].name );
+
+  const std::vector<cv::Mat> frames( outputFrames( size ) );
+  const fs::path dir( scratchDirectory() / "ImageOutput" );
+
+  ImageOutput output( dir.string() );
+  output.registerField( 0, "bench" );
+  int i = 0;
+
+  for( auto _ : state ) {
+    const int frame = i++ % NumFrames;
+    output.write( 0, frames[frame], frame );
+  }
+
+  size_t bytes = 0;
+  for( fs::directory_iterator it( dir ), end; it != end; ++it ) bytes += fs::file_size( it->path() );
+
+  state.SetBytesProcessed( state.iterations() * bytes / NumFrames );
+  setFrameCounters( state, size );
+}
+BENCHMARK( BM_ImageOutput )->Apply( AllSizes );
+
+// VideoOutput::write(), i.e. encode and mux.  Frames still buffered by
+// the encoder are flushed after the timed loop, which is negligible over
+// a full run.
+static void BM_VideoOutput( benchmark::State &state, const std::string &fourcc, const std::string &ext )
+{
+  const ImageSize size( frameSize( state.range(0) ) );
+  state.SetLabel( FrameSizes[state.range(0)].name );
+
+  const fs::path path( scratchDirectory() / ( "VideoOutput-" + fourcc + ext ) );
+
+  // VideoOutput treats a missing encoder as fatal
+  {
+    cv::VideoWriter probe( path.string(), cv::VideoWriter::fourcc( fourcc[0], fourcc[1], fourcc[2], fourcc[3] ),
+                           30, size() );
+    if( !probe.isOpened() ) {
+      state.SkipWithError( ( "No " + fourcc + " encoder in this OpenCV build" ).c_str() );
+      return;
+    }
+  }
+
+  const std::vector<cv::Mat> frames( outputFrames( size ) );
+  std::unique_ptr<VideoOutput> output( new VideoOutput( path.string(), 30, fourcc ) );
+
+  // The writer is opened by the first frame
+  output->write( frames[0] );
+  int i = 1;
+
+  for( auto _ : state ) {
+    output->write( frames[ i++ % NumFrames ] );
+  }
+  output.reset();
+
+  state.SetBytesProcessed( state.iterations() * fs::file_size( path ) / i );
+  setFrameCounters( state, size );
+}
+BENCHMARK_CAPTURE( BM_VideoOutput, h264, std::string("avc1"), std::string(".mp4") )->Apply( AllSizes );
+BENCHMARK_CAPTURE( BM_VideoOutput, mjpeg, std::string("MJPG"), std::string(".avi") )->Apply( AllSizes );
@@ -0,0 +1,136 @@
+
+#include "BenchUtils.h"
+
+using namespace libvideoio;
+using namespace libvideoio::bench;
+
+// Frame benchmarks take (size, threads) arguments and undistort one
+// 8UC3 frame per iteration into a reused output buffer.
+
+static void runUndistort( benchmark::State &state, const Undistorter &undistorter, const ImageSize &size )
+{
+  const ScopedNumThreads threads( state.range(1) );
+  const cv::Mat image( randomImage( size, CV_8UC3 ) );
+  cv::Mat result;
+
+  undistorter.prepare();
+
+  for( auto _ : state ) {
+    undistorter.undistort( image, result );
+    benchmark::DoNotOptimize( result.data );
+  }
+
+  setFrameCounters( state, size );
+}
+
+static void BM_OpenCVUndistorter( benchmark::State &state )
+{
+  const ImageSize size( frameSize( state.range(0) ) );
+  state.SetLabel( FrameSizes[state.range(0)].name );
+
+  runUndistort( state, *rosUndistorter( size ), size );
+}
+BENCHMARK( BM_OpenCVUndistorter )->Apply( AllSizesAndThreads )->UseRealTime();
+
+static void BM_PTAMUndistorter( benchmark::State &state )
+{
+  const ImageSize size( frameSize( state.range(0) ) );
+  state.SetLabel( FrameSizes[state.range(0)].name );
+
+  runUndistort( state, *ptamUndistorter( size ), size );
+}
+BENCHMARK( BM_PTAMUndistorter )->Apply( AllSizesAndThreads )->UseRealTime();
+
+// Undistort, then crop the central half of each axis
+static void BM_CroppedOpenCV( benchmark::State &state )
+{
+  const ImageSize size( frameSize( state.range(0) ) );
+  state.SetLabel( FrameSizes[state.range(0)].name );
+
+  const ImageCropper cropper( size.width/2, size.height/2, size.width/4, size.height/4,
+                              rosUndistorter( size ) );
+  runUndistort( state, cropper, size );
+}
+BENCHMARK( BM_CroppedOpenCV )->Apply( AllSizesAndThreads )->UseRealTime();
+
+// Undistort, then resize to half size
+static void BM_ResizedOpenCV( benchmark::State &state )
+{
+  const ImageSize size( frameSize( state.range(0) ) );
+  state.SetLabel( FrameSizes[state.range(0)].name );
+
+  const ImageResizer resizer( size.width/2, size.height/2, rosUndistorter( size ) );
+  runUndistort( state, resizer, size );
+}
+BENCHMARK( BM_ResizedOpenCV )->Apply( AllSizesAndThreads )->UseRealTime();
+
+// The resize chain collapsed into a single remap
+static void BM_CompiledResizedOpenCV( benchmark::State &state )
+{
+  const ImageSize size( frameSize( state.range(0) ) );
+  state.SetLabel( FrameSizes[state.range(0)].name );
+
+  std::shared_ptr<Undistorter> chain( new ImageResizer( size.width/2, size.height/2, rosUndistorter( size ) ) );
+  std::unique_ptr<CompiledUndistorter> compiled( CompiledUndistorter::compile( chain ) );
+  if( !compiled ) {
+    state.SkipWithError( "Chain can't be compiled" );
+    return;
+  }
+
+  runUndistort( state, *compiled, size );
+}
+BENCHMARK( BM_CompiledResizedOpenCV )->Apply( AllSizesAndThreads )->UseRealTime();
+
+//==== Map construction ====
+//
+// One undistorter built per iteration, with the MapCache disabled (see
+// main.cpp).  Map builders use the global ThreadPool internally.
+
+static void BM_OpenCVMapBuild( benchmark::State &state )
+{
+  const ImageSize size( frameSize( state.range(0) ) );
+  state.SetLabel( FrameSizes[state.range(0)].name );
+
+  const Undistorter::MapBuildPolicy policy( Undistorter::defaultMapBuildPolicy() );
+  Undistorter::setDefaultMapBuildPolicy( Undistorter::BuildMapsEagerly );
+
+  for( auto _ : state ) {
+    std::shared_ptr<OpenCVUndistorter> undistorter( rosUndistorter( size ) );
+    benchmark::DoNotOptimize( undistorter.get() );
+  }
+
+  Undistorter::setDefaultMapBuildPolicy( policy );
+  setFrameCounters( state, size );
+}
+BENCHMARK( BM_OpenCVMapBuild )->Apply( AllSizes )->UseRealTime()->Unit( benchmark::kMillisecond );
+
+static void BM_PTAMMapBuild( benchmark::State &state )
+{
+  const ImageSize size( frameSize( state.range(0) ) );
+  state.SetLabel( FrameSizes[state.range(0)].name );
+
+  for( auto _ : state ) {
+    std::shared_ptr<PTAMUndistorter> undistorter( ptamUndistorter( size ) );
+    benchmark::DoNotOptimize( undistorter.get() );
+  }
+
+  setFrameCounters( state, size );
+}
+BENCHMARK( BM_PTAMMapBuild )->Apply( AllSizes )->UseRealTime()->Unit( benchmark::kMillisecond );
+
+static void BM_CompileChain( benchmark::State &state )
+{
+  const ImageSize size( frameSize( state.range(0) ) );
+  state.SetLabel( FrameSizes[state.range(0)].name );
+
+  std::shared_ptr<Undistorter> chain( new ImageResizer( size.width/2, size.height/2, rosUndistorter( size ) ) );
+  chain->prepare();
+
+  for( auto _ : state ) {
+    std::unique_ptr<CompiledUndistorter> compiled( CompiledUndistorter::compile( chain ) );
+    benchmark::DoNotOptimize( compiled.get() );
+  }
+
+  setFrameCounters( state, size );
+}
+BENCHMARK( BM_CompileChain )->Apply( AllSizes )->UseRealTime()->Unit( benchmark::kMillisecond );
@@ -0,0 +1,23 @@
+
+#include <benchmark/benchmark.h>
+
+#include <libg3logger/g3logger.h>
+
+#include "libvideoio/MapCache.h"
+
+#include "BenchUtils.h"
+
+int main(int argc, char **argv) {
+  ::benchmark::Initialize(&argc, argv);
+  if( ::benchmark::ReportUnrecognizedArguments(argc, argv) ) return 1;
+
+  libg3logger::G3Logger logWorker( argv[0] );
+
+  // Measure map construction rather than cache hits
+  libvideoio::MapCache::setDirectory( "" );
+
+  ::benchmark::RunSpecifiedBenchmarks();
+
+  libvideoio::bench::removeScratchDirectory();
+  return 0;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <mutex>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+namespace libvideoio {
+
+// Pool of image buffers keyed by size and type, from which per-frame
+// temporaries are drawn so steady-state processing doesn't touch the
+// heap.  acquire() returns a Mat backed by a pooled buffer;  there is no
+// explicit release, the buffer becomes free again once every Mat
+// referencing it has been destroyed or reassigned.
+//
+// When all buffers of the requested size and type are in use and the
+// pool is full, acquire() falls back to a plain allocation.
+class FramePool {
+public:
+
+  static const size_t DefaultMaxBuffers = 32;
+
+  explicit FramePool( size_t maxBuffers = DefaultMaxBuffers );
+
+  FramePool( const FramePool & ) = delete;
+  FramePool &operator=( const FramePool & ) = delete;
+
+  // Returns a Mat of the given size and type with undefined contents
+  cv::Mat acquire( const cv::Size &size, int type );
+  cv::Mat acquire( int rows, int cols, int type ) { return acquire( cv::Size( cols, rows ), type ); }
+
+  // Buffers held by the pool, free or in use
+  size_t size() const;
+
+  // Number of times acquire() had to allocate
+  size_t allocations() const;
+
+  // Drops the pool's references to all buffers;  Mats already acquired
+  // stay valid
+  void clear();
+
+  // Process-wide pool used for libvideoio's own temporaries
+  static FramePool &global();
+
+protected:
+
+  mutable std::mutex _mutex;
+  std::vector<cv::Mat> _buffers;
+  size_t _maxBuffers;
+  size_t _allocations;
+};
+
+}
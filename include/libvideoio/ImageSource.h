@@ -4,6 +4,9 @@
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 
+#include <deque>
+#include <future>
+#include <memory>
 #include <vector>
 
 #include <g3log/g3log.hpp>
@@ -15,6 +18,8 @@ namespace fs = boost::filesystem;
 
 #include "FileUtils.h"
 #include "libvideoio/types/ImageSize.h"
+#include "libvideoio/ThreadPool.h"
+#include "libvideoio/VideoIndex.h"
 
 #include "logger/LogReader.h"
 
@@ -23,6 +28,8 @@ namespace libvideoio {
 
 using namespace cv;
 
+class Undistorter;
+
 class ImageSource {
 public:
   ImageSource( void )
@@ -49,12 +56,19 @@ public:
   virtual int getImage( int i, cv::Mat &mat );
   virtual int getImage( cv::Mat &mat ) { return getImage(0, mat); };
 
+  // As getImage() followed by undistorter.undistort(), but converting to
+  // the output type while undistorting (see
+  // Undistorter::convertAndUndistort()), so the raw frame is read once
+  int getUndistortedImage( int i, cv::Mat &mat, const Undistorter &undistorter );
+
   virtual void getDepth( cv::Mat &mat ) { return; }
 
   float fps( void ) const { return _fps; }
   void setFPS( float f ) { _fps = f; }
 
-  void setOutputType( int type ) { _outputType = type; }
+  // Type getImage() converts frames to, or -1 to return them raw
+  virtual void setOutputType( int type ) { _outputType = type; }
+  int outputType( void ) const { return _outputType; }
 
   virtual int cvtToRGB() { return -1; }
   virtual int cvtToGray() { return -1; }
@@ -67,13 +81,16 @@ protected:
 
   int _outputType;
 
+  // Decode buffer for getImage() when converting to _outputType
+  cv::Mat _raw;
+
 };
 
 
 class ImageFilesSource : public ImageSource {
 public:
   ImageFilesSource( const std::vector<std::string> &paths )
-    : _idx( -1 )
+    : _idx( -1 ), _decodeAhead( 0 )
   {
     for( std::string pathStr : paths ) {
       fs::path p( pathStr );
@@ -89,7 +106,7 @@ public:
   }
 
   ImageFilesSource( const std::vector<fs::path> &paths )
-    : _idx( -1 )
+    : _idx( -1 ), _decodeAhead( 0 )
   {
     for( fs::path p : paths ) {
       if( fs::is_directory( p ) )
@@ -105,24 +122,27 @@ public:
 
   virtual int numFrames( void ) const { return _paths.size(); }
 
+  // Decodes up to `frames` files ahead of the current one on a pool of
+  // decoder threads of the source's own (one per frame, up to one per
+  // hardware thread), so decoding runs on several cores while frames are
+  // still returned in path order.  The global ThreadPool is left to the
+  // undistorters, which would otherwise queue behind the decodes.  At
+  // most `frames` decoded images are held at once.  0 (the default)
+  // decodes each file in getRawImage().
+  void setDecodeAhead( int frames );
+  int decodeAhead( void ) const { return _decodeAhead; }
+
   virtual bool grab( void )
   {
     ++_idx;
 
     if( _idx >= (int)_paths.size() ) return false;
 
+    if( _decodeAhead > 0 ) scheduleDecodes();
     return true;
   }
 
-  virtual int getRawImage( int i, cv::Mat &mat )
-  {
-    if( i != 0 ) return 0;
-
-    if( _idx >= (int)_paths.size() ) return -1;
-
-    mat = cv::imread( _paths[_idx].string(), cv::IMREAD_GRAYSCALE );
-    return _idx;
-  }
+  virtual int getRawImage( int i, cv::Mat &mat );
 
   virtual ImageSize imageSize( void ) const
   {
@@ -131,9 +151,26 @@ public:
 
 protected:
 
+  // Drops decodes of frames already passed and queues those up to
+  // _decodeAhead frames from the current one
+  void scheduleDecodes( void );
+
   std::vector<fs::path> _paths;
   int _idx;
 
+  // Pending decodes in path order.  Tasks own their result, so they
+  // may outlive the source.  A decode is dropped once its image is
+  // handed out, so a caller may modify the image in place.
+  struct Decode {
+    int idx;
+    std::shared_ptr<cv::Mat> image;
+    std::shared_future<void> done;
+  };
+
+  int _decodeAhead;
+  std::deque<Decode> _decodes;
+  std::unique_ptr<ThreadPool> _decoders;
+
 };
 
 class LoggerSource : public ImageSource {
@@ -197,7 +234,11 @@ public:
 
   VideoSource( const std::string &path )
     : _path( path ),
-      _capture( path )
+      _capture( path ),
+      _next( 0 ),
+      _pregrabbed( false ),
+      _frameStep( 1 ),
+      _stepBeforeGrab( false )
   {
        _hasDepth = false;
        _numImages = 1;
@@ -211,31 +252,74 @@ public:
 
 }
 
-  void skipTo( int frame )
+  // Loads the file's VideoIndex, building and saving it on first use,
+  // after which numFrames() is exact and skipTo() lands on exactly the
+  // requested frame.  Building the index decodes the whole file once.
+  // Returns false if the index can't be built.
+  bool useIndex( void );
+
+  // Uses an index already loaded for this file, e.g. shared by several
+  // sources reading the same video
+  void useIndex( const std::shared_ptr<VideoIndex> &index );
+
+  const std::shared_ptr<VideoIndex> &index( void ) const { return _index; }
+
+  // Positions the source so the next grab() reads `frame`.  With an
+  // index, short forward skips decode forward rather than seek, and
+  // seeks are checked against the index and corrected.
+  void skipTo( int frame );
+
+  // Random access:  skipTo( frame ), grab() and getImage( mat ).
+  // Returns false past the end of the video.
+  bool getFrame( int frame, cv::Mat &mat );
+
+  // Makes grab() return every `step`th frame, starting from the current
+  // position, for coarse scans of long videos.  Frames in between are
+  // read with grab() alone, skipping colour conversion, or, with an
+  // index, by seeking when the gap is long enough that it's cheaper.
+  // 1 (the default) returns every frame.
+  void setFrameStep( int step );
+  int frameStep( void ) const { return _frameStep; }
+
+  // Timestamp in ms of the frame last returned by grab(), as reported by
+  // the container
+  double timestamp( void ) const
   {
-    _capture.set( cv::CAP_PROP_POS_FRAMES, frame );
+    cv::VideoCapture &vc( const_cast< cv::VideoCapture &>(_capture) );
+    return vc.get(cv::CAP_PROP_POS_MSEC);
   }
 
   virtual int numFrames( void ) const
   {
+    if( _index ) return _index->numFrames();
+
     cv::VideoCapture &vc( const_cast< cv::VideoCapture &>(_capture) );
     return vc.get(cv::CAP_PROP_FRAME_COUNT);
   }
 
+  // Frame the next grab() reads
   virtual int frameNum( void ) const
   {
+    if( _index ) return _pregrabbed ? _next - 1 : _next;
+
     cv::VideoCapture &vc( const_cast< cv::VideoCapture &>(_capture) );
     return vc.get(cv::CAP_PROP_POS_FRAMES);
   }
 
   virtual bool grab( void )
   {
-    _capture.grab();
+    if( _stepBeforeGrab && !skipStep() ) return false;
+    _stepBeforeGrab = ( _frameStep > 1 );
+
+    // skipTo() may already have read the frame to check its position
+    if( _pregrabbed ) {
+      _pregrabbed = false;
+      return true;
+    }
+
+    if( !_capture.grab() ) return false;
 
-    // ++_idx;
-    //
-    // if( _idx >= _paths.size() ) return false;
-    //
+    ++_next;
     return true;
   }
 
@@ -262,11 +346,29 @@ public:
     return _capture.isOpened();
   }
 
+  // Skips of up to this many frames forward decode rather than seek
+  static const int MaxDecodeForward = 32;
+
 protected:
 
+  // Seeks to frame, checking where the seek landed against the index
+  bool seekExact( int frame );
+
+  // Passes over the frameStep()-1 frames after the last one returned
+  bool skipStep( void );
+
   fs::path _path;
   cv::VideoCapture _capture;
 
+  std::shared_ptr<VideoIndex> _index;
+
+  // Next frame the capture will read, and whether the frame before it
+  // has been read but not yet returned by grab()
+  int _next;
+  bool _pregrabbed;
+
+  int _frameStep;
+  bool _stepBeforeGrab;
 
 };
 
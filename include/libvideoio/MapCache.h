@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+namespace libvideoio {
+
+// On-disk cache of precomputed undistortion maps.
+//
+// Undistorters hash everything their maps depend on (calibration,
+// image sizes, map format) into a Key.  On construction they first try
+// to load() maps for that key and only compute (then store()) them on a
+// miss.  Because the key is derived from the calibration values rather
+// than the calibration file, editing the calibration invalidates the
+// entry automatically.
+//
+// Entries are versioned binary files which are memory-mapped on load,
+// so a hit costs little more than an open() and mmap().  Anything that
+// doesn't match (version, key, truncated file) is treated as a miss
+// and overwritten.
+//
+// The cache is disabled until a directory is set, either with
+// setDirectory() or the LIBVIDEOIO_MAP_CACHE environment variable.
+class MapCache {
+public:
+
+  // Incremented whenever the file layout changes.  Changes to how a
+  // particular map is generated are versioned in that map's Key instead.
+  static const uint32_t FormatVersion = 1;
+
+  class Key {
+  public:
+    // `kind` distinguishes map types with otherwise identical parameters
+    explicit Key( const std::string &kind );
+
+    Key &add( const void *data, size_t bytes );
+    Key &add( const std::string &str );
+    Key &add( int value )     { return add( &value, sizeof(value) ); }
+    Key &add( float value )   { return add( &value, sizeof(value) ); }
+    Key &add( double value )  { return add( &value, sizeof(value) ); }
+
+    // Adds size, type and contents;  an empty Mat is distinguishable
+    // from a missing one
+    Key &add( const cv::Mat &mat );
+
+    uint64_t hash() const { return _hash; }
+
+    // Name of the cache file for this key
+    std::string filename() const;
+
+  protected:
+    uint64_t _hash;
+  };
+
+  // Read-only maps backed by a memory-mapped cache file.  The Mats stay
+  // valid as long as the Maps object (not the Mats themselves) is alive.
+  class Maps {
+  public:
+    ~Maps();
+
+    const std::vector<cv::Mat> &mats() const { return _mats; }
+    const cv::Mat &operator[]( size_t i ) const { return _mats[i]; }
+    size_t size() const { return _mats.size(); }
+
+  protected:
+    friend class MapCache;
+    Maps( void *addr, size_t length ) : _addr(addr), _length(length) {;}
+
+    void *_addr;
+    size_t _length;
+    std::vector<cv::Mat> _mats;
+  };
+
+  // Cache directory, created on first store.  An empty path disables
+  // the cache.
+  static void setDirectory( const std::string &dir );
+  static std::string directory();
+
+  static bool enabled() { return !directory().empty(); }
+
+  // Returns the maps stored for key, or nullptr if the cache is disabled
+  // or has no valid entry.  `count` is the expected number of maps.
+  static std::shared_ptr<const Maps> load( const Key &key, size_t count );
+
+  // Writes maps for key.  Each Mat is stored with its size and type;
+  // continuity is not required.  Returns false (after logging) if the
+  // entry can't be written, which is never fatal.
+  static bool store( const Key &key, const std::vector<cv::Mat> &mats );
+
+  // Removes every entry in the cache directory
+  static void clear();
+
+};
+
+}
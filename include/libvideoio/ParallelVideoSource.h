@@ -0,0 +1,150 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "libvideoio/ImageSource.h"
+#include "libvideoio/VideoIndex.h"
+
+namespace libvideoio {
+
+// Decodes one video file on several threads, each with its own
+// VideoSource, for offline jobs where a single decoder can't keep up.
+// The file's VideoIndex (built on first use, see VideoSource::useIndex())
+// gives the exact frame count and lets every worker seek exactly to the
+// start of its frames.
+//
+// Two ways of using it:
+//
+//  - As an ImageSource, which delivers frames in order.  The video is cut
+//    into chunks of chunkFrames frames, dealt round-robin to the workers,
+//    each of which seeks once per chunk.  Decoded frames waiting for the
+//    consumer are limited to bufferBytes in total, plus a few frames of
+//    the chunk being consumed, whose worker is never held back.  Workers
+//    decode in parallel while the budget lasts, so it should cover
+//    several chunks:  with a small budget, shorten the chunks (down to
+//    the keyframe interval) rather than starve the workers.
+//
+//  - forEachFrame(), which hands each worker one contiguous range of the
+//    file and calls a function on every frame from the workers' threads.
+//    Nothing is buffered and each worker seeks once, so this scales best
+//    when frames can be processed independently.
+//
+// VideoCapture doesn't report which frames are keyframes, so ranges
+// aren't keyframe-aligned:  each seek also decodes from the preceding
+// keyframe.  Chunks should be long relative to the file's keyframe
+// interval for that to be negligible.
+class ParallelVideoSource : public ImageSource {
+public:
+
+  static const int DefaultChunkFrames = 128;
+  static const size_t DefaultBufferBytes = size_t(1) << 30;
+
+  // Frames of the consumer's chunk its worker may decode ahead,
+  // regardless of the budget
+  static const int CurrentChunkFrames = 4;
+
+  // Half-open range [begin,end) of frames
+  struct Range {
+    Range( int b, int e ) : begin(b), end(e) {;}
+    int begin, end;
+  };
+
+  // workers <= 0 uses one worker per hardware thread.  The buffer budget
+  // is counted in frames of 8-bit BGR images, and always allows at least
+  // one frame per worker.
+  ParallelVideoSource( const std::string &path, int workers = 0, int chunkFrames = DefaultChunkFrames,
+                       size_t bufferBytes = DefaultBufferBytes );
+  virtual ~ParallelVideoSource();
+
+  virtual int numFrames( void ) const       { return _index->numFrames(); }
+  virtual ImageSize imageSize( void ) const { return _imageSize; }
+
+  virtual bool grab( void );
+  virtual int getRawImage( int i, cv::Mat &mat );
+
+  // Frame the next grab() reads
+  int frameNum( void ) const { return _frame + 1; }
+
+  // Timestamp in ms of the frame last returned by grab(), from the index
+  double timestamp( void ) const;
+
+  int numWorkers( void ) const { return _workers.size(); }
+
+  // Decoded frames the workers may buffer for the consumer's later chunks
+  int bufferFrames( void ) const { return _bufferFrames; }
+
+  const std::shared_ptr<VideoIndex> &index( void ) const { return _index; }
+
+  // Splits [0,numFrames) into at most `parts` contiguous ranges of as
+  // near equal length as possible
+  static std::vector<Range> split( int numFrames, int parts );
+
+  // Called with the frame number and image of every frame, concurrently
+  // from the workers' threads.  The image's buffer is reused for the
+  // worker's next frame, so clone() it to keep it.
+  typedef std::function< void( int frame, const cv::Mat &image ) > FrameFunction;
+
+  // Decodes every frame of path once on `workers` threads (one per
+  // hardware thread if <= 0), each reading its own contiguous range in
+  // order.  Exceptions from fn or a worker are rethrown once all workers
+  // have stopped.  Returns false if the file can't be indexed or a range
+  // ended early.
+  static bool forEachFrame( const std::string &path, const FrameFunction &fn, int workers = 0 );
+
+protected:
+
+  struct Decoded {
+    Decoded( int f, const cv::Mat &i ) : frame(f), image(i) {;}
+    int frame;
+    cv::Mat image;
+  };
+
+  struct Worker {
+    Worker() : completed( -1 ), finished( false ) {;}
+
+    // Frames of the worker's chunks, in order
+    std::deque<Decoded> frames;
+
+    int completed;    // last chunk fully read
+    bool finished;
+    std::exception_ptr error;
+
+    std::thread thread;
+  };
+
+  void workerLoop( int w );
+
+  // True if the worker reading chunk c may decode another frame
+  bool hasSpace( const Worker &worker, size_t c ) const;
+
+  std::string _path;
+  std::shared_ptr<VideoIndex> _index;
+  ImageSize _imageSize;
+
+  // Chunk c is read by worker c % _workers.size()
+  std::vector<Range> _chunks;
+  int _chunkFrames;
+
+  int _bufferFrames;
+  int _buffered;      // frames queued across all workers
+
+  std::vector< std::unique_ptr<Worker> > _workers;
+  bool _stop;
+
+  std::mutex _mutex;
+  std::condition_variable _ready, _space;
+
+  size_t _chunk;      // chunk the consumer is reading
+  int _frame;         // frame last returned by grab()
+  cv::Mat _current;
+};
+
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "libvideoio/ImageSource.h"
+
+namespace libvideoio {
+
+// Decorator which reads frames from another ImageSource on a background
+// thread, up to `depth` frames ahead of the consumer, so decoding
+// overlaps with processing.  grab() takes the next prefetched frame
+// (blocking until one is ready) and returns false once the wrapped
+// source's grab() does;  getRawImage() and getDepth() return that
+// frame's images and depth, with the wrapped source's return values.
+//
+// After construction the wrapped source is only touched by the
+// prefetch thread.  Its frame count, image size, fps, conversion codes
+// and output type are read once, up front.
+//
+// Frames are converted to outputType() on the prefetch thread, through
+// the wrapped source's getImage(), so getRawImage() returns them already
+// converted.  Frames prefetched before a setOutputType() are converted
+// by getImage() as usual.
+//
+// Returned images are not shared with the wrapped source:  images the
+// source still references after getRawImage() (e.g. a reader's internal
+// buffer) are copied.  Ring buffers are reused for later frames once the
+// consumer has released them.
+class PrefetchingSource : public ImageSource {
+public:
+
+  static const int DefaultDepth = 4;
+
+  PrefetchingSource( const std::shared_ptr<ImageSource> &source, int depth = DefaultDepth );
+  virtual ~PrefetchingSource();
+
+  virtual int numFrames( void ) const     { return _numFrames; }
+  virtual ImageSize imageSize( void ) const { return _imageSize; }
+
+  virtual bool grab( void );
+
+  virtual int getRawImage( int i, cv::Mat &mat );
+  virtual void getDepth( cv::Mat &mat );
+
+  virtual int cvtToRGB()  { return _cvtToRGB; }
+  virtual int cvtToGray() { return _cvtToGray; }
+
+  virtual void setOutputType( int type );
+
+  int depth( void ) const { return _ring.size(); }
+
+protected:
+
+  struct Frame {
+    std::vector<cv::Mat> images;
+    std::vector<int> results;
+    cv::Mat depth;
+  };
+
+  void prefetchLoop( void );
+
+  // Reads the wrapped source's current frame into frame, converted to
+  // outputType
+  void readFrame( Frame &frame, int outputType );
+
+  std::shared_ptr<ImageSource> _source;
+
+  int _numFrames;
+  ImageSize _imageSize;
+  int _cvtToRGB, _cvtToGray;
+
+  // Frames [_head, _head+_count) of the ring are ready.  Once taken by
+  // grab() a slot holds the consumer's previous frame until it is
+  // refilled.
+  std::vector<Frame> _ring;
+  size_t _head, _count;
+  bool _finished, _stop;
+  std::exception_ptr _error;
+
+  std::mutex _mutex;
+  std::condition_variable _ready, _space;
+
+  Frame _current;
+  bool _haveCurrent;
+
+  std::thread _thread;
+};
+
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "libvideoio/Undistorter.h"
+
+namespace libvideoio {
+
+// Rectifies the two images of a calibrated stereo pair in one call.
+//
+// Both undistorters' row bands are interleaved in a single parallelFor on
+// the global ThreadPool, so the pair finishes in roughly the time one
+// image takes on half the threads, rather than two serial calls.
+class StereoRectifier {
+public:
+
+  StereoRectifier( const std::shared_ptr<OpenCVUndistorter> &left,
+                   const std::shared_ptr<OpenCVUndistorter> &right );
+
+  // Loads left and right ROS camera_info files
+  static StereoRectifier *loadFromFiles( const std::string &leftYaml,
+                                         const std::string &rightYaml );
+
+  /**
+   * Rectifies a pair of images.  Results are identical to calling
+   * undistort() on each undistorter.
+   */
+  void rectify( const cv::Mat &left, const cv::Mat &right,
+                cv::OutputArray leftResult, cv::OutputArray rightResult ) const;
+
+  const std::shared_ptr<OpenCVUndistorter> &left() const  { return _left; }
+  const std::shared_ptr<OpenCVUndistorter> &right() const { return _right; }
+
+  /**
+   * Distance between the rectified camera centres, in the units of the
+   * calibration's translation (positive if the right camera is to the
+   * right of the left).
+   */
+  double baseline() const { return _baseline; }
+
+  /**
+   * 4x4 disparity-to-depth matrix, as from cv::stereoRectify, suitable
+   * for cv::reprojectImageTo3D.  Empty if the baseline is zero.
+   */
+  const cv::Mat &Q() const { return _Q; }
+
+  /**
+   * Number of threads shared by both images.  A value of 0 (the
+   * default) uses every thread in the global ThreadPool.
+   */
+  void setNumThreads( int n ) { _numThreads = n; }
+  int numThreads() const;
+
+protected:
+
+  std::shared_ptr<OpenCVUndistorter> _left, _right;
+
+  double _baseline;
+  cv::Mat _Q;
+
+  int _numThreads;
+};
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace libvideoio {
+
+// Fixed-size pool of worker threads used to spread per-frame work
+// (undistortion bands, decoding, ...) across cores.
+class ThreadPool {
+public:
+
+  // Creates a pool with the given number of worker threads.  A pool
+  // with zero workers runs everything on the calling thread.
+  explicit ThreadPool( unsigned int numWorkers );
+  ~ThreadPool();
+
+  ThreadPool( const ThreadPool & ) = delete;
+  ThreadPool &operator=( const ThreadPool & ) = delete;
+
+  unsigned int numWorkers( void ) const { return _workers.size(); }
+
+  // Queues a task for execution on a worker thread.
+  std::future<void> submit( const std::function<void()> &task );
+
+  // Splits [begin,end) into numBands contiguous ranges and calls
+  // fn(bandBegin, bandEnd) for each, blocking until all have finished.
+  // The calling thread processes bands as well, so this is safe to call
+  // from within a worker.  The first exception thrown by fn is rethrown.
+  void parallelFor( int begin, int end, int numBands,
+                    const std::function<void(int,int)> &fn );
+
+  // Process-wide pool with one worker per hardware thread (less one
+  // for the caller).
+  static ThreadPool &global( void );
+
+protected:
+
+  void workerLoop( void );
+
+  std::vector< std::thread > _workers;
+  std::deque< std::function<void()> > _queue;
+
+  std::mutex _mutex;
+  std::condition_variable _cond;
+  bool _stop;
+};
+
+}
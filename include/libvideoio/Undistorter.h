@@ -20,7 +20,10 @@
 
 #pragma once
 
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <vector>
 #include <opencv2/core.hpp>
 #include <opencv2/imgproc.hpp>
 #include <opencv2/highgui.hpp>
@@ -30,11 +33,17 @@
 
 #include "libvideoio/types/Camera.h"
 #include "libvideoio/types/ImageSize.h"
+#include "libvideoio/MapCache.h"
 
 #include <tinyxml2.h>
 
 namespace libvideoio {
 
+namespace remap {
+  struct RemapTable;
+  struct ATANModel;
+}
+
 class Undistorter
 {
 public:
@@ -45,8 +54,128 @@ public:
    */
   virtual void undistort(const cv::Mat &image, cv::OutputArray result) const = 0;
 
+  /**
+   * Undistorts only the window outputRoi of the output image, which must
+   * lie within the output;  the result is outputRoi.size().
+   * OpenCVUndistorter, PTAMUndistorter and ImageCropper compute the
+   * window directly, reading only the source pixels it needs;  the
+   * default undistorts the whole frame and copies the window out.
+   */
+  virtual void undistort(const cv::Mat &image, cv::OutputArray result, const cv::Rect &outputRoi) const;
+
+  /**
+   * Undistorts a single-channel 16U or 32F depth image registered to the
+   * colour image, through the same maps as undistort() but sampled as
+   * depthSampling() rather than interpolated.  The default, for
+   * undistorters which don't change the geometry, copies the image.
+   */
   virtual void undistortDepth( const cv::Mat &depth, cv::OutputArray result) const { depth.copyTo( result ); }
 
+  /**
+   * Undistorts a colour image and its registered depth image (of the same
+   * size) together.  Undistorters with precomputed maps traverse them
+   * once for both images;  the default calls undistort() and
+   * undistortDepth() in turn.
+   */
+  virtual void undistortRGBD( const cv::Mat &image, const cv::Mat &depth,
+                              cv::OutputArray result, cv::OutputArray depthResult ) const;
+
+  /**
+   * Converts and undistorts a raw 8-bit image, giving the result of
+   *
+   *   cv::cvtColor( image, a, code );  a.convertTo( b, rdepth, alpha, beta );
+   *   undistort( b, result );
+   *
+   * to within rounding.  code may be -1 for no colour conversion.
+   * OpenCVUndistorter (when not wrapping another stage),
+   * CompiledUndistorter and PTAMUndistorter (under InterpolateLinearFast
+   * only, as it reads the packed table) do this in a single pass over
+   * the image for the gray conversions (cv::COLOR_BGR2GRAY, RGB2GRAY,
+   * BGRA2GRAY, RGBA2GRAY) or none, with rdepth CV_8U or CV_32F;
+   * anything else runs the three steps in turn.
+   */
+  virtual void convertAndUndistort( const cv::Mat &image, cv::OutputArray result,
+                                    int code, int rdepth, double alpha = 1.0, double beta = 0.0 ) const;
+
+  /**
+   * How depth images are resampled.  Interpolating depth across an object
+   * boundary would invent surfaces between the two, so each output pixel
+   * takes either the input pixel nearest its source coordinate, or the
+   * nearest surface (smallest valid depth) of the four input pixels
+   * around it.  Depths which are 0 or NaN are missing and never chosen.
+   * Setting the mode also sets it on the wrapped undistorters.
+   */
+  enum DepthSampling {
+    DepthNearest = 0,
+    DepthMinimum
+  };
+
+  void setDepthSampling( DepthSampling sampling );
+  DepthSampling depthSampling() const       { return _depthSampling; }
+
+  /**
+   * How colour images are resampled, trading quality for speed:
+   *
+   *   InterpolateNearest      - the input pixel nearest the source
+   *                             coordinate;  fastest, no blurring
+   *   InterpolateLinear       - bilinear with fixed-point weights (the
+   *                             default);  within a few LSB of exact
+   *   InterpolateLinearExact  - bilinear at the unquantized source
+   *                             coordinate, with float maps
+   *   InterpolateCubic        - bicubic over 4x4 input pixels;  sharpest
+   *                             and slowest
+   *   InterpolateLinearFast   - bilinear at coarser source coordinates
+   *                             where a stage has them;  PTAMUndistorter
+   *                             reads its 1/256 px table, within 2 LSB
+   *                             of exact for 8-bit images.  Elsewhere as
+   *                             InterpolateLinear.
+   *
+   * OpenCVUndistorter and PTAMUndistorter implement every mode, and
+   * ImageResizer maps them onto the cv::resize modes;  other stages
+   * always interpolate bilinearly.  Depth images are resampled as
+   * depthSampling() in every mode.  Setting the mode also sets it on the
+   * wrapped undistorters.
+   */
+  enum Interpolation {
+    InterpolateNearest = 0,
+    InterpolateLinear,
+    InterpolateLinearExact,
+    InterpolateCubic,
+    InterpolateLinearFast
+  };
+
+  void setInterpolation( Interpolation mode );
+  Interpolation interpolation() const       { return _interpolation; }
+
+  /**
+   * Undistorts count frames, images[i] into results[i], using the whole
+   * global ThreadPool.  Batches with at least as many frames as threads,
+   * or small frames, are processed one frame per thread;  otherwise
+   * frames are processed in turn, each split into row bands across all
+   * threads.  Results are identical to calling undistort() on each
+   * frame.  Existing result buffers of the right size and type are
+   * reused.
+   */
+  void undistortBatch( const cv::Mat *images, cv::Mat *results, size_t count ) const;
+  void undistortBatch( const std::vector<cv::Mat> &images, std::vector<cv::Mat> &results ) const;
+
+  /**
+   * Undistorts image into an image pyramid of numLevels levels:  levels[0]
+   * is the undistort() output and each further level halves the size
+   * (rounding up, as cv::pyrDown).  Rather than downsampling level 0
+   * repeatedly, each level is resampled in one pass through its own map,
+   * built on first use from the same calibration, from the input reduced
+   * by cv::pyrDown to the nearest scale.  Levels are therefore Gaussian
+   * filtered much like a cv::pyrDown chain, rather than aliasing detail
+   * too fine for them.
+   *
+   * Levels are sampled as interpolation(), like level 0.
+   *
+   * Undistorters which can't be expressed as a coordinate map (see
+   * getSourceMap()) fall back to a cv::pyrDown chain.
+   */
+  void undistortPyramid( const cv::Mat &image, std::vector<cv::Mat> &levels, int numLevels ) const;
+
   /**
    * Returns the intrinsic parameter matrix of the undistorted images.
    */
@@ -78,13 +207,166 @@ public:
   const std::string &name() const           { return _name; }
   void setName( const std::string &name )   { _name = name; }
 
+  /**
+   * Returns the undistorter applied before this one, if any
+   */
+  const std::shared_ptr<Undistorter> &wrapped() const { return _wrapped; }
+
+  /**
+   * Fills CV_32FC1 maps the size of the output image with the coordinate
+   * in the original input image (i.e. before any wrapped undistorters)
+   * sampled by each output pixel.  Pixels without a valid source are set
+   * to InvalidCoordinate or lie outside the input image.
+   *
+   * Returns false if this undistorter (or one it wraps) can't be
+   * expressed as a coordinate map.
+   */
+  virtual bool getSourceMap( cv::Mat &mapX, cv::Mat &mapY ) const { return false; }
+
+  static const float InvalidCoordinate;
+
+  /**
+   * Maps sparse points from input (distorted) to output (undistorted)
+   * pixel coordinates, and back.  Both interpolate coarse grids (built
+   * on first use, with nodes about 8 pixels apart) and are batched with
+   * SIMD, so they are much cheaper per point than cv::undistortPoints or
+   * a dense undistort().  Points with no corresponding pixel are set to
+   * (InvalidCoordinate, InvalidCoordinate).
+   *
+   * Input coordinates are those of the original image, before any
+   * wrapped undistorters.  Returns false if the undistorter can't be
+   * expressed as a coordinate map (see getSourceMap()).
+   */
+  bool undistortPoints( const std::vector<cv::Point2f> &in, std::vector<cv::Point2f> &out ) const;
+  bool distortPoints( const std::vector<cv::Point2f> &in, std::vector<cv::Point2f> &out ) const;
+
+  /**
+   * Number of row bands (threads) used by undistort().  The output is
+   * split into horizontal bands which are processed on the global
+   * ThreadPool; results are identical to the serial path.
+   * A value of 0 (the default) uses defaultNumThreads().
+   */
+  void setNumThreads( int n )               { _numThreads = n; }
+  int numThreads() const;
+
+  /**
+   * Process-wide thread count for undistorters which haven't set their
+   * own.  Defaults to 1 (serial).
+   */
+  static void setDefaultNumThreads( int n );
+  static int defaultNumThreads();
+
+  /**
+   * When undistorters which precompute maps (OpenCVUndistorter) build
+   * them:  in the constructor, on a background thread started by the
+   * constructor, or on the first call to prepare() or undistort().
+   * Applies to undistorters constructed after the call;  the default
+   * is BuildMapsEagerly.
+   */
+  enum MapBuildPolicy {
+    BuildMapsEagerly = 0,
+    BuildMapsInBackground,
+    BuildMapsOnFirstUse
+  };
+
+  static void setDefaultMapBuildPolicy( MapBuildPolicy policy );
+  static MapBuildPolicy defaultMapBuildPolicy();
+
+  /**
+   * Blocks until this undistorter (and any it wraps) is ready to
+   * undistort, building deferred maps on the calling thread if no other
+   * thread has started them.  undistort() calls this implicitly.
+   */
+  virtual void prepare() const              { if( _wrapped ) _wrapped->prepare(); }
+
+  /**
+   * True if undistort() won't wait for maps to be built
+   */
+  virtual bool isReady() const              { return !_wrapped || _wrapped->isReady(); }
+
+  /**
+   * src, or a copy of it if its pixels overlap dst's.  Remaps run in row
+   * bands, so reading the image being written (e.g. undistort( img, img ))
+   * would see rows other bands have already overwritten.
+   */
+  static cv::Mat unaliased( const cv::Mat &src, const cv::Mat &dst );
+
 protected:
 
   Undistorter(const std::shared_ptr<Undistorter> &wrap  = nullptr )
-    : _wrapped(wrap), _name("(undefined)") {;}
+    : _wrapped(wrap), _name("(undefined)"), _numThreads(0),
+      _depthSampling(DepthNearest), _interpolation(InterpolateLinear) {;}
+
+  // Calls fn(y0,y1) for each row band of [0,rows), in parallel
+  // according to numThreads()
+  void forEachBand( int rows, const std::function<void(int,int)> &fn ) const;
+
+  // Remaps rows [y0,y1) of a depth image through fixed-point maps as
+  // produced by cv::convertMaps (CV_16SC2 + CV_16UC1) into the same rows
+  // of out, sampled as depthSampling().  Types other than 16UC1 and
+  // 32FC1 are sampled nearest, with a warning.
+  void remapDepthRows( const cv::Mat &depth, const cv::Mat &map1, const cv::Mat &map2,
+                       cv::Mat &out, int y0, int y1 ) const;
+
+  // Exact bilinear remap of src into out through CV_32FC1 maps of the
+  // same size as out, shifted by -offset;  a negative map x marks an
+  // invalid pixel, and valid sources must lie within src less its last
+  // row and column.  Returns false if the native kernels don't handle
+  // src's type.
+  static bool remapExact( const cv::Mat &src, cv::Mat &out, const cv::Mat &mapX, const cv::Mat &mapY,
+                          const cv::Point &offset = cv::Point(0,0) );
+
+  // Runs the wrapped undistorter (if any) on image and returns its
+  // output, otherwise returns image.  Intermediate images are kept in
+  // per-thread scratch buffers which are reused from frame to frame.
+  cv::Mat undistortWrapped( const cv::Mat &image ) const;
+
+  // As undistortWrapped() for depth images, with the intermediate drawn
+  // from the global FramePool
+  cv::Mat undistortDepthWrapped( const cv::Mat &depth ) const;
+
+  // Completes getSourceMap():  given this stage's local maps (coordinates
+  // in the output of the wrapped undistorter), looks them up in the
+  // wrapped undistorter's source map.  Without a wrapped undistorter the
+  // local maps are returned as-is.
+  bool composeWithWrapped( const cv::Mat &localX, const cv::Mat &localY,
+                           cv::Mat &mapX, cv::Mat &mapY ) const;
+
+  // Size of the image entering the innermost wrapped undistorter
+  ImageSize originalInputSize() const;
+
+  // Maps input to output points as exactly as the undistorter can.
+  // Only evaluated at the nodes of the undistortPoints() grid;  the
+  // default inverts getSourceMap() by Newton iteration.
+  virtual bool undistortPointsExact( const std::vector<cv::Point2f> &in,
+                                     std::vector<cv::Point2f> &out ) const;
+
+  // Fills CV_32FC1 source maps (as getSourceMap()) for each output size
+  // in sizes, which are reduced versions of the output image.  The
+  // default resamples the full-size source map;  undistorters with a
+  // calibration may generate each level from it directly.
+  virtual bool pyramidSourceMaps( const std::vector<ImageSize> &sizes,
+                                  std::vector<cv::Mat> &mapX, std::vector<cv::Mat> &mapY ) const;
 
   std::shared_ptr<Undistorter> _wrapped;
   std::string _name;
+  int _numThreads;
+  DepthSampling _depthSampling;
+  Interpolation _interpolation;
+
+  // Grids for undistortPoints() / distortPoints(), built on first use
+  struct PointGrids;
+  std::shared_ptr<const PointGrids> pointGrids() const;
+
+  mutable std::mutex _pointGridMutex;
+  mutable std::shared_ptr<const PointGrids> _pointGrids;
+
+  // Maps for undistortPyramid() levels 1.., extended on demand
+  struct PyramidMaps;
+  std::shared_ptr<const PyramidMaps> pyramidMaps( int numLevels ) const;
+
+  mutable std::mutex _pyramidMutex;
+  mutable std::shared_ptr<const PyramidMaps> _pyramidMaps;
 
 
 };
@@ -115,7 +397,27 @@ public:
    * Undistorts the given image and returns the result image.
    */
   virtual void undistort(const cv::Mat &image, cv::OutputArray result) const;
-  virtual void undistortDepth( const cv::Mat &depth, cv::OutputArray result) const { depth.copyTo( result ); }
+  virtual void undistort(const cv::Mat &image, cv::OutputArray result, const cv::Rect &outputRoi) const;
+  virtual void undistortDepth( const cv::Mat &depth, cv::OutputArray result) const;
+  virtual void undistortRGBD( const cv::Mat &image, const cv::Mat &depth,
+                              cv::OutputArray result, cv::OutputArray depthResult ) const;
+
+  virtual void convertAndUndistort( const cv::Mat &image, cv::OutputArray result,
+                                    int code, int rdepth, double alpha = 1.0, double beta = 0.0 ) const;
+
+  virtual bool getSourceMap( cv::Mat &mapX, cv::Mat &mapY ) const;
+
+  /**
+   * Undistorts rows [y0,y1) of the output into out, which must already
+   * be allocated with the output size and the type of `intermediate`.
+   * `intermediate` is the output of any wrapped undistorter, and the
+   * maps must be ready (see prepare()).  Lets callers such as
+   * StereoRectifier schedule the bands of several undistorters together.
+   */
+  void undistortRows( const cv::Mat &intermediate, cv::Mat &out, int y0, int y1 ) const;
+
+  virtual void prepare() const;
+  virtual bool isReady() const;
 
   /**
    * Returns the intrinsic parameter matrix of the undistorted images.
@@ -139,13 +441,54 @@ public:
 
 protected:
 
+  // Evaluates the calibration with cv::undistortPoints
+  virtual bool undistortPointsExact( const std::vector<cv::Point2f> &in,
+                                     std::vector<cv::Point2f> &out ) const;
+
+  // Generates each level with cv::initUndistortRectifyMap and a scaled K
+  virtual bool pyramidSourceMaps( const std::vector<ImageSize> &sizes,
+                                  std::vector<cv::Mat> &mapX, std::vector<cv::Mat> &mapY ) const;
+
+  // Starts building the maps according to defaultMapBuildPolicy()
+  void initMaps( const cv::Mat &rectification );
+
+  // Loads _map1/_map2 from the MapCache, or computes (and caches) them.
+  // Runs exactly once, on whichever thread claims the build first.
+  void buildMaps() const;
+
+  // Remaps rows [y0,y1) of the outputRoi window of the output into the
+  // same rows of out, as interpolation().  Map coordinates are shifted by
+  // -offset, the origin of src within the full intermediate image.
+  void remapRows( const cv::Mat &src, cv::Mat &out, const cv::Rect &outputRoi,
+                  const cv::Point &offset, int y0, int y1 ) const;
+
+  // Maps for InterpolateNearest (rounded CV_16SC2) and
+  // InterpolateLinearExact (CV_32FC1, with -1 where the source is outside
+  // the intermediate image), built from the calibration on first use
+  cv::Mat nearestMap() const;
+  void exactMaps( cv::Mat &mapX, cv::Mat &mapY ) const;
+
   cv::Mat _originalK, _K;
   cv::Mat _distCoeffs;
+  cv::Mat _rectification;
 
   cv::Vec3d _baseline;
 
   ImageSize _inputSize, _outputSize;
-  cv::Mat _map1, _map2;
+
+  // Written once by buildMaps(), read only after the build completes
+  mutable cv::Mat _map1, _map2;
+
+  // Backing store when the maps were loaded from the MapCache
+  mutable std::shared_ptr<const MapCache::Maps> _cachedMaps;
+
+  mutable std::mutex _modeMapMutex;
+  mutable cv::Mat _nearestMap, _exactMapX, _exactMapY;
+
+  // Shared with any background build task, which may outlive a
+  // destructor that finds the build unclaimed
+  struct MapBuildState;
+  std::shared_ptr<MapBuildState> _mapBuild;
 
   /// true if the undistorter object is valid (has been initialized with
   /// a valid configuration)
@@ -218,8 +561,25 @@ public:
 
   /**
    * Undistorts the given image and returns the result image.
+   * Supports 8U, 16U and 32F images with 1, 3 or 4 channels;  the
+   * result has the same type as the input.  Bilinear output is
+   * interpolated at the exact coordinate through float maps, within
+   * 1 LSB of float interpolation;  InterpolateLinearFast reads 8U
+   * images through the packed table instead, within 2 LSB.
+   * Other types are remapped by cv::remap over the float maps, with a
+   * warning.
    */
   void undistort(const cv::Mat &image, cv::OutputArray result) const;
+  void undistort(const cv::Mat &image, cv::OutputArray result, const cv::Rect &outputRoi) const;
+
+  void undistortDepth( const cv::Mat &depth, cv::OutputArray result) const;
+  void undistortRGBD( const cv::Mat &image, const cv::Mat &depth,
+                      cv::OutputArray result, cv::OutputArray depthResult ) const;
+
+  void convertAndUndistort( const cv::Mat &image, cv::OutputArray result,
+                            int code, int rdepth, double alpha = 1.0, double beta = 0.0 ) const;
+
+  virtual bool getSourceMap( cv::Mat &mapX, cv::Mat &mapY ) const;
 
   /**
    * Returns the intrinsic parameter matrix of the undistorted images.
@@ -272,8 +632,41 @@ private:
   float outputCalibration[5];
   int out_width, out_height;
   int in_width, in_height;
-  float* remapX;
-  float* remapY;
+
+  // Packed fixed-point map with per-row valid spans
+  std::unique_ptr<remap::RemapTable> remapTable;
+
+  // Lens model behind the table, and the float maps evaluated from it on
+  // first use by the bilinear modes (all but 8U InterpolateLinearFast)
+  std::unique_ptr<remap::ATANModel> atanModel;
+  mutable std::mutex exactMapMutex;
+  mutable std::vector<float> exactMapX, exactMapY;
+
+  void exactMaps( const float *&mapX, const float *&mapY ) const;
+
+  // Kernel for colour images of this type under interpolation(), or
+  // none (with a warning, once) if the type has no kernel
+  struct ColourRemapper;
+  ColourRemapper selectColourKernel( const cv::Mat &image ) const;
+  mutable std::once_flag unsupportedTypeWarning;
+
+  // Remaps the outputRoi part of the output with cv::remap over the
+  // exact maps, for types without a kernel.  colourRemapFlags() is the
+  // cv::remap interpolation matching interpolation() for the image.
+  void remapWithOpenCV( const cv::Mat &image, const cv::Rect &outputRoi, int flags, cv::Mat &result ) const;
+  int colourRemapFlags( const cv::Mat &image ) const;
+
+  // Fills remapTable from the MapCache, returning false on a miss
+  bool loadCachedTable( const MapCache::Key &key );
+  void storeCachedTable( const MapCache::Key &key ) const;
+
+  // True if images of this size are returned unchanged
+  bool passThrough( const cv::Mat &image ) const;
+
+  // Remaps a colour image, a depth image or both (either may be null) in
+  // a single traversal of the table
+  void remapTiles( const cv::Mat *image, cv::OutputArray result,
+                   const cv::Mat *depth, cv::OutputArray depthResult ) const;
 
 
   /// Is true if the undistorter object is valid (has been initialized with
@@ -316,18 +709,46 @@ public:
    */
   virtual void undistort(const cv::Mat &image, cv::OutputArray result) const
   {
-    cv::Mat intermediate(image);
-    if( _wrapped ) {
-      _wrapped->undistort( image, intermediate );
-    }
+    cv::Mat intermediate( undistortWrapped( image ) );
 
     cv::Mat roi( intermediate, cv::Rect( _offsetX, _offsetY, _width, _height ) );
-    LOG(WARNING) << "Cropping to " << _width << " x " << _height;
     // cv::imshow("roi",roi);
     // cv::waitKey(10);
     result.assign( roi );
   }
 
+  virtual void undistort(const cv::Mat &image, cv::OutputArray result, const cv::Rect &outputRoi) const
+  {
+    CHECK( (outputRoi & cv::Rect( 0, 0, _width, _height )) == outputRoi ) << "ROI outside cropped image";
+
+    // The window of the crop is just a window of the wrapped output
+    const cv::Rect shifted( outputRoi + cv::Point( _offsetX, _offsetY ) );
+    if( _wrapped ) {
+      _wrapped->undistort( image, result, shifted );
+    } else {
+      result.assign( cv::Mat( image, shifted ) );
+    }
+  }
+
+  virtual void undistortDepth( const cv::Mat &depth, cv::OutputArray result ) const
+  {
+    const cv::Mat intermediate( undistortDepthWrapped( depth ) );
+    result.assign( cv::Mat( intermediate, cv::Rect( _offsetX, _offsetY, _width, _height ) ) );
+  }
+
+  virtual bool getSourceMap( cv::Mat &mapX, cv::Mat &mapY ) const
+  {
+    cv::Mat localX( _height, _width, CV_32F ), localY( _height, _width, CV_32F );
+    for( int y = 0; y < _height; ++y ) {
+      for( int x = 0; x < _width; ++x ) {
+        localX.at<float>(y,x) = x + _offsetX;
+        localY.at<float>(y,x) = y + _offsetY;
+      }
+    }
+
+    return composeWithWrapped( localX, localY, mapX, mapY );
+  }
+
   /**
    * Returns the intrinsic parameter matrix of the undistorted images.
    */
@@ -411,23 +832,53 @@ public:
   ImageResizer(const ImageResizer&) = delete;
   ImageResizer& operator=(const ImageResizer&) = delete;
 
+  using Undistorter::undistort;
+
   /**
    * Undistorts the given image and returns the result image.
    */
   virtual void undistort(const cv::Mat &image, cv::OutputArray result) const
   {
-    cv::Mat intermediate(image);
-    if( _wrapped ) {
-      _wrapped->undistort( image, intermediate );
-    }
+    cv::Mat intermediate( undistortWrapped( image ) );
+
+    // Resize straight into result, reusing the caller's buffer.  Both
+    // linear modes use cv::resize's bilinear filter.
+    int flags = cv::INTER_LINEAR;
+    if( interpolation() == InterpolateNearest ) flags = cv::INTER_NEAREST;
+    else if( interpolation() == InterpolateCubic ) flags = cv::INTER_CUBIC;
 
-    cv::Mat shrunk;
-    cv::resize(intermediate, shrunk, cv::Size( _width, _height ));
-    LOG(INFO) << "Shrinking to " << _width << " x " << _height;
+    cv::resize(intermediate, result, cv::Size( _width, _height ), 0, 0, flags);
     // cv::imshow("Intermediate", intermediate);
-    // cv::imshow("shrunk",shrunk);
     // cv::waitKey(10);
-    result.assign( shrunk );
+  }
+
+  // Depth is always resized with nearest-neighbour sampling
+  virtual void undistortDepth( const cv::Mat &depth, cv::OutputArray result ) const
+  {
+    const cv::Mat intermediate( undistortDepthWrapped( depth ) );
+    cv::resize( intermediate, result, cv::Size( _width, _height ), 0, 0, cv::INTER_NEAREST );
+  }
+
+  virtual bool getSourceMap( cv::Mat &mapX, cv::Mat &mapY ) const
+  {
+    // The input size (hence scale) is only known when wrapping
+    if( !_wrapped ) return false;
+
+    // Same pixel-centre convention and border clamping as cv::resize
+    const ImageSize in( _wrapped->outputImageSize() );
+    const float sx = float(in.width) / _width, sy = float(in.height) / _height;
+
+    cv::Mat localX( _height, _width, CV_32F ), localY( _height, _width, CV_32F );
+    for( int y = 0; y < _height; ++y ) {
+      const float ly = std::min( std::max( (y + 0.5f) * sy - 0.5f, 0.0f ), in.height - 1.0f );
+
+      for( int x = 0; x < _width; ++x ) {
+        localX.at<float>(y,x) = std::min( std::max( (x + 0.5f) * sx - 0.5f, 0.0f ), in.width - 1.0f );
+        localY.at<float>(y,x) = ly;
+      }
+    }
+
+    return composeWithWrapped( localX, localY, mapX, mapY );
   }
 
   /**
@@ -485,6 +936,62 @@ private:
 };
 
 
+// A CompiledUndistorter flattens a chain of undistorters (e.g. an
+// ImageResizer wrapping an ImageCropper wrapping an OpenCVUndistorter)
+// into one precomputed coordinate map, so each frame is resampled once
+// rather than once per stage, with no intermediate images.
+class CompiledUndistorter : public Undistorter
+{
+public:
+
+  /**
+   * Builds the fused map for `chain` and everything it wraps.  Returns
+   * nullptr if any stage can't be expressed as a coordinate map.
+   */
+  static CompiledUndistorter *compile( const std::shared_ptr<Undistorter> &chain );
+
+  virtual ~CompiledUndistorter() {;}
+
+  using Undistorter::undistort;
+
+  /**
+   * Undistorts the given image and returns the result image.  Out of
+   * bounds pixels are set to zero.
+   */
+  virtual void undistort(const cv::Mat &image, cv::OutputArray result) const;
+
+  virtual void undistortDepth( const cv::Mat &depth, cv::OutputArray result) const;
+  virtual void undistortRGBD( const cv::Mat &image, const cv::Mat &depth,
+                              cv::OutputArray result, cv::OutputArray depthResult ) const;
+
+  virtual void convertAndUndistort( const cv::Mat &image, cv::OutputArray result,
+                                    int code, int rdepth, double alpha = 1.0, double beta = 0.0 ) const;
+
+  virtual bool getSourceMap( cv::Mat &mapX, cv::Mat &mapY ) const;
+
+  const cv::Mat getK() const                { return _chain->getK(); }
+  virtual const Camera getCamera() const    { return _chain->getCamera(); }
+  const cv::Mat getOriginalK() const        { return _chain->getOriginalK(); }
+
+  virtual ImageSize inputImageSize() const  { return _inputSize; }
+  virtual ImageSize outputImageSize() const { return _chain->outputImageSize(); }
+
+  bool isValid() const { return _chain->isValid(); }
+
+protected:
+
+  CompiledUndistorter( const std::shared_ptr<Undistorter> &chain,
+                       const ImageSize &inputSize,
+                       const cv::Mat &mapX, const cv::Mat &mapY );
+
+  std::shared_ptr<Undistorter> _chain;
+  ImageSize _inputSize;
+
+  // Fixed-point maps as produced by cv::convertMaps
+  cv::Mat _map1, _map2;
+};
+
+
 
 // class UndistorterOpenCV : public Undistorter
 // {
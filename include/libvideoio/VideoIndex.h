@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <opencv2/highgui/highgui.hpp>
+
+namespace libvideoio {
+
+// Exact frame count and per-frame timestamps of a video file, built by
+// decoding the file once and saved next to it as a sidecar
+// ("<video>.lvioidx").  VideoSource uses it to report an exact
+// numFrames() and to verify (and correct) where seeks land, as
+// CAP_PROP_FRAME_COUNT is often an estimate and CAP_PROP_POS_FRAMES
+// seeks in many containers land near, not on, the requested frame.
+//
+// The sidecar records the size and modification time of the video, so
+// a re-encoded or replaced file is re-indexed.
+class VideoIndex {
+public:
+
+  // Incremented whenever the sidecar layout changes
+  static const uint32_t FormatVersion = 1;
+
+  // Timestamps in ms, one per frame
+  explicit VideoIndex( const std::vector<double> &timestamps = std::vector<double>() );
+
+  // Reads every remaining frame of capture (grab() only, no colour
+  // conversion) and records its CAP_PROP_POS_MSEC
+  static std::shared_ptr<VideoIndex> build( cv::VideoCapture &capture );
+
+  // Reads the sidecar of videoPath;  nullptr if it is missing, malformed
+  // or describes another version of the file
+  static std::shared_ptr<VideoIndex> load( const std::string &videoPath );
+
+  // Writes the sidecar of videoPath.  Returns false (after logging) if it
+  // can't be written, which is never fatal.
+  bool save( const std::string &videoPath ) const;
+
+  // load(), or else build() from the start of the file and save()
+  static std::shared_ptr<VideoIndex> open( const std::string &videoPath );
+
+  static std::string sidecarPath( const std::string &videoPath ) { return videoPath + ".lvioidx"; }
+
+  int numFrames( void ) const         { return _timestamps.size(); }
+  double timestamp( int frame ) const { return _timestamps[frame]; }
+
+  // True if timestamps strictly increase, i.e. identify frames.  Some
+  // backends report no timestamps, in which case seeks can't be checked.
+  bool hasTimestamps( void ) const    { return _hasTimestamps; }
+
+  // Frame with the timestamp nearest ms, or -1 if there are no frames
+  int frameAt( double ms ) const;
+
+protected:
+
+  std::vector<double> _timestamps;
+  bool _hasTimestamps;
+};
+
+}
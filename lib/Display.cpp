@@ -1,5 +1,6 @@
 
 #include "libvideoio/Display.h"
+#include "libvideoio/FramePool.h"
 
 namespace libvideoio {
 
@@ -8,21 +9,23 @@ using namespace cv;
 
 	void Display::onShowLeft( const Mat &img )
 	{
-		cv::Mat resized;
+		cv::Mat resized( FramePool::global().acquire( _displaySize, img.type() ) );
 		cv::resize( img, resized, _displaySize );
 		cv::imshow( "Left", resized );
 	}
 
 	void Display::onShowDepth( const Mat &img )
 	{
-		cv::Mat resized;
-		cv::resize( img*255, resized, _displaySize );
+		// Scale after resizing, which avoids a full-size temporary
+		cv::Mat resized( FramePool::global().acquire( _displaySize, img.type() ) );
+		cv::resize( img, resized, _displaySize );
+		resized.convertTo( resized, -1, 255 );
 		cv::imshow( "Display", resized );
 	}
 
 	void Display::onShowRight( const Mat &img )
 	{
-		cv::Mat resized;
+		cv::Mat resized( FramePool::global().acquire( _displaySize, img.type() ) );
 		cv::resize( img, resized, _displaySize );
 		cv::imshow( "Right", resized );
 	}
@@ -40,7 +43,7 @@ using namespace cv;
 		// reshape (2 channel, rows=0 means retain # of rows) should suffice
 
 		cv::Mat leftRoi( img, cv::Rect(0,0, img.cols/2, img.rows ));
-		cv::Mat leftBgr;
+		cv::Mat leftBgr( FramePool::global().acquire( _displaySize, img.type() ) );
 		cv::resize( leftRoi, leftBgr, _displaySize );
 		cv::cvtColor( leftBgr, leftBgr, cv::COLOR_YUV2BGRA_YUYV );
 		imshow( "RawLeft", leftBgr );
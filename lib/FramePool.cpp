@@ -0,0 +1,71 @@
+
+#include "libvideoio/FramePool.h"
+
+namespace libvideoio {
+
+  // A buffer only the pool references
+  static bool isFree( const cv::Mat &buffer )
+  {
+    return buffer.u && buffer.u->refcount == 1;
+  }
+
+  FramePool::FramePool( size_t maxBuffers )
+    : _buffers(),
+      _maxBuffers( maxBuffers ),
+      _allocations( 0 )
+  {;}
+
+  cv::Mat FramePool::acquire( const cv::Size &size, int type )
+  {
+    std::lock_guard<std::mutex> lock( _mutex );
+
+    // Free buffers only gain references here, under the lock, so a free
+    // buffer can't be claimed twice
+    for( const cv::Mat &buffer : _buffers ) {
+      if( buffer.size() == size && buffer.type() == type && isFree( buffer ) ) return buffer;
+    }
+
+    ++_allocations;
+    cv::Mat buffer( size, type );
+
+    if( _buffers.size() < _maxBuffers ) {
+      _buffers.push_back( buffer );
+    } else {
+      // Replace a free buffer of another size or type, if any
+      for( cv::Mat &old : _buffers ) {
+        if( isFree( old ) ) {
+          old = buffer;
+          break;
+        }
+      }
+    }
+
+    return buffer;
+  }
+
+  size_t FramePool::size() const
+  {
+    std::lock_guard<std::mutex> lock( _mutex );
+    return _buffers.size();
+  }
+
+  size_t FramePool::allocations() const
+  {
+    std::lock_guard<std::mutex> lock( _mutex );
+    return _allocations;
+  }
+
+  void FramePool::clear()
+  {
+    std::lock_guard<std::mutex> lock( _mutex );
+    _buffers.clear();
+    _allocations = 0;
+  }
+
+  FramePool &FramePool::global()
+  {
+    static FramePool pool;
+    return pool;
+  }
+
+}
@@ -1,32 +1,241 @@
 #include <g3log/g3log.hpp>
 
 #include "libvideoio/ImageSource.h"
+#include "libvideoio/FramePool.h"
+#include "libvideoio/ThreadPool.h"
+#include "libvideoio/Undistorter.h"
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <algorithm>
 
 namespace libvideoio {
 
+  // cvtColor code taking a raw image to the given number of channels
+  static int conversionCode( ImageSource &source, int outChannels )
+  {
+    if( outChannels == 3 ) {
+      CHECK( source.cvtToRGB() >= 0 ) << "No conversion to RGB specified by ImageSource";
+      return source.cvtToRGB();
+    } else if( outChannels == 1 ) {
+      CHECK( source.cvtToGray() >= 0 ) << "No conversion to gray specific by ImageSource";
+      return source.cvtToGray();
+    }
+
+    LOG(FATAL) << "Unable to figure out how to convert to " << outChannels << " channels";
+    return -1;
+  }
+
   int ImageSource::getImage( int i, cv::Mat &mat ) {
-    int ret = getRawImage(i,mat);
-    if( _outputType <0 || mat.type() == _outputType ) return ret;
+    if( _outputType < 0 ) return getRawImage(i, mat);
+
+    // Decode into a buffer of our own, so mat keeps the output type from
+    // frame to frame and is only reallocated if the size changes.  The
+    // decode buffer is dropped if the caller kept a reference to it.
+    if( !_raw.u || _raw.u->refcount != 1 ) _raw.release();
+    int ret = getRawImage(i, _raw);
+
+    if( _raw.type() == _outputType ) {
+      // Hand over the decoded buffer;  mat's old one is decoded into next
+      cv::swap( mat, _raw );
+      return ret;
+    }
 
     //auto inChannels  = ((mat.type()  & ~CV_MAT_DEPTH_MASK) >> CV_CN_SHIFT) + 1;
     auto outChannels = ((_outputType & ~CV_MAT_DEPTH_MASK) >> CV_CN_SHIFT) + 1;
 
-    if( outChannels == 3 ) {
-      CHECK( cvtToRGB() >= 0 ) << "No conversion to RGB specified by ImageSource";
-      cv::Mat tmp;
-      cv::cvtColor( mat, tmp, cvtToRGB() );
-      tmp.convertTo( mat, _outputType );
-    } else if( outChannels == 1 ) {
-      CHECK( cvtToGray() >= 0 ) << "No conversion to gray specific by ImageSource";
-      cv::Mat tmp;
-      cv::cvtColor( mat, tmp, cvtToGray() );
+    const int code = conversionCode( *this, outChannels );
+
+    if( CV_MAKETYPE( _raw.depth(), outChannels ) == _outputType ) {
+      cv::cvtColor( _raw, mat, code );
+    } else {
+      cv::Mat tmp( FramePool::global().acquire( _raw.size(), CV_MAKETYPE( _raw.depth(), outChannels ) ) );
+      cv::cvtColor( _raw, tmp, code );
       tmp.convertTo( mat, _outputType );
+    }
+
+    return ret;
+  }
+
+  int ImageSource::getUndistortedImage( int i, cv::Mat &mat, const Undistorter &undistorter ) {
+    if( !_raw.u || _raw.u->refcount != 1 ) _raw.release();
+    int ret = getRawImage(i, _raw);
+
+    if( _outputType < 0 || _raw.type() == _outputType ) {
+      undistorter.undistort( _raw, mat );
     } else {
-      LOG(FATAL) << "Unable to figure out how to convert to " << outChannels << " channels";
+      auto outChannels = ((_outputType & ~CV_MAT_DEPTH_MASK) >> CV_CN_SHIFT) + 1;
+      undistorter.convertAndUndistort( _raw, mat, conversionCode( *this, outChannels ), CV_MAT_DEPTH( _outputType ) );
     }
 
     return ret;
   }
 
+  //=== ImageFilesSource ===
+
+  void ImageFilesSource::setDecodeAhead( int frames )
+  {
+    _decodeAhead = std::max( frames, 0 );
+    _decodes.clear();
+
+    const unsigned int threads = std::min<unsigned int>( _decodeAhead, std::max( 1u, std::thread::hardware_concurrency() ) );
+    if( threads == 0 )
+      _decoders.reset();
+    else if( !_decoders || _decoders->numWorkers() != threads )
+      _decoders.reset( new ThreadPool( threads ) );
+
+    if( _decodeAhead > 0 && _idx >= 0 && _idx < (int)_paths.size() ) scheduleDecodes();
+  }
+
+  void ImageFilesSource::scheduleDecodes( void )
+  {
+    while( !_decodes.empty() && _decodes.front().idx < _idx ) _decodes.pop_front();
+
+    int next = _decodes.empty() ? _idx : _decodes.back().idx + 1;
+    for( ; next < _idx + _decodeAhead && next < (int)_paths.size(); ++next ) {
+      const std::string path( _paths[next].string() );
+      std::shared_ptr<cv::Mat> image( std::make_shared<cv::Mat>() );
+
+      const Decode decode = { next, image,
+                              _decoders->submit( [path, image]() {
+                                *image = cv::imread( path, cv::IMREAD_GRAYSCALE );
+                              }).share() };
+      _decodes.push_back( decode );
+    }
+  }
+
+  int ImageFilesSource::getRawImage( int i, cv::Mat &mat )
+  {
+    if( i != 0 ) return 0;
+
+    if( _idx >= (int)_paths.size() ) return -1;
+
+    if( !_decodes.empty() && _decodes.front().idx == _idx ) {
+      // Waits on the decoder threads only, so is safe on a global pool worker
+      _decodes.front().done.get();
+      mat = *_decodes.front().image;
+      _decodes.pop_front();
+    } else {
+      mat = cv::imread( _paths[_idx].string(), cv::IMREAD_GRAYSCALE );
+    }
+
+    return _idx;
+  }
+
+  //=== VideoSource ===
+
+  bool VideoSource::useIndex( void )
+  {
+    if( _index ) return true;
+
+    std::shared_ptr<VideoIndex> index( VideoIndex::open( _path.string() ) );
+    if( !index ) return false;
+
+    useIndex( index );
+    return true;
+  }
+
+  void VideoSource::useIndex( const std::shared_ptr<VideoIndex> &index )
+  {
+    CHECK( (bool)index ) << "VideoSource: null index for " << _path.string();
+    _index = index;
+
+    // Positions are tracked from here on
+    _next = _capture.get( cv::CAP_PROP_POS_FRAMES );
+    _pregrabbed = false;
+  }
+
+  void VideoSource::skipTo( int frame )
+  {
+    // The next grab() reads `frame` whatever the frame step
+    _stepBeforeGrab = false;
+
+    if( !_index ) {
+      _capture.set( cv::CAP_PROP_POS_FRAMES, frame );
+      return;
+    }
+
+    frame = std::max( 0, std::min( frame, _index->numFrames() ) );
+
+    const int position = frameNum();
+    if( frame == position ) return;
+
+    if( frame > position && frame - position <= MaxDecodeForward ) {
+      // Within a GOP, decoding forward beats seeking back to its start
+      _pregrabbed = false;
+      while( _next < frame && _capture.grab() ) ++_next;
+      if( _next == frame ) return;
+    } else if( frame < _index->numFrames() && _index->hasTimestamps() ) {
+      if( seekExact( frame ) ) return;
+      LOG(WARNING) << "VideoSource: unable to seek exactly to frame " << frame << " of " << _path.string();
+    }
+
+    // Trust the backend
+    _capture.set( cv::CAP_PROP_POS_FRAMES, frame );
+    _next = frame;
+    _pregrabbed = false;
+  }
+
+  bool VideoSource::seekExact( int frame )
+  {
+    // Seeks which overshoot are retried further back
+    int margin = 0;
+
+    for( int attempt = 0; attempt < 8; ++attempt ) {
+      _capture.set( cv::CAP_PROP_POS_FRAMES, std::max( frame - margin, 0 ) );
+      if( !_capture.grab() ) return false;
+
+      int landed = _index->frameAt( _capture.get( cv::CAP_PROP_POS_MSEC ) );
+      if( landed <= frame ) {
+        while( landed < frame && _capture.grab() )
+          landed = _index->frameAt( _capture.get( cv::CAP_PROP_POS_MSEC ) );
+
+        if( landed != frame ) return false;
+
+        // The frame has been read;  grab() returns it
+        _next = frame + 1;
+        _pregrabbed = true;
+        return true;
+      }
+
+      margin = std::max( 2*margin, MaxDecodeForward );
+    }
+
+    return false;
+  }
+
+  void VideoSource::setFrameStep( int step )
+  {
+    _frameStep = std::max( step, 1 );
+    _stepBeforeGrab = false;
+  }
+
+  bool VideoSource::skipStep( void )
+  {
+    if( _index ) {
+      const int frame = frameNum() + _frameStep - 1;
+      if( frame >= _index->numFrames() ) return false;
+
+      skipTo( frame );
+      return frameNum() == frame;
+    }
+
+    // Unindexed seeks are inexact, so every frame is read
+    for( int i = 1; i < _frameStep; ++i ) {
+      if( !_capture.grab() ) return false;
+      ++_next;
+    }
+
+    return true;
+  }
+
+  bool VideoSource::getFrame( int frame, cv::Mat &mat )
+  {
+    skipTo( frame );
+    if( !grab() ) return false;
+
+    getImage( mat );
+    return true;
+  }
 
 }
@@ -0,0 +1,234 @@
+#include "libvideoio/ParallelVideoSource.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace libvideoio {
+
+  static int numThreads( int workers )
+  {
+    return workers > 0 ? workers : std::max( 1u, std::thread::hardware_concurrency() );
+  }
+
+  ParallelVideoSource::ParallelVideoSource( const std::string &path, int workers, int chunkFrames,
+                                            size_t bufferBytes )
+    : _path( path ),
+      _imageSize( 0, 0 ),
+      _chunkFrames( std::max( chunkFrames, 1 ) ),
+      _bufferFrames( 0 ),
+      _buffered( 0 ),
+      _stop( false ),
+      _chunk( 0 ),
+      _frame( -1 )
+  {
+    VideoSource probe( path );
+    CHECK( probe.isOpened() ) << "ParallelVideoSource: unable to open " << path;
+    CHECK( probe.useIndex() ) << "ParallelVideoSource: unable to index " << path;
+
+    _numImages = 1;
+    _hasDepth = false;
+    setFPS( probe.fps() );
+
+    _imageSize = probe.imageSize();
+    _index = probe.index();
+
+    const int frames = _index->numFrames();
+    for( int begin = 0; begin < frames; begin += _chunkFrames )
+      _chunks.push_back( Range( begin, std::min( begin + _chunkFrames, frames ) ) );
+
+    // No more workers than chunks
+    const int n = std::max( 1, std::min<int>( numThreads( workers ), _chunks.size() ) );
+    for( int w = 0; w < n; ++w ) _workers.emplace_back( new Worker );
+
+    const size_t frameBytes = std::max<size_t>( size_t(3) * _imageSize.width * _imageSize.height, 1 );
+    _bufferFrames = std::max<size_t>( std::min<size_t>( bufferBytes / frameBytes, INT32_MAX ), n );
+
+    for( int w = 0; w < n; ++w ) _workers[w]->thread = std::thread( &ParallelVideoSource::workerLoop, this, w );
+  }
+
+  ParallelVideoSource::~ParallelVideoSource()
+  {
+    {
+      std::lock_guard<std::mutex> lock( _mutex );
+      _stop = true;
+    }
+    _space.notify_all();
+
+    for( auto &worker : _workers )
+      if( worker->thread.joinable() ) worker->thread.join();
+  }
+
+  bool ParallelVideoSource::grab( void )
+  {
+    std::unique_lock<std::mutex> lock( _mutex );
+
+    while( _chunk < _chunks.size() ) {
+      Worker &worker( *_workers[ _chunk % _workers.size() ] );
+      const int chunk = _chunk;
+
+      _ready.wait( lock, [&]() { return !worker.frames.empty() || worker.completed >= chunk || worker.finished; } );
+
+      // Frames of the worker's later chunks queue behind this one's
+      if( !worker.frames.empty() && worker.frames.front().frame < _chunks[_chunk].end ) {
+        Decoded &next( worker.frames.front() );
+        if( next.frame != _frame + 1 )
+          LOG(WARNING) << "ParallelVideoSource: unable to read frames " << _frame + 1 << " to " << next.frame - 1 << " of " << _path;
+
+        _frame = next.frame;
+        _current = next.image;
+        worker.frames.pop_front();
+        --_buffered;
+
+        lock.unlock();
+        _space.notify_all();
+        return true;
+      }
+
+      if( worker.completed < chunk && worker.error ) std::rethrow_exception( worker.error );
+
+      // The next chunk's worker may now be past the budget
+      ++_chunk;
+      _space.notify_all();
+    }
+
+    _current.release();
+    return false;
+  }
+
+  int ParallelVideoSource::getRawImage( int i, cv::Mat &mat )
+  {
+    if( i != 0 || _current.empty() ) return -1;
+
+    mat = _current;
+    return 0;
+  }
+
+  double ParallelVideoSource::timestamp( void ) const
+  {
+    return _frame >= 0 ? _index->timestamp( _frame ) : 0.0;
+  }
+
+  bool ParallelVideoSource::hasSpace( const Worker &worker, size_t c ) const
+  {
+    // The consumer waits on the current chunk's worker, so the budget
+    // (which other workers may have filled) never holds it back
+    if( c == _chunk ) return (int)worker.frames.size() < CurrentChunkFrames;
+    return _buffered < _bufferFrames;
+  }
+
+  void ParallelVideoSource::workerLoop( int w )
+  {
+    Worker &worker( *_workers[w] );
+
+    try {
+      VideoSource source( _path );
+      CHECK( source.isOpened() ) << "ParallelVideoSource: unable to open " << _path;
+      source.useIndex( _index );
+
+      for( size_t c = w; c < _chunks.size(); c += _workers.size() ) {
+        const Range &chunk( _chunks[c] );
+        source.skipTo( chunk.begin );
+
+        for( int frame = chunk.begin; frame < chunk.end; ++frame ) {
+          {
+            std::unique_lock<std::mutex> lock( _mutex );
+            _space.wait( lock, [&]() { return _stop || hasSpace( worker, c ); } );
+            if( _stop ) return;
+          }
+
+          if( !source.grab() ) break;
+
+          // A new buffer per frame, as the consumer may hold on to it
+          cv::Mat image;
+          source.getRawImage( 0, image );
+
+          {
+            std::lock_guard<std::mutex> lock( _mutex );
+            worker.frames.emplace_back( frame, image );
+            ++_buffered;
+          }
+          _ready.notify_all();
+        }
+
+        {
+          std::lock_guard<std::mutex> lock( _mutex );
+          worker.completed = c;
+        }
+        _ready.notify_all();
+      }
+    } catch( ... ) {
+      std::lock_guard<std::mutex> lock( _mutex );
+      worker.error = std::current_exception();
+    }
+
+    {
+      std::lock_guard<std::mutex> lock( _mutex );
+      worker.finished = true;
+    }
+    _ready.notify_all();
+  }
+
+  std::vector<ParallelVideoSource::Range> ParallelVideoSource::split( int numFrames, int parts )
+  {
+    std::vector<Range> ranges;
+    if( numFrames <= 0 ) return ranges;
+
+    parts = std::max( 1, std::min( parts, numFrames ) );
+    for( int p = 0; p < parts; ++p )
+      ranges.push_back( Range( int64_t(numFrames) * p / parts, int64_t(numFrames) * (p+1) / parts ) );
+
+    return ranges;
+  }
+
+  bool ParallelVideoSource::forEachFrame( const std::string &path, const FrameFunction &fn, int workers )
+  {
+    std::shared_ptr<VideoIndex> index( VideoIndex::open( path ) );
+    if( !index ) {
+      LOG(WARNING) << "ParallelVideoSource: unable to index " << path;
+      return false;
+    }
+
+    const std::vector<Range> ranges( split( index->numFrames(), numThreads( workers ) ) );
+    std::vector<std::exception_ptr> errors( ranges.size() );
+    std::vector<int> read( ranges.size(), 0 );
+
+    std::vector<std::thread> threads;
+    for( size_t r = 0; r < ranges.size(); ++r ) {
+      threads.emplace_back( [&, r]() {
+        try {
+          VideoSource source( path );
+          if( !source.isOpened() ) return;
+          source.useIndex( index );
+          source.skipTo( ranges[r].begin );
+
+          // The buffer is reused once fn returns
+          cv::Mat image;
+          for( int frame = ranges[r].begin; frame < ranges[r].end && source.grab(); ++frame ) {
+            source.getRawImage( 0, image );
+            fn( frame, image );
+            ++read[r];
+          }
+        } catch( ... ) {
+          errors[r] = std::current_exception();
+        }
+      } );
+    }
+
+    for( auto &thread : threads ) thread.join();
+
+    for( const auto &error : errors )
+      if( error ) std::rethrow_exception( error );
+
+    bool complete = true;
+    for( size_t r = 0; r < ranges.size(); ++r ) {
+      const int length = ranges[r].end - ranges[r].begin;
+      if( read[r] < length ) {
+        LOG(WARNING) << "ParallelVideoSource: read " << read[r] << " of frames " << ranges[r].begin << " to " << ranges[r].end - 1 << " of " << path;
+        complete = false;
+      }
+    }
+
+    return complete;
+  }
+
+}
@@ -0,0 +1,161 @@
+#include "libvideoio/PrefetchingSource.h"
+
+namespace libvideoio {
+
+  // True if nothing but m references its buffer
+  static bool isUnshared( const cv::Mat &m )
+  {
+    return m.u && m.u->refcount == 1;
+  }
+
+  PrefetchingSource::PrefetchingSource( const std::shared_ptr<ImageSource> &source, int depth )
+    : _source( source ),
+      _numFrames( 0 ),
+      _imageSize( 0, 0 ),
+      _cvtToRGB( -1 ),
+      _cvtToGray( -1 ),
+      _ring(),
+      _head( 0 ),
+      _count( 0 ),
+      _finished( false ),
+      _stop( false ),
+      _haveCurrent( false )
+  {
+    CHECK( (bool)_source ) << "PrefetchingSource needs a source";
+    CHECK( depth > 0 ) << "Prefetch depth must be at least 1";
+
+    _numImages = _source->numImages();
+    _hasDepth = _source->hasDepth();
+    setFPS( _source->fps() );
+
+    _numFrames = _source->numFrames();
+    _imageSize = _source->imageSize();
+    _cvtToRGB = _source->cvtToRGB();
+    _cvtToGray = _source->cvtToGray();
+    _outputType = _source->outputType();
+
+    _ring.resize( depth );
+    _thread = std::thread( &PrefetchingSource::prefetchLoop, this );
+  }
+
+  PrefetchingSource::~PrefetchingSource()
+  {
+    {
+      std::lock_guard<std::mutex> lock( _mutex );
+      _stop = true;
+    }
+    _space.notify_all();
+
+    // A frame being read is finished first
+    if( _thread.joinable() ) _thread.join();
+  }
+
+  bool PrefetchingSource::grab( void )
+  {
+    std::unique_lock<std::mutex> lock( _mutex );
+    _ready.wait( lock, [this]() { return _count > 0 || _finished; } );
+
+    if( _count == 0 ) {
+      _haveCurrent = false;
+      if( _error ) std::rethrow_exception( _error );
+      return false;
+    }
+
+    // The previous frame goes back to the ring, where its buffers are
+    // reused if the consumer has let go of them
+    std::swap( _current, _ring[_head] );
+    _head = (_head + 1) % _ring.size();
+    --_count;
+    _haveCurrent = true;
+
+    lock.unlock();
+    _space.notify_one();
+    return true;
+  }
+
+  int PrefetchingSource::getRawImage( int i, cv::Mat &mat )
+  {
+    if( !_haveCurrent || i < 0 || i >= (int)_current.images.size() ) return -1;
+
+    mat = _current.images[i];
+    return _current.results[i];
+  }
+
+  void PrefetchingSource::getDepth( cv::Mat &mat )
+  {
+    if( !_haveCurrent || !_hasDepth ) return;
+
+    mat = _current.depth;
+  }
+
+  void PrefetchingSource::setOutputType( int type )
+  {
+    // Read by the prefetch thread
+    std::lock_guard<std::mutex> lock( _mutex );
+    _outputType = type;
+  }
+
+  void PrefetchingSource::prefetchLoop( void )
+  {
+    try {
+      while( true ) {
+        size_t slot;
+        int outputType;
+        {
+          std::unique_lock<std::mutex> lock( _mutex );
+          _space.wait( lock, [this]() { return _stop || _count < _ring.size(); } );
+          if( _stop ) return;
+
+          // The consumer never touches slots past the ready frames
+          slot = (_head + _count) % _ring.size();
+          outputType = _outputType;
+        }
+
+        if( !_source->grab() ) break;
+        readFrame( _ring[slot], outputType );
+
+        {
+          std::lock_guard<std::mutex> lock( _mutex );
+          ++_count;
+        }
+        _ready.notify_one();
+      }
+    } catch( ... ) {
+      std::lock_guard<std::mutex> lock( _mutex );
+      _error = std::current_exception();
+    }
+
+    {
+      std::lock_guard<std::mutex> lock( _mutex );
+      _finished = true;
+    }
+    _ready.notify_all();
+  }
+
+  void PrefetchingSource::readFrame( Frame &frame, int outputType )
+  {
+    frame.images.resize( _numImages );
+    frame.results.resize( _numImages );
+
+    // The wrapped source converts (or not) in its getImage()
+    if( _source->outputType() != outputType ) _source->setOutputType( outputType );
+
+    for( int i = 0; i < _numImages; ++i ) {
+      cv::Mat &image( frame.images[i] );
+
+      // Decode into the slot's old buffer unless the consumer still holds it
+      if( !isUnshared( image ) ) image.release();
+      frame.results[i] = _source->getImage( i, image );
+
+      // The source may overwrite buffers it keeps a reference to
+      if( !image.empty() && !isUnshared( image ) ) image = image.clone();
+    }
+
+    if( _hasDepth ) {
+      if( !isUnshared( frame.depth ) ) frame.depth.release();
+      _source->getDepth( frame.depth );
+      if( !frame.depth.empty() && !isUnshared( frame.depth ) ) frame.depth = frame.depth.clone();
+    }
+  }
+
+}
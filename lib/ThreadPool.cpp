@@ -0,0 +1,138 @@
+
+#include "libvideoio/ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+namespace libvideoio {
+
+  ThreadPool::ThreadPool( unsigned int numWorkers )
+    : _workers(),
+      _queue(),
+      _stop( false )
+  {
+    for( unsigned int i = 0; i < numWorkers; ++i ) {
+      _workers.push_back( std::thread( &ThreadPool::workerLoop, this ) );
+    }
+  }
+
+  ThreadPool::~ThreadPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock( _mutex );
+      _stop = true;
+    }
+    _cond.notify_all();
+
+    for( auto &worker : _workers ) worker.join();
+  }
+
+  std::future<void> ThreadPool::submit( const std::function<void()> &task )
+  {
+    auto packaged = std::make_shared< std::packaged_task<void()> >( task );
+    std::future<void> result( packaged->get_future() );
+
+    if( _workers.empty() ) {
+      (*packaged)();
+      return result;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock( _mutex );
+      _queue.push_back( [packaged]() { (*packaged)(); } );
+    }
+    _cond.notify_one();
+
+    return result;
+  }
+
+  void ThreadPool::workerLoop( void )
+  {
+    while( true ) {
+      std::function<void()> task;
+
+      {
+        std::unique_lock<std::mutex> lock( _mutex );
+        _cond.wait( lock, [this]{ return _stop || !_queue.empty(); } );
+
+        if( _stop && _queue.empty() ) return;
+
+        task = std::move( _queue.front() );
+        _queue.pop_front();
+      }
+
+      task();
+    }
+  }
+
+  void ThreadPool::parallelFor( int begin, int end, int numBands,
+                                const std::function<void(int,int)> &fn )
+  {
+    const int n = end - begin;
+    if( n <= 0 ) return;
+
+    numBands = std::max( 1, std::min( numBands, n ) );
+    if( numBands == 1 || _workers.empty() ) {
+      fn( begin, end );
+      return;
+    }
+
+    // Bands are claimed dynamically by whichever thread gets to them first,
+    // so a helper task which is only dequeued after all bands have been
+    // claimed returns without touching fn.
+    struct Job {
+      Job() : next(0), done(0) {;}
+
+      std::atomic<int> next;
+      int done;
+      std::exception_ptr error;
+      std::mutex mutex;
+      std::condition_variable cond;
+    };
+
+    auto job = std::make_shared<Job>();
+    const std::function<void(int,int)> *func = &fn;
+
+    auto runBands = [job, func, begin, n, numBands]() {
+      int b;
+      while( (b = job->next.fetch_add(1)) < numBands ) {
+        const int b0 = begin + (long long)n * b / numBands;
+        const int b1 = begin + (long long)n * (b+1) / numBands;
+
+        std::exception_ptr error;
+        try {
+          (*func)( b0, b1 );
+        } catch(...) {
+          error = std::current_exception();
+        }
+
+        std::lock_guard<std::mutex> lock( job->mutex );
+        if( error && !job->error ) job->error = error;
+        if( ++job->done == numBands ) job->cond.notify_all();
+      }
+    };
+
+    {
+      std::lock_guard<std::mutex> lock( _mutex );
+      const int helpers = std::min<int>( numBands-1, _workers.size() );
+      for( int i = 0; i < helpers; ++i ) _queue.push_back( runBands );
+    }
+    _cond.notify_all();
+
+    runBands();
+
+    std::unique_lock<std::mutex> lock( job->mutex );
+    job->cond.wait( lock, [&job, numBands]{ return job->done == numBands; } );
+
+    if( job->error ) std::rethrow_exception( job->error );
+  }
+
+  ThreadPool &ThreadPool::global( void )
+  {
+    static ThreadPool pool( std::max( 1u, std::thread::hardware_concurrency() ) - 1 );
+    return pool;
+  }
+
+}
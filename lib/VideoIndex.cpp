@@ -0,0 +1,168 @@
+#include "libvideoio/VideoIndex.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include <boost/filesystem.hpp>
+
+#include "g3log/g3log.hpp"
+
+namespace fs = boost::filesystem;
+
+namespace libvideoio {
+
+  namespace {
+
+    const char Magic[8] = { 'L','V','I','O','V','I','D','X' };
+
+    struct FileHeader {
+      char magic[8];
+      uint32_t version;
+      uint32_t reserved;
+      uint64_t videoSize;
+      int64_t videoTime;
+      uint64_t count;
+    };
+
+    // Size and modification time identifying a version of the video
+    bool videoStamp( const std::string &videoPath, uint64_t &size, int64_t &time )
+    {
+      boost::system::error_code ec;
+      size = fs::file_size( videoPath, ec );
+      if( ec ) return false;
+      time = fs::last_write_time( videoPath, ec );
+      return !ec;
+    }
+
+  }
+
+  VideoIndex::VideoIndex( const std::vector<double> &timestamps )
+    : _timestamps( timestamps ),
+      _hasTimestamps( !timestamps.empty() )
+  {
+    for( size_t i = 1; i < _timestamps.size(); ++i ) {
+      if( !(_timestamps[i] > _timestamps[i-1]) ) {
+        _hasTimestamps = false;
+        break;
+      }
+    }
+  }
+
+  std::shared_ptr<VideoIndex> VideoIndex::build( cv::VideoCapture &capture )
+  {
+    std::vector<double> timestamps;
+    while( capture.grab() ) timestamps.push_back( capture.get( cv::CAP_PROP_POS_MSEC ) );
+
+    return std::make_shared<VideoIndex>( timestamps );
+  }
+
+  std::shared_ptr<VideoIndex> VideoIndex::load( const std::string &videoPath )
+  {
+    uint64_t size;
+    int64_t time;
+    if( !videoStamp( videoPath, size, time ) ) return nullptr;
+
+    std::ifstream in( sidecarPath( videoPath ), std::ios::binary );
+    if( !in ) return nullptr;
+
+    FileHeader header;
+    if( !in.read( reinterpret_cast<char *>( &header ), sizeof(header) ) ) return nullptr;
+
+    if( memcmp( header.magic, Magic, sizeof(Magic) ) != 0 || header.version != FormatVersion ) {
+      LOG(WARNING) << "Ignoring malformed video index " << sidecarPath( videoPath );
+      return nullptr;
+    }
+
+    if( header.videoSize != size || header.videoTime != time ) {
+      LOG(INFO) << "Video index " << sidecarPath( videoPath ) << " is out of date";
+      return nullptr;
+    }
+
+    // The count is only trusted as far as the file backs it
+    boost::system::error_code ec;
+    const uint64_t fileSize = fs::file_size( sidecarPath( videoPath ), ec );
+    if( ec || fileSize < sizeof(header) || header.count != (fileSize - sizeof(header)) / sizeof(double) ) {
+      LOG(WARNING) << "Ignoring truncated video index " << sidecarPath( videoPath );
+      return nullptr;
+    }
+
+    std::vector<double> timestamps( header.count );
+    if( !in.read( reinterpret_cast<char *>( timestamps.data() ), timestamps.size() * sizeof(double) ) ) {
+      LOG(WARNING) << "Ignoring truncated video index " << sidecarPath( videoPath );
+      return nullptr;
+    }
+
+    return std::make_shared<VideoIndex>( timestamps );
+  }
+
+  bool VideoIndex::save( const std::string &videoPath ) const
+  {
+    FileHeader header;
+    memset( &header, 0, sizeof(header) );
+    memcpy( header.magic, Magic, sizeof(Magic) );
+    header.version = FormatVersion;
+    header.count = _timestamps.size();
+
+    if( !videoStamp( videoPath, header.videoSize, header.videoTime ) ) {
+      LOG(WARNING) << "Unable to stat " << videoPath << ", not saving its index";
+      return false;
+    }
+
+    // Written under a temporary name and renamed, so readers never see a
+    // partial file
+    const std::string path( sidecarPath( videoPath ) );
+    const std::string tmp( path + ".tmp" );
+    {
+      std::ofstream out( tmp, std::ios::binary | std::ios::trunc );
+      out.write( reinterpret_cast<const char *>( &header ), sizeof(header) );
+      out.write( reinterpret_cast<const char *>( _timestamps.data() ), _timestamps.size() * sizeof(double) );
+
+      if( !out ) {
+        LOG(WARNING) << "Unable to write video index " << path;
+        out.close();
+        boost::system::error_code ec;
+        fs::remove( tmp, ec );
+        return false;
+      }
+    }
+
+    boost::system::error_code ec;
+    fs::rename( tmp, path, ec );
+    if( ec ) {
+      LOG(WARNING) << "Unable to write video index " << path << ": " << ec.message();
+      fs::remove( tmp, ec );
+      return false;
+    }
+
+    return true;
+  }
+
+  std::shared_ptr<VideoIndex> VideoIndex::open( const std::string &videoPath )
+  {
+    std::shared_ptr<VideoIndex> index( load( videoPath ) );
+    if( index ) return index;
+
+    cv::VideoCapture capture( videoPath );
+    if( !capture.isOpened() ) return nullptr;
+
+    LOG(INFO) << "Indexing " << videoPath;
+    index = build( capture );
+    index->save( videoPath );
+    return index;
+  }
+
+  int VideoIndex::frameAt( double ms ) const
+  {
+    if( _timestamps.empty() ) return -1;
+
+    const auto after = std::lower_bound( _timestamps.begin(), _timestamps.end(), ms );
+    if( after == _timestamps.begin() ) return 0;
+    if( after == _timestamps.end() ) return _timestamps.size() - 1;
+
+    // The nearer of the frames either side
+    const auto before = after - 1;
+    return ( (ms - *before) <= (*after - ms) ? before : after ) - _timestamps.begin();
+  }
+
+}
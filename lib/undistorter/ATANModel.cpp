@@ -0,0 +1,244 @@
+
+#include "ATANModel.h"
+#include "libvideoio/ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  #define LIBVIDEOIO_ATAN_X86
+  #include <immintrin.h>
+#endif
+
+namespace libvideoio {
+namespace remap {
+
+  // atan(z)/z - 1 = z^2 * P(z^2) on [0,1], coefficients a2 .. a16
+  static const float AtanCoeffs[8] = {
+    -0.3333314528f, 0.1999355085f, -0.1420889944f, 0.1065626393f,
+    -0.0752896400f, 0.0429096138f, -0.0161657367f, 0.0028662257f };
+
+  static const float HalfPi = 1.57079632679f;
+
+  // Rows processed per ThreadPool band
+  static const int RowsPerBand = 16;
+
+  float atanApprox( float t )
+  {
+    const bool invert = t > 1.0f;
+    const float z = invert ? 1.0f / t : t;
+    const float z2 = z * z;
+
+    float p = AtanCoeffs[7];
+    for( int i = 6; i >= 0; --i ) p = p * z2 + AtanCoeffs[i];
+
+    const float a = z + z * z2 * p;
+    return invert ? HalfPi - a : a;
+  }
+
+  // Parameters shared by the row kernels
+  struct ATANRow {
+    ATANRow( const ATANModel &m, int inWidth, int inHeight )
+      : model(m),
+        d2t( 2.0f * std::tan( m.dist / 2.0f ) ),
+        maxX( inWidth - 1 ), maxY( inHeight - 1 )
+      {;}
+
+    const ATANModel &model;
+    float d2t;
+    float maxX, maxY;
+  };
+
+  // Applies PTAM's "rounding resistant" nudges and validity test to one
+  // source coordinate pair
+  static inline void storeCoordinate( const ATANRow &r, float ix, float iy, float *mapX, float *mapY )
+  {
+    if( ix == 0 ) ix = 0.01f;
+    if( iy == 0 ) iy = 0.01f;
+    if( ix == r.maxX ) ix = r.maxX - 0.01f;
+    if( iy == r.maxY ) iy = r.maxY - 0.01f;
+
+    if( ix > 0 && iy > 0 && ix < r.maxX && iy < r.maxY ) {
+      *mapX = ix;
+      *mapY = iy;
+    } else {
+      *mapX = *mapY = -1;
+    }
+  }
+
+  static void atanRow_scalar( const ATANRow &r, int y, int x0, int x1, float *mapX, float *mapY )
+  {
+    const ATANModel &m( r.model );
+    const float iy = (y - m.ocy) / m.ofy;
+
+    for( int x = x0; x < x1; ++x ) {
+      const float ix = (x - m.ocx) / m.ofx;
+      const float rad = std::sqrt( ix*ix + iy*iy );
+      const float fac = (rad == 0 || m.dist == 0) ? 1.0f : atanApprox( rad * r.d2t ) / (m.dist * rad);
+
+      storeCoordinate( r, m.fx*fac*ix + m.cx, m.fy*fac*iy + m.cy, mapX + x, mapY + x );
+    }
+  }
+
+#ifdef LIBVIDEOIO_ATAN_X86
+
+  __attribute__((target("sse4.1")))
+  static inline __m128 atan4_sse41( __m128 t )
+  {
+    const __m128 one = _mm_set1_ps( 1.0f );
+    const __m128 invert = _mm_cmpgt_ps( t, one );
+    const __m128 z = _mm_blendv_ps( t, _mm_div_ps( one, t ), invert );
+    const __m128 z2 = _mm_mul_ps( z, z );
+
+    __m128 p = _mm_set1_ps( AtanCoeffs[7] );
+    for( int i = 6; i >= 0; --i ) p = _mm_add_ps( _mm_mul_ps( p, z2 ), _mm_set1_ps( AtanCoeffs[i] ) );
+
+    const __m128 a = _mm_add_ps( z, _mm_mul_ps( _mm_mul_ps( z, z2 ), p ) );
+    return _mm_blendv_ps( a, _mm_sub_ps( _mm_set1_ps( HalfPi ), a ), invert );
+  }
+
+  // Nudges and validity test of storeCoordinate(), four lanes at a time
+  __attribute__((target("sse4.1")))
+  static inline void store4_sse41( __m128 ix, __m128 iy, __m128 maxX, __m128 maxY, float *mapX, float *mapY )
+  {
+    const __m128 zero = _mm_setzero_ps(), nudge = _mm_set1_ps( 0.01f );
+
+    ix = _mm_blendv_ps( ix, nudge, _mm_cmpeq_ps( ix, zero ) );
+    iy = _mm_blendv_ps( iy, nudge, _mm_cmpeq_ps( iy, zero ) );
+    ix = _mm_blendv_ps( ix, _mm_sub_ps( maxX, nudge ), _mm_cmpeq_ps( ix, maxX ) );
+    iy = _mm_blendv_ps( iy, _mm_sub_ps( maxY, nudge ), _mm_cmpeq_ps( iy, maxY ) );
+
+    const __m128 valid = _mm_and_ps( _mm_and_ps( _mm_cmpgt_ps( ix, zero ), _mm_cmpgt_ps( iy, zero ) ),
+                                     _mm_and_ps( _mm_cmplt_ps( ix, maxX ), _mm_cmplt_ps( iy, maxY ) ) );
+
+    const __m128 invalid = _mm_set1_ps( -1.0f );
+    _mm_storeu_ps( mapX, _mm_blendv_ps( invalid, ix, valid ) );
+    _mm_storeu_ps( mapY, _mm_blendv_ps( invalid, iy, valid ) );
+  }
+
+  __attribute__((target("sse4.1")))
+  static void atanRow_sse41( const ATANRow &r, int y, int x0, int x1, float *mapX, float *mapY )
+  {
+    const ATANModel &m( r.model );
+    const float iyScalar = (y - m.ocy) / m.ofy;
+
+    const __m128 iy = _mm_set1_ps( iyScalar ), iy2 = _mm_mul_ps( iy, iy );
+    const __m128 ocx = _mm_set1_ps( m.ocx ), ofx = _mm_set1_ps( m.ofx );
+    const __m128 fx = _mm_set1_ps( m.fx ), fy = _mm_set1_ps( m.fy );
+    const __m128 cx = _mm_set1_ps( m.cx ), cy = _mm_set1_ps( m.cy );
+    const __m128 d2t = _mm_set1_ps( r.d2t ), dist = _mm_set1_ps( m.dist );
+    const __m128 maxX = _mm_set1_ps( r.maxX ), maxY = _mm_set1_ps( r.maxY );
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps( 1.0f );
+
+    int x = x0;
+    for( ; x + 4 <= x1; x += 4 ) {
+      const __m128 xs = _mm_add_ps( _mm_set1_ps( x ), _mm_setr_ps( 0, 1, 2, 3 ) );
+      const __m128 ix = _mm_div_ps( _mm_sub_ps( xs, ocx ), ofx );
+      const __m128 rad = _mm_sqrt_ps( _mm_add_ps( _mm_mul_ps( ix, ix ), iy2 ) );
+
+      const __m128 fac = _mm_blendv_ps( _mm_div_ps( atan4_sse41( _mm_mul_ps( rad, d2t ) ), _mm_mul_ps( dist, rad ) ),
+                                        one, _mm_cmpeq_ps( rad, zero ) );
+
+      store4_sse41( _mm_add_ps( _mm_mul_ps( _mm_mul_ps( fx, fac ), ix ), cx ),
+                    _mm_add_ps( _mm_mul_ps( _mm_mul_ps( fy, fac ), iy ), cy ),
+                    maxX, maxY, mapX + x, mapY + x );
+    }
+
+    atanRow_scalar( r, y, x, x1, mapX, mapY );
+  }
+
+  __attribute__((target("avx2")))
+  static inline __m256 atan8_avx2( __m256 t )
+  {
+    const __m256 one = _mm256_set1_ps( 1.0f );
+    const __m256 invert = _mm256_cmp_ps( t, one, _CMP_GT_OQ );
+    const __m256 z = _mm256_blendv_ps( t, _mm256_div_ps( one, t ), invert );
+    const __m256 z2 = _mm256_mul_ps( z, z );
+
+    __m256 p = _mm256_set1_ps( AtanCoeffs[7] );
+    for( int i = 6; i >= 0; --i ) p = _mm256_add_ps( _mm256_mul_ps( p, z2 ), _mm256_set1_ps( AtanCoeffs[i] ) );
+
+    const __m256 a = _mm256_add_ps( z, _mm256_mul_ps( _mm256_mul_ps( z, z2 ), p ) );
+    return _mm256_blendv_ps( a, _mm256_sub_ps( _mm256_set1_ps( HalfPi ), a ), invert );
+  }
+
+  __attribute__((target("avx2")))
+  static inline void store8_avx2( __m256 ix, __m256 iy, __m256 maxX, __m256 maxY, float *mapX, float *mapY )
+  {
+    const __m256 zero = _mm256_setzero_ps(), nudge = _mm256_set1_ps( 0.01f );
+
+    ix = _mm256_blendv_ps( ix, nudge, _mm256_cmp_ps( ix, zero, _CMP_EQ_OQ ) );
+    iy = _mm256_blendv_ps( iy, nudge, _mm256_cmp_ps( iy, zero, _CMP_EQ_OQ ) );
+    ix = _mm256_blendv_ps( ix, _mm256_sub_ps( maxX, nudge ), _mm256_cmp_ps( ix, maxX, _CMP_EQ_OQ ) );
+    iy = _mm256_blendv_ps( iy, _mm256_sub_ps( maxY, nudge ), _mm256_cmp_ps( iy, maxY, _CMP_EQ_OQ ) );
+
+    const __m256 valid = _mm256_and_ps( _mm256_and_ps( _mm256_cmp_ps( ix, zero, _CMP_GT_OQ ), _mm256_cmp_ps( iy, zero, _CMP_GT_OQ ) ),
+                                        _mm256_and_ps( _mm256_cmp_ps( ix, maxX, _CMP_LT_OQ ), _mm256_cmp_ps( iy, maxY, _CMP_LT_OQ ) ) );
+
+    const __m256 invalid = _mm256_set1_ps( -1.0f );
+    _mm256_storeu_ps( mapX, _mm256_blendv_ps( invalid, ix, valid ) );
+    _mm256_storeu_ps( mapY, _mm256_blendv_ps( invalid, iy, valid ) );
+  }
+
+  __attribute__((target("avx2")))
+  static void atanRow_avx2( const ATANRow &r, int y, int x0, int x1, float *mapX, float *mapY )
+  {
+    const ATANModel &m( r.model );
+    const float iyScalar = (y - m.ocy) / m.ofy;
+
+    const __m256 iy = _mm256_set1_ps( iyScalar ), iy2 = _mm256_mul_ps( iy, iy );
+    const __m256 ocx = _mm256_set1_ps( m.ocx ), ofx = _mm256_set1_ps( m.ofx );
+    const __m256 fx = _mm256_set1_ps( m.fx ), fy = _mm256_set1_ps( m.fy );
+    const __m256 cx = _mm256_set1_ps( m.cx ), cy = _mm256_set1_ps( m.cy );
+    const __m256 d2t = _mm256_set1_ps( r.d2t ), dist = _mm256_set1_ps( m.dist );
+    const __m256 maxX = _mm256_set1_ps( r.maxX ), maxY = _mm256_set1_ps( r.maxY );
+    const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps( 1.0f );
+
+    int x = x0;
+    for( ; x + 8 <= x1; x += 8 ) {
+      const __m256 xs = _mm256_add_ps( _mm256_set1_ps( x ), _mm256_setr_ps( 0, 1, 2, 3, 4, 5, 6, 7 ) );
+      const __m256 ix = _mm256_div_ps( _mm256_sub_ps( xs, ocx ), ofx );
+      const __m256 rad = _mm256_sqrt_ps( _mm256_add_ps( _mm256_mul_ps( ix, ix ), iy2 ) );
+
+      const __m256 fac = _mm256_blendv_ps( _mm256_div_ps( atan8_avx2( _mm256_mul_ps( rad, d2t ) ), _mm256_mul_ps( dist, rad ) ),
+                                           one, _mm256_cmp_ps( rad, zero, _CMP_EQ_OQ ) );
+
+      store8_avx2( _mm256_add_ps( _mm256_mul_ps( _mm256_mul_ps( fx, fac ), ix ), cx ),
+                   _mm256_add_ps( _mm256_mul_ps( _mm256_mul_ps( fy, fac ), iy ), cy ),
+                   maxX, maxY, mapX + x, mapY + x );
+    }
+
+    atanRow_scalar( r, y, x, x1, mapX, mapY );
+  }
+
+#endif
+
+  void buildATANMap( const ATANModel &model,
+                     int inWidth, int inHeight, int outWidth, int outHeight,
+                     float *mapX, float *mapY,
+                     KernelLevel level )
+  {
+    typedef void (*RowFunc)( const ATANRow &, int, int, int, float *, float * );
+
+    // Without distortion the factor is 1 everywhere, which the vector
+    // kernels (dividing by dist) don't special-case
+    RowFunc rowFunc = atanRow_scalar;
+#ifdef LIBVIDEOIO_ATAN_X86
+    if( model.dist != 0 ) {
+      if( level >= KERNEL_AVX2 ) rowFunc = atanRow_avx2;
+      else if( level >= KERNEL_SSE41 ) rowFunc = atanRow_sse41;
+    }
+#endif
+
+    const ATANRow row( model, inWidth, inHeight );
+    const int numBands = (outHeight + RowsPerBand - 1) / RowsPerBand;
+
+    ThreadPool::global().parallelFor( 0, outHeight, numBands, [&]( int y0, int y1 ) {
+      for( int y = y0; y < y1; ++y ) {
+        rowFunc( row, y, 0, outWidth, mapX + y*outWidth, mapY + y*outWidth );
+      }
+    });
+  }
+
+}
+}
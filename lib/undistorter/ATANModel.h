@@ -0,0 +1,44 @@
+#pragma once
+
+#include "RemapKernels.h"
+
+// Map generation for PTAM's ATAN ("field of view") distortion model,
+// shared by PTAMUndistorter and anything else which needs the model's
+// coordinate maps.
+
+namespace libvideoio {
+namespace remap {
+
+  struct ATANModel {
+    // Distorted (input) camera, in pixels, and the model's w parameter
+    float fx, fy, cx, cy;
+    float dist;
+
+    // Undistorted (output) pinhole camera, in pixels
+    float ofx, ofy, ocx, ocy;
+  };
+
+  // Polynomial approximation of atan(t) for t >= 0 (Abramowitz & Stegun
+  // 4.4.49 after reduction to [0,1]).  Within 2e-7 rad of std::atan in
+  // float arithmetic;  the vectorized map builder uses the same polynomial.
+  float atanApprox( float t );
+
+  // Incremented whenever buildATANMap() produces different maps for the
+  // same model, so cached tables built by an older generator miss.  1 was
+  // the original double-precision atan loop.
+  static const int ATAN_MAP_VERSION = 2;
+
+  // Fills the outWidth x outHeight float maps of input coordinates for the
+  // model, marking pixels whose source falls outside the input image with
+  // -1 (the convention expected by RemapTable::build).
+  //
+  // Rows are spread across the global ThreadPool.  Relative to evaluating
+  // the model with double-precision atan, coordinates differ by well under
+  // 1e-3 pixels for any image size the int16 RemapTable can address.
+  void buildATANMap( const ATANModel &model,
+                     int inWidth, int inHeight, int outWidth, int outHeight,
+                     float *mapX, float *mapY,
+                     KernelLevel level = kernelLevel() );
+
+}
+}
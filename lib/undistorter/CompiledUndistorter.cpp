@@ -0,0 +1,115 @@
+
+#include "libvideoio/Undistorter.h"
+#include "ConvertingRemap.h"
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+namespace libvideoio
+{
+
+CompiledUndistorter *CompiledUndistorter::compile( const std::shared_ptr<Undistorter> &chain )
+{
+  if( !chain ) return nullptr;
+
+  cv::Mat mapX, mapY;
+  if( !chain->getSourceMap( mapX, mapY ) ) {
+    LOG(WARNING) << "Unable to compile undistorter \"" << chain->name() << "\", not all stages support coordinate maps";
+    return nullptr;
+  }
+
+  // The fused map samples the input of the innermost undistorter
+  Undistorter *innermost = chain.get();
+  while( innermost->wrapped() ) innermost = innermost->wrapped().get();
+
+  return new CompiledUndistorter( chain, innermost->inputImageSize(), mapX, mapY );
+}
+
+CompiledUndistorter::CompiledUndistorter( const std::shared_ptr<Undistorter> &chain,
+                                          const ImageSize &inputSize,
+                                          const cv::Mat &mapX, const cv::Mat &mapY )
+  : Undistorter(),
+    _chain( chain ),
+    _inputSize( inputSize )
+{
+  setName( chain->name() + " (compiled)" );
+  cv::convertMaps( mapX, mapY, _map1, _map2, CV_16SC2 );
+}
+
+void CompiledUndistorter::undistort( const cv::Mat &image, cv::OutputArray result ) const
+{
+  // A header of its own, as result may be the same Mat as image
+  cv::Mat source( image );
+  result.create( _map1.size(), image.type() );
+  cv::Mat out( result.getMat() );
+  source = unaliased( source, out );
+
+  forEachBand( out.rows, [&]( int y0, int y1 ) {
+    cv::Mat band( out.rowRange(y0, y1) );
+    cv::remap( source, band, _map1.rowRange(y0, y1), _map2.rowRange(y0, y1),
+               cv::INTER_LINEAR, cv::BORDER_CONSTANT );
+  });
+}
+
+void CompiledUndistorter::undistortDepth( const cv::Mat &depth, cv::OutputArray result ) const
+{
+  cv::Mat source( depth );
+  result.create( _map1.size(), depth.type() );
+  cv::Mat out( result.getMat() );
+  source = unaliased( source, out );
+
+  forEachBand( out.rows, [&]( int y0, int y1 ) {
+    remapDepthRows( source, _map1, _map2, out, y0, y1 );
+  });
+}
+
+// As OpenCVUndistorter::undistortRGBD
+static const int RGBDRows = 8;
+
+void CompiledUndistorter::undistortRGBD( const cv::Mat &image, const cv::Mat &depth,
+                                         cv::OutputArray result, cv::OutputArray depthResult ) const
+{
+  cv::Mat source( image ), depthSource( depth );
+  result.create( _map1.size(), image.type() );
+  depthResult.create( _map1.size(), depth.type() );
+  cv::Mat out( result.getMat() ), depthOut( depthResult.getMat() );
+  source = unaliased( unaliased( source, out ), depthOut );
+  depthSource = unaliased( unaliased( depthSource, out ), depthOut );
+
+  forEachBand( out.rows, [&]( int y0, int y1 ) {
+    for( int y = y0; y < y1; y += RGBDRows ) {
+      const int yEnd = std::min( y + RGBDRows, y1 );
+
+      cv::Mat band( out.rowRange(y, yEnd) );
+      cv::remap( source, band, _map1.rowRange(y, yEnd), _map2.rowRange(y, yEnd),
+                 cv::INTER_LINEAR, cv::BORDER_CONSTANT );
+      remapDepthRows( depthSource, _map1, _map2, depthOut, y, yEnd );
+    }
+  });
+}
+
+void CompiledUndistorter::convertAndUndistort( const cv::Mat &image, cv::OutputArray result,
+                                               int code, int rdepth, double alpha, double beta ) const
+{
+  remap::ConvertingRemap fused;
+  if( !fused.init( image, code, rdepth, alpha, beta ) ) {
+    Undistorter::convertAndUndistort( image, result, code, rdepth, alpha, beta );
+    return;
+  }
+
+  cv::Mat source( image );
+  result.create( _map1.size(), fused.resultType );
+  cv::Mat out( result.getMat() );
+  source = unaliased( source, out );
+
+  forEachBand( out.rows, [&]( int y0, int y1 ) {
+    fused.remapRows( source, _map1, _map2, out, y0, y1 );
+  });
+}
+
+bool CompiledUndistorter::getSourceMap( cv::Mat &mapX, cv::Mat &mapY ) const
+{
+  cv::convertMaps( _map1, _map2, mapX, mapY, CV_32FC1 );
+  return true;
+}
+
+}
@@ -0,0 +1,98 @@
+
+#include "ConvertingRemap.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+namespace libvideoio {
+namespace remap {
+
+  bool ConvertingRemap::init( const cv::Mat &image, int code, int rdepth, double alpha, double beta )
+  {
+    if( image.depth() != CV_8U ) return false;
+
+    // cv::cvtColor's luma weights
+    const float R = 0.299f, G = 0.587f, B = 0.114f;
+
+    const int srcChannels = image.channels();
+    int dstChannels = srcChannels;
+    float weights[4] = { 0, 0, 0, 0 };
+
+    switch( code ) {
+      case -1:
+        break;
+      case cv::COLOR_BGR2GRAY:
+      case cv::COLOR_BGRA2GRAY:
+        if( srcChannels != (code == cv::COLOR_BGR2GRAY ? 3 : 4) ) return false;
+        weights[0] = B;  weights[1] = G;  weights[2] = R;
+        dstChannels = 1;
+        break;
+      case cv::COLOR_RGB2GRAY:
+      case cv::COLOR_RGBA2GRAY:
+        if( srcChannels != (code == cv::COLOR_RGB2GRAY ? 3 : 4) ) return false;
+        weights[0] = R;  weights[1] = G;  weights[2] = B;
+        dstChannels = 1;
+        break;
+      default:
+        return false;
+    }
+
+    Depth depth;
+    switch( rdepth ) {
+      case CV_8U:  depth = DEPTH_8U;  break;
+      case CV_32F: depth = DEPTH_32F; break;
+      default:     return false;
+    }
+
+    kernel = convertingBilinearFunc( srcChannels, dstChannels, depth );
+    if( !kernel ) return false;
+
+    std::copy( weights, weights + 4, conversion.weights );
+    conversion.alpha = alpha;
+    conversion.beta = beta;
+    resultType = CV_MAKETYPE( rdepth, dstChannels );
+    return true;
+  }
+
+  void ConvertingRemap::remapRows( const cv::Mat &image, const cv::Mat &map1, const cv::Mat &map2,
+                                   cv::Mat &out, int y0, int y1 ) const
+  {
+    const SourceImage src( image.data, image.step, image.cols, image.rows );
+
+    for( int y = y0; y < y1; ++y ) {
+      kernel( src, map1.ptr<int16_t>(y), map2.ptr<uint16_t>(y), cv::INTER_BITS, conversion, out.ptr(y), out.cols );
+    }
+  }
+
+  void ConvertingRemap::remapTile( const cv::Mat &image, const RemapTable &table, const Tile &tile,
+                                   cv::Mat &out ) const
+  {
+    const SourceImage src( image.data, image.step, image.cols, image.rows );
+    const size_t pixelSize = out.elemSize();
+
+    for( int y = tile.y0; y < tile.y1; ++y ) {
+      const int16_t *xy = table.xyRow( y );
+      const uint16_t *frac = table.fracRow( y );
+      uint8_t *dst = out.ptr(y);
+
+      // As remapSpan(), with the conversion passed through
+      int x = tile.x0;
+      for( const Span *span = table.spansBegin( y ); span != table.spansEnd( y ); ++span ) {
+        if( span->end <= x ) continue;
+
+        const int b = std::max( span->begin, x ), e = std::min( span->end, tile.x1 );
+        if( b >= e ) break;
+
+        memset( dst + x*pixelSize, 0, (b - x) * pixelSize );
+        kernel( src, xy + 2*b, frac + b, table.fracBits, conversion, dst + b*pixelSize, e - b );
+        x = e;
+      }
+
+      if( x < tile.x1 ) memset( dst + x*pixelSize, 0, (tile.x1 - x) * pixelSize );
+    }
+  }
+
+}
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include "RemapKernels.h"
+
+// OpenCV-facing side of the converting kernels:  maps the arguments of
+// Undistorter::convertAndUndistort() to a kernel, and runs it over rows of
+// fixed-point maps or a packed RemapTable.
+
+namespace libvideoio {
+namespace remap {
+
+  struct ConvertingRemap {
+    ConvertingRemap()
+      : kernel( nullptr ), resultType( -1 ) {;}
+
+    // Selects the kernel converting image with the cv::cvtColor code
+    // (or -1 for none) to depth rdepth, scaled by alpha and beta.  Returns
+    // false if the combination has no fused kernel.
+    bool init( const cv::Mat &image, int code, int rdepth, double alpha, double beta );
+
+    // Remaps rows [y0,y1) through CV_16SC2 + CV_16UC1 maps as produced
+    // by cv::convertMaps into the same rows of out
+    void remapRows( const cv::Mat &image, const cv::Mat &map1, const cv::Mat &map2,
+                    cv::Mat &out, int y0, int y1 ) const;
+
+    // Remaps a tile of a packed table into out, which covers the whole
+    // table;  pixels outside the table's spans are set to 0
+    void remapTile( const cv::Mat &image, const RemapTable &table, const Tile &tile,
+                    cv::Mat &out ) const;
+
+    ConvertingRemapFunc kernel;
+    Conversion conversion;
+    int resultType;
+  };
+
+}
+}
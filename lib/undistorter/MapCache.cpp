@@ -0,0 +1,268 @@
+
+#include "libvideoio/MapCache.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <boost/filesystem.hpp>
+
+#include "g3log/g3log.hpp"
+
+namespace fs = boost::filesystem;
+
+namespace libvideoio {
+
+  namespace {
+
+    const char Magic[8] = { 'L','V','I','O','M','A','P','S' };
+    const char Extension[] = ".lviomap";
+
+    // Offsets of map data are aligned for SIMD loads
+    const uint64_t DataAlignment = 64;
+
+    struct FileHeader {
+      char magic[8];
+      uint32_t version;
+      uint32_t count;
+      uint64_t key;
+      uint64_t fileSize;
+    };
+
+    struct MatHeader {
+      int32_t rows, cols, type, reserved;
+      uint64_t offset, bytes;
+    };
+
+    uint64_t align( uint64_t offset )
+    {
+      return (offset + DataAlignment - 1) / DataAlignment * DataAlignment;
+    }
+
+    std::mutex DirectoryMutex;
+    bool DirectoryInitialized = false;
+    std::string Directory;
+
+  }
+
+  //==== MapCache::Key ====
+
+  // 64-bit FNV-1a
+  static const uint64_t FnvOffset = 14695981039346656037ULL;
+  static const uint64_t FnvPrime = 1099511628211ULL;
+
+  MapCache::Key::Key( const std::string &kind )
+    : _hash( FnvOffset )
+  {
+    add( kind );
+    add( (int)FormatVersion );
+  }
+
+  MapCache::Key &MapCache::Key::add( const void *data, size_t bytes )
+  {
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    for( size_t i = 0; i < bytes; ++i ) {
+      _hash ^= p[i];
+      _hash *= FnvPrime;
+    }
+    return *this;
+  }
+
+  MapCache::Key &MapCache::Key::add( const std::string &str )
+  {
+    add( (int)str.size() );
+    return add( str.data(), str.size() );
+  }
+
+  MapCache::Key &MapCache::Key::add( const cv::Mat &mat )
+  {
+    add( mat.rows ).add( mat.cols ).add( mat.type() );
+    for( int y = 0; y < mat.rows; ++y ) {
+      add( mat.ptr(y), mat.cols * mat.elemSize() );
+    }
+    return *this;
+  }
+
+  std::string MapCache::Key::filename() const
+  {
+    char buf[32];
+    snprintf( buf, sizeof(buf), "%016llx", (unsigned long long)_hash );
+    return std::string(buf) + Extension;
+  }
+
+  //==== MapCache::Maps ====
+
+  MapCache::Maps::~Maps()
+  {
+    if( _addr ) munmap( _addr, _length );
+  }
+
+  //==== MapCache ====
+
+  void MapCache::setDirectory( const std::string &dir )
+  {
+    std::lock_guard<std::mutex> lock( DirectoryMutex );
+    Directory = dir;
+    DirectoryInitialized = true;
+  }
+
+  std::string MapCache::directory()
+  {
+    std::lock_guard<std::mutex> lock( DirectoryMutex );
+    if( !DirectoryInitialized ) {
+      const char *env = getenv( "LIBVIDEOIO_MAP_CACHE" );
+      if( env ) Directory = env;
+      DirectoryInitialized = true;
+    }
+    return Directory;
+  }
+
+  std::shared_ptr<const MapCache::Maps> MapCache::load( const Key &key, size_t count )
+  {
+    const std::string dir( directory() );
+    if( dir.empty() ) return nullptr;
+
+    const fs::path path( fs::path(dir) / key.filename() );
+
+    const int fd = open( path.c_str(), O_RDONLY );
+    if( fd < 0 ) return nullptr;
+
+    struct stat st;
+    if( fstat( fd, &st ) != 0 || (size_t)st.st_size < sizeof(FileHeader) ) {
+      close( fd );
+      return nullptr;
+    }
+
+    const size_t length = st.st_size;
+    void *addr = mmap( nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if( addr == MAP_FAILED ) return nullptr;
+
+    // Owns the mapping from here on, including on the early returns
+    std::shared_ptr<Maps> maps( new Maps( addr, length ) );
+
+    const uint8_t *base = static_cast<const uint8_t *>(addr);
+    const FileHeader *header = reinterpret_cast<const FileHeader *>(base);
+
+    if( memcmp( header->magic, Magic, sizeof(Magic) ) != 0 ||
+        header->version != FormatVersion ||
+        header->key != key.hash() ||
+        header->fileSize != length ||
+        header->count != count ||
+        sizeof(FileHeader) + count * sizeof(MatHeader) > length ) {
+      LOG(INFO) << "Ignoring stale map cache entry " << path.string();
+      return nullptr;
+    }
+
+    const MatHeader *mats = reinterpret_cast<const MatHeader *>(base + sizeof(FileHeader));
+    for( size_t i = 0; i < count; ++i ) {
+      const MatHeader &m( mats[i] );
+
+      if( m.rows < 0 || m.cols < 0 || m.offset + m.bytes > length ||
+          (uint64_t)m.rows * m.cols * CV_ELEM_SIZE(m.type) != m.bytes ) {
+        LOG(WARNING) << "Corrupt map cache entry " << path.string();
+        return nullptr;
+      }
+
+      maps->_mats.push_back( cv::Mat( m.rows, m.cols, m.type, const_cast<uint8_t *>(base + m.offset) ) );
+    }
+
+    return maps;
+  }
+
+  bool MapCache::store( const Key &key, const std::vector<cv::Mat> &mats )
+  {
+    const std::string dir( directory() );
+    if( dir.empty() ) return false;
+
+    boost::system::error_code ec;
+    fs::create_directories( dir, ec );
+    if( ec ) {
+      LOG(WARNING) << "Unable to create map cache directory " << dir << ": " << ec.message();
+      return false;
+    }
+
+    std::vector<MatHeader> headers( mats.size() );
+    uint64_t offset = align( sizeof(FileHeader) + mats.size() * sizeof(MatHeader) );
+
+    for( size_t i = 0; i < mats.size(); ++i ) {
+      MatHeader &m( headers[i] );
+      memset( &m, 0, sizeof(m) );
+
+      m.rows = mats[i].rows;
+      m.cols = mats[i].cols;
+      m.type = mats[i].type();
+      m.offset = offset;
+      m.bytes = (uint64_t)mats[i].rows * mats[i].cols * mats[i].elemSize();
+
+      offset = align( offset + m.bytes );
+    }
+
+    FileHeader header;
+    memset( &header, 0, sizeof(header) );
+    memcpy( header.magic, Magic, sizeof(Magic) );
+    header.version = FormatVersion;
+    header.count = mats.size();
+    header.key = key.hash();
+    header.fileSize = headers.empty() ? align( sizeof(FileHeader) )
+                                      : headers.back().offset + headers.back().bytes;
+
+    // Write to a temporary file and rename, so concurrent processes
+    // never see a partial entry
+    const fs::path path( fs::path(dir) / key.filename() );
+    const fs::path tmp( path.string() + "." + std::to_string( getpid() ) + ".tmp" );
+
+    {
+      std::ofstream out( tmp.string(), std::ios::binary | std::ios::trunc );
+      out.write( reinterpret_cast<const char *>(&header), sizeof(header) );
+      out.write( reinterpret_cast<const char *>(headers.data()), headers.size() * sizeof(MatHeader) );
+
+      const char zeros[DataAlignment] = {0};
+      uint64_t pos = sizeof(header) + headers.size() * sizeof(MatHeader);
+
+      for( size_t i = 0; i < mats.size(); ++i ) {
+        out.write( zeros, headers[i].offset - pos );
+
+        const size_t rowBytes = mats[i].cols * mats[i].elemSize();
+        for( int y = 0; y < mats[i].rows; ++y ) {
+          out.write( reinterpret_cast<const char *>(mats[i].ptr(y)), rowBytes );
+        }
+
+        pos = headers[i].offset + headers[i].bytes;
+      }
+
+      if( !out ) {
+        LOG(WARNING) << "Unable to write map cache entry " << tmp.string();
+        fs::remove( tmp, ec );
+        return false;
+      }
+    }
+
+    fs::rename( tmp, path, ec );
+    if( ec ) {
+      LOG(WARNING) << "Unable to write map cache entry " << path.string() << ": " << ec.message();
+      fs::remove( tmp, ec );
+      return false;
+    }
+
+    return true;
+  }
+
+  void MapCache::clear()
+  {
+    const std::string dir( directory() );
+    if( dir.empty() || !fs::is_directory( dir ) ) return;
+
+    boost::system::error_code ec;
+    for( fs::directory_iterator itr( dir ), end; itr != end; ++itr ) {
+      if( itr->path().extension() == Extension ) fs::remove( itr->path(), ec );
+    }
+  }
+
+}
@@ -1,8 +1,15 @@
 
 #include "libvideoio/Undistorter.h"
+#include "libvideoio/ThreadPool.h"
+#include "libvideoio/FramePool.h"
+#include "ConvertingRemap.h"
+#include "RemapKernels.h"
 
 #include <tinyxml2.h>
 
+#include <atomic>
+#include <climits>
+#include <future>
 #include <iostream>
 
 #include <opencv2/imgproc/imgproc.hpp>
@@ -29,8 +36,7 @@ namespace libvideoio
                 0,              // 0 == all pixels in un-distorted image are valid
                 _outputSize(), nullptr, false);
 
-  cv::initUndistortRectifyMap(_originalK, _distCoeffs, cv::Mat(), _K,
-                      _outputSize(), CV_16SC2, _map1, _map2);
+  initMaps( cv::Mat() );
 
   // Need to check on reason for this
   // _originalK.at<double>(0, 0) /= _inputSize.width;
@@ -56,27 +62,119 @@ OpenCVUndistorter::OpenCVUndistorter( const cv::Mat &origK,
       _valid( true )
 {
 
-  cv::initUndistortRectifyMap(_originalK, _distCoeffs, rectification, _K,
-                      _outputSize(), CV_16SC2, _map1, _map2);
-
   // Calculate baseline
   _baseline[0] = -projection.at<double>(0,3) / projection.at<double>(0,0);
   _baseline[1] = _baseline[2] = 0.0;
+
+  initMaps( rectification );
 }
 
 
 
+struct OpenCVUndistorter::MapBuildState {
+  MapBuildState()
+    : claimed( false ),
+      done( promise.get_future().share() )
+  {;}
+
+  // Returns true for exactly one caller, which must then fulfil the promise
+  bool claim() { return !claimed.exchange( true ); }
+
+  std::atomic<bool> claimed;
+  std::promise<void> promise;
+  std::shared_future<void> done;
+};
+
 OpenCVUndistorter::~OpenCVUndistorter()
-{}
+{
+  // Either stop a queued background build from ever starting, or wait
+  // for a running one to finish with this object
+  if( _mapBuild && !_mapBuild->claim() ) _mapBuild->done.wait();
+}
 
-void OpenCVUndistorter::undistort(const cv::Mat& image, cv::OutputArray result) const
+void OpenCVUndistorter::initMaps( const cv::Mat &rectification )
 {
-  cv::Mat intermediate(image);
-  if( _wrapped ) {
-    _wrapped->undistort( image, intermediate );
+  _rectification = rectification.clone();
+  _mapBuild = std::make_shared<MapBuildState>();
+
+  switch( defaultMapBuildPolicy() ) {
+    case BuildMapsEagerly:
+      prepare();
+      break;
+
+    case BuildMapsInBackground: {
+      std::shared_ptr<MapBuildState> state( _mapBuild );
+      const OpenCVUndistorter *self = this;
+
+      // The task only touches this object if it wins the claim, which
+      // the destructor prevents once it has started
+      ThreadPool::global().submit( [state, self]() {
+        if( state->claim() ) self->buildMaps();
+      });
+      break;
+    }
+
+    case BuildMapsOnFirstUse:
+      break;
+  }
+}
+
+void OpenCVUndistorter::buildMaps() const
+{
+  try {
+    MapCache::Key key( "OpenCVUndistorter" );
+    key.add( _originalK ).add( _distCoeffs ).add( _rectification ).add( _K )
+       .add( _outputSize.width ).add( _outputSize.height ).add( CV_16SC2 );
+
+    _cachedMaps = MapCache::load( key, 2 );
+    if( _cachedMaps ) {
+      _map1 = (*_cachedMaps)[0];
+      _map2 = (*_cachedMaps)[1];
+    } else {
+      cv::initUndistortRectifyMap(_originalK, _distCoeffs, _rectification, _K,
+                          _outputSize(), CV_16SC2, _map1, _map2);
+
+      if( MapCache::enabled() ) MapCache::store( key, { _map1, _map2 } );
+    }
+
+    _mapBuild->promise.set_value();
+  } catch(...) {
+    _mapBuild->promise.set_exception( std::current_exception() );
   }
+}
+
+void OpenCVUndistorter::prepare() const
+{
+  Undistorter::prepare();
+
+  if( _mapBuild->claim() ) buildMaps();
+
+  // Rethrows anything thrown while building the maps
+  _mapBuild->done.get();
+}
+
+bool OpenCVUndistorter::isReady() const
+{
+  return _mapBuild->done.wait_for( std::chrono::seconds(0) ) == std::future_status::ready
+         && Undistorter::isReady();
+}
+
+void OpenCVUndistorter::undistort(const cv::Mat& image, cv::OutputArray result) const
+{
+  prepare();
 
-	 cv::remap(intermediate, result, _map1, _map2, cv::INTER_LINEAR);
+  cv::Mat intermediate( undistortWrapped( image ) );
+
+  // Remap in row bands;  each band reads only its own rows of the maps
+  // and writes its own rows of the output, so the result does not depend
+  // on the number of bands.
+  result.create( _outputSize(), intermediate.type() );
+  cv::Mat out( result.getMat() );
+  intermediate = unaliased( intermediate, out );
+
+  forEachBand( out.rows, [&]( int y0, int y1 ) {
+    undistortRows( intermediate, out, y0, y1 );
+  });
 
   if( false ) {
      cv::Mat inputScaled;
@@ -91,5 +189,292 @@ void OpenCVUndistorter::undistort(const cv::Mat& image, cv::OutputArray result)
 
 }
 
+// Bounding box of the source pixels read through a window of a CV_16SC2
+// map by any interpolation mode (bicubic reads (x-1,y-1) .. (x+2,y+2)),
+// clipped to the source image
+static cv::Rect sourceWindow( const cv::Mat &map1, const ImageSize &sourceSize )
+{
+  int minX = INT_MAX, minY = INT_MAX, maxX = INT_MIN, maxY = INT_MIN;
+
+  for( int y = 0; y < map1.rows; ++y ) {
+    const short *xy = map1.ptr<short>(y);
+    for( int x = 0; x < map1.cols; ++x ) {
+      minX = std::min<int>( minX, xy[2*x] );
+      maxX = std::max<int>( maxX, xy[2*x] );
+      minY = std::min<int>( minY, xy[2*x+1] );
+      maxY = std::max<int>( maxY, xy[2*x+1] );
+    }
+  }
+
+  if( minX > maxX ) return cv::Rect();
+
+  return cv::Rect( minX - 1, minY - 1, maxX - minX + 4, maxY - minY + 4 )
+         & cv::Rect( 0, 0, sourceSize.width, sourceSize.height );
+}
+
+void OpenCVUndistorter::undistort(const cv::Mat& image, cv::OutputArray result, const cv::Rect &outputRoi) const
+{
+  CHECK( (outputRoi & cv::Rect( cv::Point(0,0), _outputSize() )) == outputRoi ) << "ROI outside output image";
+
+  prepare();
+
+  // Not initialized from image:  the wrapped stage would write into it
+  cv::Mat intermediate;
+  cv::Point offset( 0, 0 );
+
+  if( _wrapped ) {
+    // Only the window of the wrapped output which this ROI samples is
+    // computed, and the maps are shifted to match
+    const cv::Rect window( sourceWindow( _map1( outputRoi ), _wrapped->outputImageSize() ) );
+
+    if( window.area() == 0 ) {
+      result.create( outputRoi.size(), image.type() );
+      result.setTo( cv::Scalar::all(0) );
+      return;
+    }
+
+    intermediate = FramePool::global().acquire( window.size(), image.type() );
+    _wrapped->undistort( image, intermediate, window );
+    offset = window.tl();
+  } else {
+    intermediate = image;
+  }
+
+  result.create( outputRoi.size(), intermediate.type() );
+  cv::Mat out( result.getMat() );
+  intermediate = unaliased( intermediate, out );
+
+  forEachBand( out.rows, [&]( int y0, int y1 ) {
+    remapRows( intermediate, out, outputRoi, offset, y0, y1 );
+  });
+}
+
+void OpenCVUndistorter::undistortDepth( const cv::Mat &depth, cv::OutputArray result ) const
+{
+  prepare();
+
+  cv::Mat intermediate( undistortDepthWrapped( depth ) );
+
+  result.create( _outputSize(), intermediate.type() );
+  cv::Mat out( result.getMat() );
+  intermediate = unaliased( intermediate, out );
+
+  forEachBand( out.rows, [&]( int y0, int y1 ) {
+    remapDepthRows( intermediate, _map1, _map2, out, y0, y1 );
+  });
+}
+
+// Rows per step of a combined colour and depth remap, small enough that
+// the map rows are still in cache for the second image
+static const int RGBDRows = 8;
+
+void OpenCVUndistorter::undistortRGBD( const cv::Mat &image, const cv::Mat &depth,
+                                       cv::OutputArray result, cv::OutputArray depthResult ) const
+{
+  prepare();
+
+  cv::Mat intermediate, intermediateDepth;
+  if( _wrapped ) {
+    const cv::Size wrappedSize( _wrapped->outputImageSize()() );
+    intermediate = FramePool::global().acquire( wrappedSize, image.type() );
+    intermediateDepth = FramePool::global().acquire( wrappedSize, depth.type() );
+    _wrapped->undistortRGBD( image, depth, intermediate, intermediateDepth );
+  } else {
+    intermediate = image;
+    intermediateDepth = depth;
+  }
+
+  result.create( _outputSize(), intermediate.type() );
+  depthResult.create( _outputSize(), intermediateDepth.type() );
+  cv::Mat out( result.getMat() ), depthOut( depthResult.getMat() );
+  intermediate = unaliased( unaliased( intermediate, out ), depthOut );
+  intermediateDepth = unaliased( unaliased( intermediateDepth, out ), depthOut );
+
+  forEachBand( out.rows, [&]( int y0, int y1 ) {
+    for( int y = y0; y < y1; y += RGBDRows ) {
+      const int yEnd = std::min( y + RGBDRows, y1 );
+      undistortRows( intermediate, out, y, yEnd );
+      remapDepthRows( intermediateDepth, _map1, _map2, depthOut, y, yEnd );
+    }
+  });
+}
+
+void OpenCVUndistorter::convertAndUndistort( const cv::Mat &image, cv::OutputArray result,
+                                             int code, int rdepth, double alpha, double beta ) const
+{
+  // A wrapped stage expects converted images, and the fused kernels
+  // are bilinear
+  remap::ConvertingRemap fused;
+  if( _wrapped || ( interpolation() != InterpolateLinear && interpolation() != InterpolateLinearFast ) ||
+      !fused.init( image, code, rdepth, alpha, beta ) ) {
+    Undistorter::convertAndUndistort( image, result, code, rdepth, alpha, beta );
+    return;
+  }
+
+  prepare();
+
+  // A header of its own, as result may be the same Mat as image
+  cv::Mat source( image );
+  result.create( _outputSize(), fused.resultType );
+  cv::Mat out( result.getMat() );
+  source = unaliased( source, out );
+
+  forEachBand( out.rows, [&]( int y0, int y1 ) {
+    fused.remapRows( source, _map1, _map2, out, y0, y1 );
+  });
+}
+
+void OpenCVUndistorter::undistortRows( const cv::Mat &intermediate, cv::Mat &out, int y0, int y1 ) const
+{
+  remapRows( intermediate, out, cv::Rect( cv::Point(0,0), _outputSize() ), cv::Point(0,0), y0, y1 );
+}
+
+// A CV_16SC2 map shifted by -offset.  The shared map is never modified:
+// assigning a MatExpr to a view of it would write in place.
+static cv::Mat shiftMap( const cv::Mat &map, const cv::Point &offset )
+{
+  if( offset == cv::Point(0,0) ) return map;
+
+  cv::Mat shifted;
+  cv::subtract( map, cv::Scalar( offset.x, offset.y ), shifted );
+  return shifted;
+}
+
+void OpenCVUndistorter::remapRows( const cv::Mat &src, cv::Mat &out, const cv::Rect &outputRoi,
+                                   const cv::Point &offset, int y0, int y1 ) const
+{
+  const cv::Rect rows( outputRoi.x, outputRoi.y + y0, outputRoi.width, y1 - y0 );
+  cv::Mat band( out.rowRange(y0, y1) );
+
+  switch( interpolation() ) {
+    case InterpolateNearest:
+      cv::remap( src, band, shiftMap( nearestMap()( rows ), offset ), cv::noArray(), cv::INTER_NEAREST );
+      return;
+
+    case InterpolateLinearExact: {
+      cv::Mat mapX, mapY;
+      exactMaps( mapX, mapY );
+      if( remapExact( src, band, mapX( rows ), mapY( rows ), offset ) ) return;
+      break;    // other types use the fixed-point maps
+    }
+
+    default:
+      break;
+  }
+
+  cv::remap( src, band, shiftMap( _map1( rows ), offset ), _map2( rows ),
+             interpolation() == InterpolateCubic ? cv::INTER_CUBIC : cv::INTER_LINEAR );
+}
+
+cv::Mat OpenCVUndistorter::nearestMap() const
+{
+  std::lock_guard<std::mutex> lock( _modeMapMutex );
+
+  if( _nearestMap.empty() ) {
+    // Rounds the fixed-point maps:  each integer coordinate steps to the
+    // next pixel when its fraction is at least one half
+    const int half = 1 << (cv::INTER_BITS - 1);
+    cv::Mat rounded( _map1.size(), CV_16SC2 );
+
+    for( int y = 0; y < _map1.rows; ++y ) {
+      const short *xy = _map1.ptr<short>(y);
+      const ushort *frac = _map2.ptr<ushort>(y);
+      short *r = rounded.ptr<short>(y);
+
+      for( int x = 0; x < _map1.cols; ++x ) {
+        const int fx = frac[x] & (cv::INTER_TAB_SIZE - 1), fy = frac[x] >> cv::INTER_BITS;
+        r[2*x]   = cv::saturate_cast<short>( xy[2*x]   + (fx >= half) );
+        r[2*x+1] = cv::saturate_cast<short>( xy[2*x+1] + (fy >= half) );
+      }
+    }
+
+    _nearestMap = rounded;
+  }
+
+  return _nearestMap;
+}
+
+void OpenCVUndistorter::exactMaps( cv::Mat &mapX, cv::Mat &mapY ) const
+{
+  std::lock_guard<std::mutex> lock( _modeMapMutex );
+
+  if( _exactMapX.empty() ) {
+    cv::Mat x, y;
+    cv::initUndistortRectifyMap( _originalK, _distCoeffs, _rectification, _K,
+                                 _outputSize(), CV_32FC1, x, y );
+
+    // The kernels read (x,y) .. (x+1,y+1) without bounds checks, so
+    // sources outside that range are marked invalid
+    const float maxX = _inputSize.width - 1, maxY = _inputSize.height - 1;
+    for( int r = 0; r < x.rows; ++r ) {
+      float *px = x.ptr<float>(r), *py = y.ptr<float>(r);
+      for( int c = 0; c < x.cols; ++c ) {
+        if( !( px[c] >= 0 && px[c] < maxX && py[c] >= 0 && py[c] < maxY ) )
+          px[c] = py[c] = -1.0f;
+      }
+    }
+
+    _exactMapX = x;
+    _exactMapY = y;
+  }
+
+  mapX = _exactMapX;
+  mapY = _exactMapY;
+}
+
+bool OpenCVUndistorter::undistortPointsExact( const std::vector<cv::Point2f> &in,
+                                              std::vector<cv::Point2f> &out ) const
+{
+  // The calibration only describes this stage
+  if( _wrapped ) return Undistorter::undistortPointsExact( in, out );
+
+  cv::undistortPoints( in, out, _originalK, _distCoeffs, _rectification, _K );
+
+  // As the default, points which aren't visible in the output are invalid
+  const float maxU = _outputSize.width - 1, maxV = _outputSize.height - 1;
+  for( cv::Point2f &q : out ) {
+    if( !(q.x >= 0 && q.y >= 0 && q.x <= maxU && q.y <= maxV) )
+      q = cv::Point2f( InvalidCoordinate, InvalidCoordinate );
+  }
+
+  return true;
+}
+
+bool OpenCVUndistorter::pyramidSourceMaps( const std::vector<ImageSize> &sizes,
+                                           std::vector<cv::Mat> &mapX, std::vector<cv::Mat> &mapY ) const
+{
+  // The calibration only describes this stage
+  if( _wrapped ) return Undistorter::pyramidSourceMaps( sizes, mapX, mapY );
+
+  mapX.resize( sizes.size() );
+  mapY.resize( sizes.size() );
+
+  for( size_t i = 0; i < sizes.size(); ++i ) {
+    // Same pixel-centre convention as cv::resize
+    const double sx = double(sizes[i].width) / _outputSize.width,
+                 sy = double(sizes[i].height) / _outputSize.height;
+
+    cv::Mat K( _K.clone() );
+    K.at<double>(0,0) *= sx;
+    K.at<double>(1,1) *= sy;
+    K.at<double>(0,2) = (K.at<double>(0,2) + 0.5) * sx - 0.5;
+    K.at<double>(1,2) = (K.at<double>(1,2) + 0.5) * sy - 0.5;
+
+    cv::initUndistortRectifyMap( _originalK, _distCoeffs, _rectification, K,
+                                 sizes[i](), CV_32FC1, mapX[i], mapY[i] );
+  }
+
+  return true;
+}
+
+bool OpenCVUndistorter::getSourceMap( cv::Mat &mapX, cv::Mat &mapY ) const
+{
+  prepare();
+
+  cv::Mat localX, localY;
+  cv::convertMaps( _map1, _map2, localX, localY, CV_32FC1 );
+
+  return composeWithWrapped( localX, localY, mapX, mapY );
+}
 
 }
@@ -1,8 +1,13 @@
 
 #include "libvideoio/Undistorter.h"
+#include "RemapKernels.h"
+#include "ATANModel.h"
+#include "ConvertingRemap.h"
 
+#include <algorithm>
 #include <sstream>
 #include <fstream>
+#include <vector>
 
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/calib3d/calib3d.hpp>
@@ -12,14 +17,15 @@ namespace libvideoio
 
 // Legacy Undistorter from original LSD-SLAM
 
+// Fraction bits per axis in the packed table, which is cached and so part
+// of the cache key
+static const int TableFracBits = 8;
+
 PTAMUndistorter::PTAMUndistorter(const char* configFileName, const std::shared_ptr<Undistorter> & wrap )
 	: Undistorter(wrap)
 {
 	valid = true;
 
-	remapX = nullptr;
-	remapY = nullptr;
-
 
 
 	// read parameters
@@ -204,39 +210,24 @@ PTAMUndistorter::PTAMUndistorter(const char* configFileName, const std::shared_p
 		outputCalibration[3] = (ocy+0.5) / out_height;
 		outputCalibration[4] = 0;
 
-		remapX = new float[out_width * out_height];
-		remapY = new float[out_width * out_height];
+		MapCache::Key key( "PTAMUndistorter" );
+		key.add( inputCalibration, sizeof(inputCalibration) ).add( outputCalibration, sizeof(outputCalibration) )
+			.add( in_width ).add( in_height ).add( out_width ).add( out_height )
+			.add( remap::DEFAULT_TILE_FOOTPRINT ).add( TableFracBits ).add( remap::ATAN_MAP_VERSION );
+
+		const remap::ATANModel model = { fx, fy, cx, cy, dist, ofx, ofy, ocx, ocy };
+		atanModel.reset( new remap::ATANModel( model ) );
 
-		for(int y=0;y<out_height;y++)
+		if( !loadCachedTable( key ) )
 		{
-			for(int x=0;x<out_width;x++)
-			{
-				float ix = (x - ocx) / ofx;
-				float iy = (y - ocy) / ofy;
-
-				float r = sqrt(ix*ix + iy*iy);
-				float fac = (r==0 || dist==0) ? 1 : atan(r * d2t)/(dist*r);
-
-				ix = fx*fac*ix+cx;
-				iy = fy*fac*iy+cy;
-
-				// make rounding resistant.
-				if(ix == 0) ix = 0.01;
-				if(iy == 0) iy = 0.01;
-				if(ix == in_width-1) ix = in_width-1.01;
-				if(iy == in_height-1) ix = in_height-1.01;
-
-				if(ix > 0 && iy > 0 && ix < in_width-1 &&  iy < in_height-1)
-				{
-					remapX[x+y*out_width] = ix;
-					remapY[x+y*out_width] = iy;
-				}
-				else
-				{
-					remapX[x+y*out_width] = -1;
-					remapY[x+y*out_width] = -1;
-				}
-			}
+			std::vector<float> remapX( out_width * out_height );
+			std::vector<float> remapY( out_width * out_height );
+			remap::buildATANMap( model, in_width, in_height, out_width, out_height, remapX.data(), remapY.data() );
+
+			remapTable.reset( new remap::RemapTable );
+			remapTable->build( remapX.data(), remapY.data(), out_width, out_height, in_width, in_height, TableFracBits );
+
+			storeCachedTable( key );
 		}
 
 		printf("Prepped Warp matrices\n");
@@ -271,70 +262,461 @@ PTAMUndistorter::PTAMUndistorter(const char* configFileName, const std::shared_p
 
 PTAMUndistorter::~PTAMUndistorter()
 {
+}
+
+// The table is cached as five Mats:  xy (CV_16SC2), frac (CV_16UC1), spans
+// and tiles (rows of ints) and rowSpans.  Loading copies out of the mapped
+// file, which is still far cheaper than an atan() per pixel.
+bool PTAMUndistorter::loadCachedTable( const MapCache::Key &key )
+{
+	static_assert( sizeof(remap::Span) == 2*sizeof(int) && sizeof(remap::Tile) == 4*sizeof(int),
+	               "Span and Tile are cached as CV_32SC2 and CV_32SC4" );
+
+	std::shared_ptr<const MapCache::Maps> maps( MapCache::load( key, 5 ) );
+	if( !maps ) return false;
+
+	const cv::Mat &xy( (*maps)[0] ), &frac( (*maps)[1] ), &spans( (*maps)[2] ),
+	              &tiles( (*maps)[3] ), &rowSpans( (*maps)[4] );
+
+	if( xy.type() != CV_16SC2 || frac.type() != CV_16UC1 || xy.size() != frac.size() ||
+			xy.rows != out_height || xy.cols != out_width ||
+			spans.type() != CV_32SC2 || tiles.type() != CV_32SC4 ||
+			rowSpans.type() != CV_32SC1 || (int)rowSpans.total() != out_height+1 )
+	{
+		LOG(WARNING) << "PTAMUndistorter: ignoring malformed cached map";
+		return false;
+	}
+
+	remapTable.reset( new remap::RemapTable );
+	remapTable->width = out_width;
+	remapTable->height = out_height;
+	remapTable->fracBits = TableFracBits;
+
+	const int16_t *xyData = xy.ptr<int16_t>();
+	remapTable->xy.assign( xyData, xyData + 2*xy.total() );
+
+	const uint16_t *fracData = frac.ptr<uint16_t>();
+	remapTable->frac.assign( fracData, fracData + frac.total() );
+
+	const remap::Span *spanData = reinterpret_cast<const remap::Span *>( spans.data );
+	remapTable->spans.assign( spanData, spanData + spans.total() );
 
-	delete[] remapX;
-	delete[] remapY;
+	const remap::Tile *tileData = reinterpret_cast<const remap::Tile *>( tiles.data );
+	remapTable->tiles.assign( tileData, tileData + tiles.total() );
 
+	const int *rowSpanData = rowSpans.ptr<int>();
+	remapTable->rowSpans.assign( rowSpanData, rowSpanData + rowSpans.total() );
+
+	// The kernels trust the table's spans, tiles and coordinates, so an
+	// entry that is corrupt but well-formed is a miss too
+	if( !remapTable->consistent( in_width, in_height ) ) {
+		LOG(WARNING) << "PTAMUndistorter: ignoring inconsistent cached map";
+		remapTable.reset();
+		return false;
+	}
+
+	return true;
 }
 
-void PTAMUndistorter::undistort(const cv::Mat& image, cv::OutputArray result) const
+void PTAMUndistorter::storeCachedTable( const MapCache::Key &key ) const
 {
-	if (!valid)
+	if( !MapCache::enabled() ) return;
+
+	const remap::RemapTable &t( *remapTable );
+	std::vector<cv::Mat> mats;
+	mats.push_back( cv::Mat( t.height, t.width, CV_16SC2, const_cast<int16_t *>( t.xy.data() ) ) );
+	mats.push_back( cv::Mat( t.height, t.width, CV_16UC1, const_cast<uint16_t *>( t.frac.data() ) ) );
+	mats.push_back( cv::Mat( t.spans.size(), 1, CV_32SC2, const_cast<remap::Span *>( t.spans.data() ) ) );
+	mats.push_back( cv::Mat( t.tiles.size(), 1, CV_32SC4, const_cast<remap::Tile *>( t.tiles.data() ) ) );
+	mats.push_back( cv::Mat( t.rowSpans.size(), 1, CV_32SC1, const_cast<int *>( t.rowSpans.data() ) ) );
+
+	MapCache::store( key, mats );
+}
+
+// Colour kernel for one image type and interpolation mode.  Nearest,
+// cubic and 8U InterpolateLinearFast run a packed kernel over the table;
+// the other bilinear modes run bilinearFunc() over the exact maps.
+struct PTAMUndistorter::ColourRemapper {
+	ColourRemapper()
+		: packed(nullptr), exact(nullptr), mapX(nullptr), mapY(nullptr), mapWidth(0) {;}
+
+	bool valid() const { return packed != nullptr || exact != nullptr; }
+
+	// Remaps columns [x0,x1) of output row y into dst, which points at
+	// the pixel for column x0
+	void span( const remap::SourceImage &src, const remap::RemapTable &table, size_t pixelSize,
+	           int y, int x0, int x1, uint8_t *dst ) const
 	{
-		result.getMatRef() = image;
-		return;
+		if( exact ) {
+			const size_t offset = (size_t)y * mapWidth + x0;
+			exact( src, mapX + offset, mapY + offset, dst, x1 - x0 );
+		} else {
+			remap::remapSpan( src, table, packed, pixelSize, y, x0, x1, dst );
+		}
+	}
+
+	void tile( const remap::SourceImage &src, const remap::RemapTable &table, size_t pixelSize,
+	           const remap::Tile &t, cv::Mat &dst ) const
+	{
+		if( !exact ) {
+			remap::remapTile( src, table, packed, pixelSize, t, dst.data, dst.step );
+			return;
+		}
+
+		for( int y = t.y0; y < t.y1; ++y )
+			span( src, table, pixelSize, y, t.x0, t.x1, dst.ptr(y) + t.x0 * pixelSize );
+	}
+
+	remap::PackedRemapFunc packed;
+	remap::RemapFunc exact;
+	const float *mapX, *mapY;
+	int mapWidth;
+};
+
+PTAMUndistorter::ColourRemapper PTAMUndistorter::selectColourKernel( const cv::Mat &image ) const
+{
+	remap::Depth depth;
+	switch( image.depth() ) {
+		case CV_8U:  depth = remap::DEPTH_8U;  break;
+		case CV_16U: depth = remap::DEPTH_16U; break;
+		case CV_32F: depth = remap::DEPTH_32F; break;
+		default:
+			std::call_once( unsupportedTypeWarning, [&]() {
+				LOG(WARNING) << "PTAMUndistorter: no kernel for image depth " << image.depth() << ", using cv::remap";
+			});
+			return ColourRemapper();
+	}
+
+	ColourRemapper r;
+	switch( interpolation() ) {
+		case InterpolateNearest:
+			r.packed = remap::packedNearestFunc( depth, image.channels() );
+			break;
+		case InterpolateLinearExact:
+			r.exact = remap::bilinearFunc( depth, image.channels() );
+			break;
+		case InterpolateCubic:
+			r.packed = remap::packedBicubicFunc( depth, image.channels() );
+			break;
+		case InterpolateLinearFast:
+			// The table's 1/256 px fractions keep 8-bit results within 2 LSB,
+			// but on steep 16-bit or float gradients the coordinate error
+			// alone costs far more, so those go through the float maps
+			if( depth == remap::DEPTH_8U ) {
+				r.packed = remap::packedBilinearFunc( depth, image.channels() );
+				break;
+			}
+			r.exact = remap::bilinearFunc( depth, image.channels() );
+			break;
+		default:
+			// Within 1 LSB, which the table's coordinates can't hold
+			r.exact = remap::bilinearFunc( depth, image.channels() );
+			break;
+	}
+
+	if( !r.valid() ) {
+		std::call_once( unsupportedTypeWarning, [&]() {
+			LOG(WARNING) << "PTAMUndistorter: no kernel for " << image.channels() << " channel images, using cv::remap";
+		});
+		return r;
+	}
+
+	if( r.exact ) {
+		exactMaps( r.mapX, r.mapY );
+		r.mapWidth = out_width;
+	}
+	return r;
+}
+
+void PTAMUndistorter::exactMaps( const float *&mapX, const float *&mapY ) const
+{
+	std::lock_guard<std::mutex> lock( exactMapMutex );
+
+	if( exactMapX.empty() ) {
+		exactMapX.resize( out_width * out_height );
+		exactMapY.resize( out_width * out_height );
+		remap::buildATANMap( *atanModel, in_width, in_height, out_width, out_height, exactMapX.data(), exactMapY.data() );
+	}
+
+	mapX = exactMapX.data();
+	mapY = exactMapY.data();
+}
+
+int PTAMUndistorter::colourRemapFlags( const cv::Mat &image ) const
+{
+	// cv::remap can't interpolate 8S or 32S
+	if( image.depth() == CV_8S || image.depth() == CV_32S ) return cv::INTER_NEAREST;
+
+	switch( interpolation() ) {
+		case InterpolateNearest: return cv::INTER_NEAREST;
+		case InterpolateCubic:   return cv::INTER_CUBIC;
+		default:                 return cv::INTER_LINEAR;
+	}
+}
+
+void PTAMUndistorter::remapWithOpenCV( const cv::Mat &image, const cv::Rect &outputRoi, int flags, cv::Mat &result ) const
+{
+	const float *mapX, *mapY;
+	exactMaps( mapX, mapY );
+	const cv::Mat fullX( out_height, out_width, CV_32F, const_cast<float *>( mapX ) );
+	const cv::Mat fullY( out_height, out_width, CV_32F, const_cast<float *>( mapY ) );
+
+	// Invalid pixels have a source x of -1, which reads as the zero border
+	forEachBand( result.rows, [&]( int y0, int y1 ) {
+		const cv::Rect rows( outputRoi.x, outputRoi.y + y0, outputRoi.width, y1 - y0 );
+		cv::Mat band( result.rowRange(y0, y1) );
+		cv::remap( image, band, fullX(rows), fullY(rows), flags, cv::BORDER_CONSTANT );
+	});
+}
+
+// Returns nullptr (with a warning, once) for types without a kernel
+static remap::PackedRemapFunc selectDepthKernel( const cv::Mat &depth, Undistorter::DepthSampling sampling )
+{
+	// Undistorter::DepthSampling and remap::DepthSampling share values
+	const remap::DepthSampling s( static_cast<remap::DepthSampling>( sampling ) );
+	if( depth.channels() == 1 ) {
+		switch( depth.depth() ) {
+			case CV_16U: return remap::packedDepthFunc( remap::DEPTH_16U, s );
+			case CV_32F: return remap::packedDepthFunc( remap::DEPTH_32F, s );
+			default: break;
+		}
 	}
 
+	static std::once_flag warning;
+	std::call_once( warning, [&]() {
+		LOG(WARNING) << "PTAMUndistorter: no depth kernel for type " << depth.type() << ", sampling nearest with cv::remap";
+	});
+	return nullptr;
+}
+
+bool PTAMUndistorter::passThrough(const cv::Mat& image) const
+{
+	if (!valid) return true;
+
 	if (image.rows != in_height || image.cols != in_width)
 	{
 		printf("PTAMUndistorter: input image size differs from expected input size! Not undistorting.\n");
-		result.getMatRef() = image;
+		return true;
+	}
+
+	// No transformation if neither distortion nor resize
+	return (in_height == out_height && in_width == out_width && inputCalibration[4] == 0);
+}
+
+void PTAMUndistorter::undistort(const cv::Mat& image, cv::OutputArray result) const
+{
+	const cv::Mat intermediate( undistortWrapped( image ) );
+
+	if (passThrough(intermediate))
+	{
+		result.getMatRef() = intermediate;
 		return;
 	}
 
-	if (in_height == out_height && in_width == out_width && inputCalibration[4] == 0)
+	remapTiles( &intermediate, result, nullptr, cv::noArray() );
+}
+
+void PTAMUndistorter::undistortDepth(const cv::Mat& depth, cv::OutputArray result) const
+{
+	const cv::Mat intermediate( undistortDepthWrapped( depth ) );
+
+	if (passThrough(intermediate))
 	{
-		// No transformation if neither distortion nor resize
-		result.getMatRef() = image;
+		result.getMatRef() = intermediate;
 		return;
 	}
 
-	// TODO,   Handle _wrapped
+	remapTiles( nullptr, cv::noArray(), &intermediate, result );
+}
 
-	result.create(out_height, out_width, CV_8U);
-	cv::Mat resultMat = result.getMatRef();
-	assert(result.getMatRef().isContinuous());
-	assert(image.isContinuous());
+void PTAMUndistorter::undistortRGBD(const cv::Mat& image, const cv::Mat& depth,
+                                    cv::OutputArray result, cv::OutputArray depthResult) const
+{
+	// Each image is then checked against the input size on its own
+	if( depth.size() != image.size() )
+	{
+		LOG(WARNING) << "PTAMUndistorter: depth and colour images differ in size, undistorting separately";
+		undistort( image, result );
+		undistortDepth( depth, depthResult );
+		return;
+	}
 
-	uchar* data = resultMat.data;
+	const cv::Mat intermediate( undistortWrapped( image ) );
+	const cv::Mat intermediateDepth( undistortDepthWrapped( depth ) );
 
-	for(int idx = out_width*out_height-1;idx>=0;idx--)
+	if (passThrough(intermediate))
 	{
-		// get interp. values
-		float xx = remapX[idx];
-		float yy = remapY[idx];
+		result.getMatRef() = intermediate;
+		depthResult.getMatRef() = intermediateDepth;
+		return;
+	}
 
-		if(xx<0)
-			data[idx] = 0;
-		else
-		{
-			// get integer and rational parts
-			int xxi = xx;
-			int yyi = yy;
-			xx -= xxi;
-			yy -= yyi;
-			float xxyy = xx*yy;
-
-			// get array base pointer
-			const uchar* src = (uchar*)image.data + xxi + yyi * in_width;
-
-			// interpolate (bilinear)
-			data[idx] =  xxyy * src[1+in_width]
-			                    + (yy-xxyy) * src[in_width]
-			                    + (xx-xxyy) * src[1]
-			                    + (1-xx-yy+xxyy) * src[0];
+	remapTiles( &intermediate, result, &intermediateDepth, depthResult );
+}
+
+void PTAMUndistorter::convertAndUndistort(const cv::Mat& image, cv::OutputArray result,
+                                          int code, int rdepth, double alpha, double beta) const
+{
+	// A wrapped stage expects converted images, and the fused kernels are
+	// bilinear over the packed table, so only as accurate as
+	// InterpolateLinearFast
+	remap::ConvertingRemap fused;
+	if (_wrapped || passThrough(image) || interpolation() != InterpolateLinearFast ||
+			!fused.init( image, code, rdepth, alpha, beta ))
+	{
+		Undistorter::convertAndUndistort( image, result, code, rdepth, alpha, beta );
+		return;
+	}
+
+	// A header of its own, as result may be the same Mat as image
+	cv::Mat source( image );
+	result.create(out_height, out_width, fused.resultType);
+	cv::Mat resultMat = result.getMat();
+	source = unaliased( source, resultMat );
+
+	const std::vector<remap::Tile> &tiles( remapTable->tiles );
+
+	forEachBand( tiles.size(), [&]( int t0, int t1 ) {
+		for( int t = t0; t < t1; ++t ) {
+			fused.remapTile( source, *remapTable, tiles[t], resultMat );
 		}
+	});
+}
+
+void PTAMUndistorter::remapTiles( const cv::Mat *colourIn, cv::OutputArray result,
+                                  const cv::Mat *depthIn, cv::OutputArray depthResult ) const
+{
+	// Headers of their own, as the results may be the same Mats as the inputs
+	cv::Mat colourSource( colourIn ? *colourIn : cv::Mat() ), depthSource( depthIn ? *depthIn : cv::Mat() );
+	const cv::Mat *image = colourIn ? &colourSource : nullptr;
+	const cv::Mat *depth = depthIn ? &depthSource : nullptr;
+
+	// Select the kernels for these image types once, then run them per row
+	ColourRemapper kernel;
+	remap::PackedRemapFunc depthKernel = nullptr;
+	cv::Mat resultMat, depthMat;
+
+	if( image ) {
+		kernel = selectColourKernel( *image );
+		result.create(out_height, out_width, image->type());
+		resultMat = result.getMat();
+	}
+
+	if( depth ) {
+		depthKernel = selectDepthKernel( *depth, depthSampling() );
+		depthResult.create(out_height, out_width, depth->type());
+		depthMat = depthResult.getMat();
 	}
+
+	colourSource = unaliased( unaliased( colourSource, resultMat ), depthMat );
+	depthSource = unaliased( unaliased( depthSource, resultMat ), depthMat );
+
+	// Types without a kernel are remapped separately;  depth nearest, as
+	// cv::remap would blend it otherwise
+	const cv::Rect whole( 0, 0, out_width, out_height );
+	if( depth && !depthKernel ) {
+		remapWithOpenCV( depthSource, whole, cv::INTER_NEAREST, depthMat );
+		depth = nullptr;
+	}
+
+	if( image && !kernel.valid() ) {
+		remapWithOpenCV( colourSource, whole, colourRemapFlags( colourSource ), resultMat );
+		image = nullptr;
+	}
+
+	if( !image && !depth ) return;
+
+	const remap::SourceImage src( image ? image->data : nullptr, image ? image->step : 0, in_width, in_height );
+	const remap::SourceImage depthSrc( depth ? depth->data : nullptr, depth ? depth->step : 0, in_width, in_height );
+	const size_t pixelSize = image ? image->elemSize() : 0;
+	const size_t depthPixelSize = depth ? depth->elemSize() : 0;
+
+	// Walk the output in the table's tile order, which keeps each tile's
+	// source footprint cache-resident for strongly distorting lenses.  With
+	// both images, each tile is remapped twice while its part of the table
+	// is still in cache.
+	const std::vector<remap::Tile> &tiles( remapTable->tiles );
+
+	forEachBand( tiles.size(), [&]( int t0, int t1 ) {
+		for( int t = t0; t < t1; ++t ) {
+			if( image ) kernel.tile( src, *remapTable, pixelSize, tiles[t], resultMat );
+			if( depthKernel ) remap::remapTile( depthSrc, *remapTable, depthKernel, depthPixelSize, tiles[t], depthMat.data, depthMat.step );
+		}
+	});
+}
+
+void PTAMUndistorter::undistort(const cv::Mat& image, cv::OutputArray result, const cv::Rect &outputRoi) const
+{
+	// Pass-through cases are handled by the full-frame path
+	const cv::Mat intermediate( undistortWrapped( image ) );
+	if (passThrough(intermediate))
+	{
+		CHECK( (outputRoi & cv::Rect( 0, 0, intermediate.cols, intermediate.rows )) == outputRoi ) << "ROI outside output image";
+		intermediate( outputRoi ).copyTo( result );
+		return;
+	}
+
+	CHECK( (outputRoi & cv::Rect( 0, 0, out_width, out_height )) == outputRoi ) << "ROI outside output image";
+
+	const ColourRemapper kernel = selectColourKernel( intermediate );
+
+	// A header of its own, as result may be the same Mat as image
+	cv::Mat source( intermediate );
+	result.create( outputRoi.size(), intermediate.type() );
+	cv::Mat resultMat = result.getMat();
+	source = unaliased( source, resultMat );
+
+	if( !kernel.valid() ) {
+		remapWithOpenCV( source, outputRoi, colourRemapFlags( source ), resultMat );
+		return;
+	}
+
+	const remap::SourceImage src( source.data, source.step, in_width, in_height );
+	const size_t pixelSize = source.elemSize();
+
+	// Keep the tile order, clipping each tile to the ROI
+	std::vector<remap::Tile> clipped;
+	for( const remap::Tile &tile : remapTable->tiles ) {
+		const remap::Tile c( std::max( tile.x0, outputRoi.x ), std::max( tile.y0, outputRoi.y ),
+		                     std::min( tile.x1, outputRoi.x + outputRoi.width ),
+		                     std::min( tile.y1, outputRoi.y + outputRoi.height ) );
+		if( c.x0 < c.x1 && c.y0 < c.y1 ) clipped.push_back( c );
+	}
+
+	forEachBand( clipped.size(), [&]( int t0, int t1 ) {
+		for( int t = t0; t < t1; ++t ) {
+			const remap::Tile &tile( clipped[t] );
+			for( int y = tile.y0; y < tile.y1; ++y ) {
+				kernel.span( src, *remapTable, pixelSize, y, tile.x0, tile.x1,
+				             resultMat.ptr( y - outputRoi.y ) + (tile.x0 - outputRoi.x) * pixelSize );
+			}
+		}
+	});
+}
+
+bool PTAMUndistorter::getSourceMap( cv::Mat &mapX, cv::Mat &mapY ) const
+{
+	if( !valid ) return false;
+
+	cv::Mat localX( out_height, out_width, CV_32F, cv::Scalar(InvalidCoordinate) );
+	cv::Mat localY( out_height, out_width, CV_32F, cv::Scalar(InvalidCoordinate) );
+
+	const int bits = remapTable->fracBits;
+	const float one = 1 << bits;
+
+	for( int y = 0; y < out_height; ++y ) {
+		const int16_t *xy = remapTable->xyRow(y);
+		const uint16_t *frac = remapTable->fracRow(y);
+
+		for( const remap::Span *span = remapTable->spansBegin(y); span != remapTable->spansEnd(y); ++span ) {
+			for( int x = span->begin; x < span->end; ++x ) {
+				localX.at<float>(y,x) = xy[2*x]   + (frac[x] & ((1 << bits)-1)) / one;
+				localY.at<float>(y,x) = xy[2*x+1] + (frac[x] >> bits) / one;
+			}
+		}
+	}
+
+	return composeWithWrapped( localX, localY, mapX, mapY );
 }
 
 const Camera PTAMUndistorter::getCamera() const
@@ -5,6 +5,7 @@
 #include <array>
 #include <fstream>
 #include <string>
+#include <vector>
 
 #include "nlohmann/json.hpp"
 
@@ -53,9 +54,6 @@ namespace libvideoio
 		if( json["calib_type"]!= "PTAM" ) return nullptr;
 
 
-		//
-		float *remapX = nullptr, *remapY = nullptr;
-
 		array<float,5> inputCalibration, outputCalibration;
 		array<int,2> outSize, inSize;
 
@@ -211,41 +209,6 @@ namespace libvideoio
 		outputCalibration[3] = (ocy+0.5) / out_height;
 		outputCalibration[4] = 0;
 
-		remapX = new float[out_width * out_height];
-		remapY = new float[out_width * out_height];
-
-		for(int y=0;y<out_height;y++)
-		{
-			for(int x=0;x<out_width;x++)
-			{
-				float ix = (x - ocx) / ofx;
-				float iy = (y - ocy) / ofy;
-
-				float r = sqrt(ix*ix + iy*iy);
-				float fac = (r==0 || dist==0) ? 1 : atan(r * d2t)/(dist*r);
-
-				ix = fx*fac*ix+cx;
-				iy = fy*fac*iy+cy;
-
-				// make rounding resistant.
-				if(ix == 0) ix = 0.01;
-				if(iy == 0) iy = 0.01;
-				if(ix == in_width-1) ix = in_width-1.01;
-				if(iy == in_height-1) ix = in_height-1.01;
-
-				if(ix > 0 && iy > 0 && ix < in_width-1 &&  iy < in_height-1)
-				{
-					remapX[x+y*out_width] = ix;
-					remapY[x+y*out_width] = iy;
-				}
-				else
-				{
-					remapX[x+y*out_width] = -1;
-					remapY[x+y*out_width] = -1;
-				}
-			}
-		}
-
 		printf("Prepped Warp matrices\n");
 
 
@@ -0,0 +1,142 @@
+
+#include "PointGrid.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  #define LIBVIDEOIO_GRID_X86
+  #include <immintrin.h>
+#endif
+
+namespace libvideoio {
+namespace remap {
+
+  void PointGrid::layout( int width, int height, float spacing, float invalidValue )
+  {
+    cols = std::max( 2, (int)std::ceil( (width-1) / spacing ) + 1 );
+    rows = std::max( 2, (int)std::ceil( (height-1) / spacing ) + 1 );
+
+    stepX = std::max( width-1, 1 ) / float(cols-1);
+    stepY = std::max( height-1, 1 ) / float(rows-1);
+    invalid = invalidValue;
+
+    x.assign( cols*rows, invalid );
+    y.assign( cols*rows, invalid );
+  }
+
+  static void lookup_scalar( const PointGrid &g, const cv::Point2f *in, cv::Point2f *out, int n )
+  {
+    const float maxU = g.cols - 1, maxV = g.rows - 1;
+    const float invStepX = 1.0f / g.stepX, invStepY = 1.0f / g.stepY;
+    const float invalidThreshold = g.invalid / 2;
+
+    for( int k = 0; k < n; ++k ) {
+      const float u = in[k].x * invStepX, v = in[k].y * invStepY;
+      out[k] = cv::Point2f( g.invalid, g.invalid );
+
+      if( !(u >= 0 && v >= 0 && u <= maxU && v <= maxV) ) continue;
+
+      const int i = std::min( (int)u, g.cols-2 ), j = std::min( (int)v, g.rows-2 );
+      const float fu = u - i, fv = v - j;
+      const int idx = j*g.cols + i;
+
+      const float x00 = g.x[idx], x01 = g.x[idx+1], x10 = g.x[idx+g.cols], x11 = g.x[idx+g.cols+1];
+      if( std::min( std::min(x00, x01), std::min(x10, x11) ) < invalidThreshold ) continue;
+
+      const float y00 = g.y[idx], y01 = g.y[idx+1], y10 = g.y[idx+g.cols], y11 = g.y[idx+g.cols+1];
+
+      out[k].x = (1-fv) * (x00 + fu*(x01-x00)) + fv * (x10 + fu*(x11-x10));
+      out[k].y = (1-fv) * (y00 + fu*(y01-y00)) + fv * (y10 + fu*(y11-y10));
+    }
+  }
+
+#ifdef LIBVIDEOIO_GRID_X86
+
+  // Eight points per iteration:  deinterleave, gather the four nodes of
+  // each cell from both value arrays, blend, reinterleave
+  __attribute__((target("avx2")))
+  static void lookup_avx2( const PointGrid &g, const cv::Point2f *in, cv::Point2f *out, int n )
+  {
+    const __m256 invStepX = _mm256_set1_ps( 1.0f / g.stepX ), invStepY = _mm256_set1_ps( 1.0f / g.stepY );
+    const __m256 maxU = _mm256_set1_ps( g.cols-1 ), maxV = _mm256_set1_ps( g.rows-1 );
+    const __m256i maxI = _mm256_set1_epi32( g.cols-2 ), maxJ = _mm256_set1_epi32( g.rows-2 );
+    const __m256i vCols = _mm256_set1_epi32( g.cols );
+    const __m256i one = _mm256_set1_epi32( 1 );
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 vInvalid = _mm256_set1_ps( g.invalid ), invalidThreshold = _mm256_set1_ps( g.invalid / 2 );
+
+    // Gathers from a lane index which is only valid in active lanes
+    const float *gx = g.x.data(), *gy = g.y.data();
+
+    int k = 0;
+    for( ; k + 8 <= n; k += 8 ) {
+      const float *p = reinterpret_cast<const float *>( in + k );
+
+      // (x0 y0 x1 y1 ..) -> x and y vectors, lanes in point order
+      const __m256 a = _mm256_loadu_ps( p ), b = _mm256_loadu_ps( p + 8 );
+      const __m256 lo = _mm256_permute2f128_ps( a, b, 0x20 ), hi = _mm256_permute2f128_ps( a, b, 0x31 );
+      const __m256 x = _mm256_shuffle_ps( lo, hi, _MM_SHUFFLE(2,0,2,0) );
+      const __m256 y = _mm256_shuffle_ps( lo, hi, _MM_SHUFFLE(3,1,3,1) );
+
+      const __m256 u = _mm256_mul_ps( x, invStepX ), v = _mm256_mul_ps( y, invStepY );
+      __m256 valid = _mm256_and_ps( _mm256_and_ps( _mm256_cmp_ps( u, zero, _CMP_GE_OQ ), _mm256_cmp_ps( v, zero, _CMP_GE_OQ ) ),
+                                    _mm256_and_ps( _mm256_cmp_ps( u, maxU, _CMP_LE_OQ ), _mm256_cmp_ps( v, maxV, _CMP_LE_OQ ) ) );
+
+      // Invalid lanes look up node 0 and are discarded below
+      const __m256 uc = _mm256_and_ps( u, valid ), vc = _mm256_and_ps( v, valid );
+      const __m256i i = _mm256_min_epi32( _mm256_cvttps_epi32( uc ), maxI );
+      const __m256i j = _mm256_min_epi32( _mm256_cvttps_epi32( vc ), maxJ );
+      const __m256 fu = _mm256_sub_ps( uc, _mm256_cvtepi32_ps( i ) ), fv = _mm256_sub_ps( vc, _mm256_cvtepi32_ps( j ) );
+
+      const __m256i i00 = _mm256_add_epi32( _mm256_mullo_epi32( j, vCols ), i );
+      const __m256i i01 = _mm256_add_epi32( i00, one );
+      const __m256i i10 = _mm256_add_epi32( i00, vCols );
+      const __m256i i11 = _mm256_add_epi32( i10, one );
+
+      const __m256 x00 = _mm256_i32gather_ps( gx, i00, 4 ), x01 = _mm256_i32gather_ps( gx, i01, 4 );
+      const __m256 x10 = _mm256_i32gather_ps( gx, i10, 4 ), x11 = _mm256_i32gather_ps( gx, i11, 4 );
+      const __m256 y00 = _mm256_i32gather_ps( gy, i00, 4 ), y01 = _mm256_i32gather_ps( gy, i01, 4 );
+      const __m256 y10 = _mm256_i32gather_ps( gy, i10, 4 ), y11 = _mm256_i32gather_ps( gy, i11, 4 );
+
+      const __m256 minX = _mm256_min_ps( _mm256_min_ps( x00, x01 ), _mm256_min_ps( x10, x11 ) );
+      valid = _mm256_and_ps( valid, _mm256_cmp_ps( minX, invalidThreshold, _CMP_GE_OQ ) );
+
+      const __m256 xt = _mm256_add_ps( x00, _mm256_mul_ps( fu, _mm256_sub_ps( x01, x00 ) ) );
+      const __m256 xb = _mm256_add_ps( x10, _mm256_mul_ps( fu, _mm256_sub_ps( x11, x10 ) ) );
+      const __m256 yt = _mm256_add_ps( y00, _mm256_mul_ps( fu, _mm256_sub_ps( y01, y00 ) ) );
+      const __m256 yb = _mm256_add_ps( y10, _mm256_mul_ps( fu, _mm256_sub_ps( y11, y10 ) ) );
+
+      // (1-fv)*top + fv*bottom, as the scalar path
+      const __m256 rfv = _mm256_sub_ps( _mm256_set1_ps( 1.0f ), fv );
+      __m256 ox = _mm256_add_ps( _mm256_mul_ps( rfv, xt ), _mm256_mul_ps( fv, xb ) );
+      __m256 oy = _mm256_add_ps( _mm256_mul_ps( rfv, yt ), _mm256_mul_ps( fv, yb ) );
+
+      ox = _mm256_blendv_ps( vInvalid, ox, valid );
+      oy = _mm256_blendv_ps( vInvalid, oy, valid );
+
+      // Reinterleave
+      const __m256 l = _mm256_unpacklo_ps( ox, oy ), h = _mm256_unpackhi_ps( ox, oy );
+      float *q = reinterpret_cast<float *>( out + k );
+      _mm256_storeu_ps( q,     _mm256_permute2f128_ps( l, h, 0x20 ) );
+      _mm256_storeu_ps( q + 8, _mm256_permute2f128_ps( l, h, 0x31 ) );
+    }
+
+    lookup_scalar( g, in + k, out + k, n - k );
+  }
+
+#endif
+
+  void PointGrid::lookup( const cv::Point2f *in, cv::Point2f *out, int n, KernelLevel level ) const
+  {
+#ifdef LIBVIDEOIO_GRID_X86
+    if( level >= KERNEL_AVX2 ) {
+      lookup_avx2( *this, in, out, n );
+      return;
+    }
+#endif
+    lookup_scalar( *this, in, out, n );
+  }
+
+}
+}
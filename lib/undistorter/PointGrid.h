@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "RemapKernels.h"
+
+// Coarse grids of 2D coordinates used to map sparse points through an
+// undistorter without touching its dense maps.
+
+namespace libvideoio {
+namespace remap {
+
+  // Grid of coordinates sampled at nodes spaced (stepX, stepY) apart,
+  // covering [0,width-1] x [0,height-1] with the last nodes exactly on the
+  // far edges.  Nodes without a valid coordinate hold `invalid`.
+  struct PointGrid {
+    PointGrid()
+      : cols(0), rows(0), stepX(1), stepY(1), invalid(0) {;}
+
+    // Lays out nodes at most `spacing` pixels apart over the domain;
+    // values are left for the caller to fill.
+    void layout( int width, int height, float spacing, float invalidValue );
+
+    cv::Point2f node( int i, int j ) const { return cv::Point2f( i*stepX, j*stepY ); }
+
+    // Bilinear lookup of n points.  Points outside the domain, or in a
+    // cell with an invalid node, are set to (invalid, invalid).
+    void lookup( const cv::Point2f *in, cv::Point2f *out, int n,
+                 KernelLevel level = kernelLevel() ) const;
+
+    int cols, rows;
+    float stepX, stepY;
+    float invalid;
+
+    std::vector<float> x, y;     // node values, row-major
+  };
+
+  // Node spacing used by Undistorter's point grids;  about 0.01 px worst
+  // case error for typical lens distortion
+  static const float POINT_GRID_SPACING = 8.0f;
+
+}
+}
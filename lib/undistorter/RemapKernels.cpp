@@ -0,0 +1,969 @@
+
+#include "RemapKernels.h"
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  #define LIBVIDEOIO_REMAP_X86
+  #include <immintrin.h>
+#endif
+
+namespace libvideoio {
+namespace remap {
+
+  //==== Kernel selection ====
+
+  static KernelLevel detectKernelLevel()
+  {
+#ifdef LIBVIDEOIO_REMAP_X86
+    __builtin_cpu_init();
+    if( __builtin_cpu_supports("avx2") ) return KERNEL_AVX2;
+    if( __builtin_cpu_supports("sse4.1") ) return KERNEL_SSE41;
+#endif
+    return KERNEL_SCALAR;
+  }
+
+  static std::atomic<int> maxKernelLevel( KERNEL_AVX2 );
+
+  KernelLevel kernelLevel()
+  {
+    static const KernelLevel detected = detectKernelLevel();
+    const int cap = maxKernelLevel.load();
+    return (detected < cap) ? detected : static_cast<KernelLevel>(cap);
+  }
+
+  KernelLevel setMaxKernelLevel( KernelLevel level )
+  {
+    return static_cast<KernelLevel>( maxKernelLevel.exchange( level ) );
+  }
+
+  const char *kernelLevelName( KernelLevel level )
+  {
+    switch( level ) {
+      case KERNEL_AVX2:   return "AVX2";
+      case KERNEL_SSE41:  return "SSE4.1";
+      default:            return "scalar";
+    }
+  }
+
+  //==== Scalar kernels ====
+  //
+  // The SIMD kernels below perform exactly the same integer arithmetic,
+  // so all kernel levels produce bit-identical output.
+
+  static const int ROUND = 1 << (2*FRAC_BITS - 1);
+
+  // Fixed-point bilinear weights for integer depths.  Acc must hold
+  // (max pixel value) << 2*BITS.  8-bit images use FRAC_BITS, matching the
+  // SIMD kernels;  16-bit images need finer weights to stay within 1 LSB.
+  template< typename T, typename Acc, int BITS >
+  struct FixedWeights {
+    FixedWeights( float fx, float fy )
+      : wx( fx * (1 << BITS) + 0.5f ), wy( fy * (1 << BITS) + 0.5f ) {;}
+
+    // From packed-table fractions with `bits` bits each
+    FixedWeights( int qx, int qy, int bits )
+      : wx( Acc(qx) << (BITS - bits) ), wy( Acc(qy) << (BITS - bits) ) {;}
+
+    inline T apply( Acc p00, Acc p01, Acc p10, Acc p11 ) const
+    {
+      const Acc top = (p00 << BITS) + wx * (p01 - p00);
+      const Acc bot = (p10 << BITS) + wx * (p11 - p10);
+      return ((top << BITS) + wy * (bot - top) + (Acc(1) << (2*BITS - 1))) >> (2*BITS);
+    }
+
+    Acc wx, wy;
+  };
+
+  struct FloatWeights {
+    FloatWeights( float x, float y )
+      : fx( x ), fy( y ) {;}
+
+    FloatWeights( int qx, int qy, int bits )
+      : fx( qx / float(1 << bits) ), fy( qy / float(1 << bits) ) {;}
+
+    inline float apply( float p00, float p01, float p10, float p11 ) const
+    {
+      const float top = p00 + fx * (p01 - p00);
+      const float bot = p10 + fx * (p11 - p10);
+      return top + fy * (bot - top);
+    }
+
+    float fx, fy;
+  };
+
+  template< typename T > struct BilinearWeights;
+  template<> struct BilinearWeights<uint8_t>  { typedef FixedWeights<uint8_t, int, FRAC_BITS> type; };
+  template<> struct BilinearWeights<uint16_t> { typedef FixedWeights<uint16_t, int64_t, 16> type; };
+  template<> struct BilinearWeights<float>    { typedef FloatWeights type; };
+
+  template< typename T, int CN >
+  static inline void bilinearPixel( const SourceImage &src, int xi, int yi,
+                                    const typename BilinearWeights<T>::type &w, T *dst )
+  {
+    const T *p0 = reinterpret_cast<const T *>( src.data + yi * src.step ) + xi * CN;
+    const T *p1 = reinterpret_cast<const T *>( src.data + (yi+1) * src.step ) + xi * CN;
+
+    for( int c = 0; c < CN; ++c )
+      dst[c] = w.apply( p0[c], p0[c+CN], p1[c], p1[c+CN] );
+  }
+
+  template< typename T, int CN >
+  static void bilinear_scalar( const SourceImage &src,
+                               const float *mapX, const float *mapY,
+                               void *dstv, int count )
+  {
+    T *dst = static_cast<T *>( dstv );
+
+    for( int i = 0; i < count; ++i, dst += CN ) {
+      const float x = mapX[i], y = mapY[i];
+
+      if( x < 0 ) {
+        for( int c = 0; c < CN; ++c ) dst[c] = 0;
+        continue;
+      }
+
+      const int xi = x, yi = y;
+      bilinearPixel<T,CN>( src, xi, yi, typename BilinearWeights<T>::type( x - xi, y - yi ), dst );
+    }
+  }
+
+  template< typename T, int CN >
+  static void packed_scalar( const SourceImage &src,
+                             const int16_t *xy, const uint16_t *frac, int fracBits,
+                             void *dstv, int count )
+  {
+    T *dst = static_cast<T *>( dstv );
+    const int mask = (1 << fracBits) - 1;
+
+    for( int i = 0; i < count; ++i, dst += CN ) {
+      const typename BilinearWeights<T>::type w( frac[i] & mask, frac[i] >> fracBits, fracBits );
+      bilinearPixel<T,CN>( src, xy[2*i], xy[2*i+1], w, dst );
+    }
+  }
+
+#ifdef LIBVIDEOIO_REMAP_X86
+
+  //==== SSE4.1 kernels ====
+  //
+  // SSE has no gather, so the four taps are fetched with two 16-bit scalar
+  // loads per pixel; the weight computation and blend run 4-wide.
+
+  static inline int load16( const uint8_t *p )
+  {
+    uint16_t v;
+    memcpy( &v, p, sizeof(v) );
+    return v;
+  }
+
+  // Blends the 2x2 neighbourhoods at four byte offsets with weights wx, wy
+  __attribute__((target("sse4.1")))
+  static inline __m128i blend4_sse41( const SourceImage &src, __m128i offset, __m128i wx, __m128i wy )
+  {
+    alignas(16) int off[4];
+    _mm_store_si128( reinterpret_cast<__m128i *>(off), offset );
+
+    const uint8_t *s = src.data, *s1 = src.data + src.step;
+    const __m128i top2 = _mm_setr_epi32( load16(s+off[0]),  load16(s+off[1]),  load16(s+off[2]),  load16(s+off[3]) );
+    const __m128i bot2 = _mm_setr_epi32( load16(s1+off[0]), load16(s1+off[1]), load16(s1+off[2]), load16(s1+off[3]) );
+
+    const __m128i vByte = _mm_set1_epi32( 0xFF );
+    const __m128i p00 = _mm_and_si128( top2, vByte ), p01 = _mm_srli_epi32( top2, 8 );
+    const __m128i p10 = _mm_and_si128( bot2, vByte ), p11 = _mm_srli_epi32( bot2, 8 );
+
+    const __m128i top = _mm_add_epi32( _mm_slli_epi32( p00, FRAC_BITS ), _mm_mullo_epi32( wx, _mm_sub_epi32( p01, p00 ) ) );
+    const __m128i bot = _mm_add_epi32( _mm_slli_epi32( p10, FRAC_BITS ), _mm_mullo_epi32( wx, _mm_sub_epi32( p11, p10 ) ) );
+
+    const __m128i val = _mm_add_epi32( _mm_slli_epi32( top, FRAC_BITS ), _mm_mullo_epi32( wy, _mm_sub_epi32( bot, top ) ) );
+    return _mm_srli_epi32( _mm_add_epi32( val, _mm_set1_epi32(ROUND) ), 2*FRAC_BITS );
+  }
+
+  __attribute__((target("sse4.1")))
+  static inline void store8_sse41( uint8_t *dst, __m128i lo, __m128i hi )
+  {
+    const __m128i p16 = _mm_packus_epi32( lo, hi );
+    _mm_storel_epi64( reinterpret_cast<__m128i *>(dst), _mm_packus_epi16( p16, p16 ) );
+  }
+
+  __attribute__((target("sse4.1")))
+  static inline __m128i bilinear4_sse41( const SourceImage &src, const float *mapX, const float *mapY )
+  {
+    const __m128 x = _mm_loadu_ps( mapX );
+    const __m128 y = _mm_loadu_ps( mapY );
+    const __m128i valid = _mm_castps_si128( _mm_cmpge_ps( x, _mm_setzero_ps() ) );
+
+    const __m128 vOne = _mm_set1_ps( FRAC_ONE );
+    const __m128 vHalf = _mm_set1_ps( 0.5f );
+
+    const __m128i xi = _mm_cvttps_epi32( x );
+    const __m128i yi = _mm_cvttps_epi32( y );
+    const __m128i wx = _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps( _mm_sub_ps( x, _mm_cvtepi32_ps(xi) ), vOne ), vHalf ) );
+    const __m128i wy = _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps( _mm_sub_ps( y, _mm_cvtepi32_ps(yi) ), vOne ), vHalf ) );
+
+    const __m128i offset = _mm_and_si128( _mm_add_epi32( _mm_mullo_epi32( yi, _mm_set1_epi32(src.step) ), xi ), valid );
+
+    return _mm_and_si128( blend4_sse41( src, offset, wx, wy ), valid );
+  }
+
+  __attribute__((target("sse4.1")))
+  static void bilinear8U_sse41( const SourceImage &src,
+                                const float *mapX, const float *mapY,
+                                void *dstv, int count )
+  {
+    uint8_t *dst = static_cast<uint8_t *>( dstv );
+
+    int i = 0;
+    for( ; i + 8 <= count; i += 8 ) {
+      store8_sse41( dst + i,
+                    bilinear4_sse41( src, mapX + i, mapY + i ),
+                    bilinear4_sse41( src, mapX + i + 4, mapY + i + 4 ) );
+    }
+
+    bilinear_scalar<uint8_t,1>( src, mapX + i, mapY + i, dst + i, count - i );
+  }
+
+  __attribute__((target("sse4.1")))
+  static inline __m128i packed4_sse41( const SourceImage &src, const int16_t *xy, const uint16_t *frac, int fracBits )
+  {
+    const __m128i pts = _mm_loadu_si128( reinterpret_cast<const __m128i *>( xy ) );
+    const __m128i xi = _mm_srai_epi32( _mm_slli_epi32( pts, 16 ), 16 );
+    const __m128i yi = _mm_srai_epi32( pts, 16 );
+
+    const __m128i f = _mm_cvtepu16_epi32( _mm_loadl_epi64( reinterpret_cast<const __m128i *>( frac ) ) );
+    const __m128i shift = _mm_cvtsi32_si128( FRAC_BITS - fracBits );
+    const __m128i wx = _mm_sll_epi32( _mm_and_si128( f, _mm_set1_epi32( (1 << fracBits) - 1 ) ), shift );
+    const __m128i wy = _mm_sll_epi32( _mm_srl_epi32( f, _mm_cvtsi32_si128( fracBits ) ), shift );
+
+    const __m128i offset = _mm_add_epi32( _mm_mullo_epi32( yi, _mm_set1_epi32(src.step) ), xi );
+    return blend4_sse41( src, offset, wx, wy );
+  }
+
+  __attribute__((target("sse4.1")))
+  static void packed8U_sse41( const SourceImage &src,
+                              const int16_t *xy, const uint16_t *frac, int fracBits,
+                              void *dstv, int count )
+  {
+    uint8_t *dst = static_cast<uint8_t *>( dstv );
+
+    int i = 0;
+    for( ; i + 8 <= count; i += 8 ) {
+      store8_sse41( dst + i,
+                    packed4_sse41( src, xy + 2*i, frac + i, fracBits ),
+                    packed4_sse41( src, xy + 2*i + 8, frac + i + 4, fracBits ) );
+    }
+
+    packed_scalar<uint8_t,1>( src, xy + 2*i, frac + i, fracBits, dst + i, count - i );
+  }
+
+  //==== AVX2 kernels ====
+  //
+  // Taps are fetched with two 32-bit gathers per 8 pixels (top and bottom
+  // row pairs).  Blocks whose gathers could read past the end of the source
+  // image fall back to the scalar kernel.
+
+  // Largest offset for which the 4-byte read of the bottom row stays
+  // within the image
+  static inline int maxGatherOffset( const SourceImage &src )
+  {
+    return (src.height-2) * src.step + src.width - 4;
+  }
+
+  __attribute__((target("avx2")))
+  static inline __m256i blend8_avx2( const SourceImage &src, __m256i offset, __m256i wx, __m256i wy )
+  {
+    const int *base = reinterpret_cast<const int *>( src.data );
+    const __m256i vByte = _mm256_set1_epi32( 0xFF );
+
+    const __m256i top2 = _mm256_i32gather_epi32( base, offset, 1 );
+    const __m256i bot2 = _mm256_i32gather_epi32( base, _mm256_add_epi32( offset, _mm256_set1_epi32( src.step ) ), 1 );
+
+    const __m256i p00 = _mm256_and_si256( top2, vByte ), p01 = _mm256_and_si256( _mm256_srli_epi32( top2, 8 ), vByte );
+    const __m256i p10 = _mm256_and_si256( bot2, vByte ), p11 = _mm256_and_si256( _mm256_srli_epi32( bot2, 8 ), vByte );
+
+    const __m256i top = _mm256_add_epi32( _mm256_slli_epi32( p00, FRAC_BITS ), _mm256_mullo_epi32( wx, _mm256_sub_epi32( p01, p00 ) ) );
+    const __m256i bot = _mm256_add_epi32( _mm256_slli_epi32( p10, FRAC_BITS ), _mm256_mullo_epi32( wx, _mm256_sub_epi32( p11, p10 ) ) );
+
+    const __m256i val = _mm256_add_epi32( _mm256_slli_epi32( top, FRAC_BITS ), _mm256_mullo_epi32( wy, _mm256_sub_epi32( bot, top ) ) );
+    return _mm256_srli_epi32( _mm256_add_epi32( val, _mm256_set1_epi32( ROUND ) ), 2*FRAC_BITS );
+  }
+
+  __attribute__((target("avx2")))
+  static inline void store8_avx2( uint8_t *dst, __m256i val )
+  {
+    const __m128i p16 = _mm_packus_epi32( _mm256_castsi256_si128( val ), _mm256_extracti128_si256( val, 1 ) );
+    _mm_storel_epi64( reinterpret_cast<__m128i *>(dst), _mm_packus_epi16( p16, p16 ) );
+  }
+
+  __attribute__((target("avx2")))
+  static void bilinear8U_avx2( const SourceImage &src,
+                               const float *mapX, const float *mapY,
+                               void *dstv, int count )
+  {
+    uint8_t *dst = static_cast<uint8_t *>( dstv );
+
+    const __m256 vZero = _mm256_setzero_ps();
+    const __m256 vOne = _mm256_set1_ps( FRAC_ONE );
+    const __m256 vHalf = _mm256_set1_ps( 0.5f );
+    const __m256i vStep = _mm256_set1_epi32( src.step );
+    const __m256i vMaxOffset = _mm256_set1_epi32( maxGatherOffset( src ) );
+
+    int i = 0;
+    for( ; i + 8 <= count; i += 8 ) {
+      const __m256 x = _mm256_loadu_ps( mapX + i );
+      const __m256 y = _mm256_loadu_ps( mapY + i );
+      const __m256i valid = _mm256_castps_si256( _mm256_cmp_ps( x, vZero, _CMP_GE_OQ ) );
+
+      const __m256i xi = _mm256_cvttps_epi32( x );
+      const __m256i yi = _mm256_cvttps_epi32( y );
+      const __m256i offset = _mm256_and_si256( _mm256_add_epi32( _mm256_mullo_epi32( yi, vStep ), xi ), valid );
+
+      if( _mm256_movemask_epi8( _mm256_cmpgt_epi32( offset, vMaxOffset ) ) ) {
+        bilinear_scalar<uint8_t,1>( src, mapX + i, mapY + i, dst + i, 8 );
+        continue;
+      }
+
+      const __m256i wx = _mm256_cvttps_epi32( _mm256_add_ps( _mm256_mul_ps( _mm256_sub_ps( x, _mm256_cvtepi32_ps(xi) ), vOne ), vHalf ) );
+      const __m256i wy = _mm256_cvttps_epi32( _mm256_add_ps( _mm256_mul_ps( _mm256_sub_ps( y, _mm256_cvtepi32_ps(yi) ), vOne ), vHalf ) );
+
+      store8_avx2( dst + i, _mm256_and_si256( blend8_avx2( src, offset, wx, wy ), valid ) );
+    }
+
+    bilinear_scalar<uint8_t,1>( src, mapX + i, mapY + i, dst + i, count - i );
+  }
+
+  __attribute__((target("avx2")))
+  static void packed8U_avx2( const SourceImage &src,
+                             const int16_t *xy, const uint16_t *frac, int fracBits,
+                             void *dstv, int count )
+  {
+    uint8_t *dst = static_cast<uint8_t *>( dstv );
+
+    const __m256i vStep = _mm256_set1_epi32( src.step );
+    const __m256i vMaxOffset = _mm256_set1_epi32( maxGatherOffset( src ) );
+    const __m256i vMask = _mm256_set1_epi32( (1 << fracBits) - 1 );
+    const __m128i vShift = _mm_cvtsi32_si128( FRAC_BITS - fracBits );
+    const __m128i vFracBits = _mm_cvtsi32_si128( fracBits );
+
+    int i = 0;
+    for( ; i + 8 <= count; i += 8 ) {
+      // (x,y) int16 pairs, little-endian:  x in the low half of each 32-bit lane
+      const __m256i pts = _mm256_loadu_si256( reinterpret_cast<const __m256i *>( xy + 2*i ) );
+      const __m256i xi = _mm256_srai_epi32( _mm256_slli_epi32( pts, 16 ), 16 );
+      const __m256i yi = _mm256_srai_epi32( pts, 16 );
+      const __m256i offset = _mm256_add_epi32( _mm256_mullo_epi32( yi, vStep ), xi );
+
+      if( _mm256_movemask_epi8( _mm256_cmpgt_epi32( offset, vMaxOffset ) ) ) {
+        packed_scalar<uint8_t,1>( src, xy + 2*i, frac + i, fracBits, dst + i, 8 );
+        continue;
+      }
+
+      const __m256i f = _mm256_cvtepu16_epi32( _mm_loadu_si128( reinterpret_cast<const __m128i *>( frac + i ) ) );
+      const __m256i wx = _mm256_sll_epi32( _mm256_and_si256( f, vMask ), vShift );
+      const __m256i wy = _mm256_sll_epi32( _mm256_srl_epi32( f, vFracBits ), vShift );
+
+      store8_avx2( dst + i, blend8_avx2( src, offset, wx, wy ) );
+    }
+
+    packed_scalar<uint8_t,1>( src, xy + 2*i, frac + i, fracBits, dst + i, count - i );
+  }
+
+#endif
+
+  //==== Dispatch ====
+
+  RemapFunc bilinearFunc( Depth depth, int channels, KernelLevel level )
+  {
+    switch( depth ) {
+      case DEPTH_8U:
+        switch( channels ) {
+          case 1:
+#ifdef LIBVIDEOIO_REMAP_X86
+            if( level >= KERNEL_AVX2 ) return bilinear8U_avx2;
+            if( level >= KERNEL_SSE41 ) return bilinear8U_sse41;
+#endif
+            return bilinear_scalar<uint8_t,1>;
+          case 3: return bilinear_scalar<uint8_t,3>;
+          case 4: return bilinear_scalar<uint8_t,4>;
+        }
+        break;
+
+      case DEPTH_16U:
+        switch( channels ) {
+          case 1: return bilinear_scalar<uint16_t,1>;
+          case 3: return bilinear_scalar<uint16_t,3>;
+          case 4: return bilinear_scalar<uint16_t,4>;
+        }
+        break;
+
+      case DEPTH_32F:
+        switch( channels ) {
+          case 1: return bilinear_scalar<float,1>;
+          case 3: return bilinear_scalar<float,3>;
+          case 4: return bilinear_scalar<float,4>;
+        }
+        break;
+    }
+
+    return nullptr;
+  }
+
+  void bilinear8U( const SourceImage &src,
+                   const float *mapX, const float *mapY,
+                   uint8_t *dst, int count,
+                   KernelLevel level )
+  {
+    bilinearFunc( DEPTH_8U, 1, level )( src, mapX, mapY, dst, count );
+  }
+
+  PackedRemapFunc packedBilinearFunc( Depth depth, int channels, KernelLevel level )
+  {
+    switch( depth ) {
+      case DEPTH_8U:
+        switch( channels ) {
+          case 1:
+#ifdef LIBVIDEOIO_REMAP_X86
+            if( level >= KERNEL_AVX2 ) return packed8U_avx2;
+            if( level >= KERNEL_SSE41 ) return packed8U_sse41;
+#endif
+            return packed_scalar<uint8_t,1>;
+          case 3: return packed_scalar<uint8_t,3>;
+          case 4: return packed_scalar<uint8_t,4>;
+        }
+        break;
+
+      case DEPTH_16U:
+        switch( channels ) {
+          case 1: return packed_scalar<uint16_t,1>;
+          case 3: return packed_scalar<uint16_t,3>;
+          case 4: return packed_scalar<uint16_t,4>;
+        }
+        break;
+
+      case DEPTH_32F:
+        switch( channels ) {
+          case 1: return packed_scalar<float,1>;
+          case 3: return packed_scalar<float,3>;
+          case 4: return packed_scalar<float,4>;
+        }
+        break;
+    }
+
+    return nullptr;
+  }
+
+  //==== Nearest and bicubic kernels ====
+
+  template< typename T, int CN >
+  static void packed_nearest( const SourceImage &src,
+                              const int16_t *xy, const uint16_t *frac, int fracBits,
+                              void *dstv, int count )
+  {
+    T *dst = static_cast<T *>( dstv );
+    const int mask = (1 << fracBits) - 1, half = 1 << (fracBits - 1);
+
+    for( int i = 0; i < count; ++i, dst += CN ) {
+      const int x = xy[2*i] + ((frac[i] & mask) >= half);
+      const int y = xy[2*i+1] + ((frac[i] >> fracBits) >= half);
+
+      const T *p = reinterpret_cast<const T *>( src.data + y*src.step ) + x*CN;
+      for( int c = 0; c < CN; ++c ) dst[c] = p[c];
+    }
+  }
+
+  // Keys' cubic convolution weights for taps at -1, 0, 1, 2
+  static inline void cubicWeights( float t, float w[4] )
+  {
+    const float A = -0.75f;
+    w[0] = ((A*(t + 1) - 5*A)*(t + 1) + 8*A)*(t + 1) - 4*A;
+    w[1] = ((A + 2)*t - (A + 3))*t*t + 1;
+    w[2] = ((A + 2)*(1 - t) - (A + 3))*(1 - t)*(1 - t) + 1;
+    w[3] = 1.f - w[0] - w[1] - w[2];
+  }
+
+  template< typename T >
+  static inline T cubicResult( float v );
+
+  template<>
+  inline uint8_t cubicResult<uint8_t>( float v )
+  {
+    return (uint8_t)std::min( std::max( (int)std::floor( v + 0.5f ), 0 ), 255 );
+  }
+
+  template<>
+  inline uint16_t cubicResult<uint16_t>( float v )
+  {
+    return (uint16_t)std::min( std::max( (int)std::floor( v + 0.5f ), 0 ), 65535 );
+  }
+
+  template<>
+  inline float cubicResult<float>( float v ) { return v; }
+
+  template< typename T, int CN >
+  static void packed_bicubic( const SourceImage &src,
+                              const int16_t *xy, const uint16_t *frac, int fracBits,
+                              void *dstv, int count )
+  {
+    T *dst = static_cast<T *>( dstv );
+    const int mask = (1 << fracBits) - 1;
+    const float scale = 1.0f / (1 << fracBits);
+
+    for( int i = 0; i < count; ++i, dst += CN ) {
+      const int x = xy[2*i], y = xy[2*i+1];
+
+      float wx[4], wy[4];
+      cubicWeights( (frac[i] & mask) * scale, wx );
+      cubicWeights( (frac[i] >> fracBits) * scale, wy );
+
+      float v[CN];
+      for( int c = 0; c < CN; ++c ) v[c] = 0;
+
+      const bool inside = x >= 1 && y >= 1 && x < src.width-2 && y < src.height-2;
+
+      for( int j = 0; j < 4; ++j ) {
+        const int ty = y - 1 + j;
+        if( !inside && (unsigned)ty >= (unsigned)src.height ) continue;
+        const T *row = reinterpret_cast<const T *>( src.data + ty*src.step );
+
+        for( int k = 0; k < 4; ++k ) {
+          const int tx = x - 1 + k;
+          if( !inside && (unsigned)tx >= (unsigned)src.width ) continue;
+
+          const float w = wy[j] * wx[k];
+          for( int c = 0; c < CN; ++c ) v[c] += w * row[tx*CN + c];
+        }
+      }
+
+      for( int c = 0; c < CN; ++c ) dst[c] = cubicResult<T>( v[c] );
+    }
+  }
+
+  PackedRemapFunc packedNearestFunc( Depth depth, int channels )
+  {
+    switch( depth ) {
+      case DEPTH_8U:
+        switch( channels ) {
+          case 1: return packed_nearest<uint8_t,1>;
+          case 3: return packed_nearest<uint8_t,3>;
+          case 4: return packed_nearest<uint8_t,4>;
+        }
+        break;
+      case DEPTH_16U:
+        switch( channels ) {
+          case 1: return packed_nearest<uint16_t,1>;
+          case 3: return packed_nearest<uint16_t,3>;
+          case 4: return packed_nearest<uint16_t,4>;
+        }
+        break;
+      case DEPTH_32F:
+        switch( channels ) {
+          case 1: return packed_nearest<float,1>;
+          case 3: return packed_nearest<float,3>;
+          case 4: return packed_nearest<float,4>;
+        }
+        break;
+    }
+
+    return nullptr;
+  }
+
+  PackedRemapFunc packedBicubicFunc( Depth depth, int channels )
+  {
+    switch( depth ) {
+      case DEPTH_8U:
+        switch( channels ) {
+          case 1: return packed_bicubic<uint8_t,1>;
+          case 3: return packed_bicubic<uint8_t,3>;
+          case 4: return packed_bicubic<uint8_t,4>;
+        }
+        break;
+      case DEPTH_16U:
+        switch( channels ) {
+          case 1: return packed_bicubic<uint16_t,1>;
+          case 3: return packed_bicubic<uint16_t,3>;
+          case 4: return packed_bicubic<uint16_t,4>;
+        }
+        break;
+      case DEPTH_32F:
+        switch( channels ) {
+          case 1: return packed_bicubic<float,1>;
+          case 3: return packed_bicubic<float,3>;
+          case 4: return packed_bicubic<float,4>;
+        }
+        break;
+    }
+
+    return nullptr;
+  }
+
+  //==== Depth kernels ====
+
+  template<typename T>
+  static inline T depthTap( const SourceImage &src, int x, int y )
+  {
+    if( (unsigned)x >= (unsigned)src.width || (unsigned)y >= (unsigned)src.height ) return T(0);
+    return reinterpret_cast<const T *>( src.data + y*src.step )[x];
+  }
+
+  // False for 0, negative and NaN depths
+  template<typename T>
+  static inline bool validDepth( T d ) { return d > T(0); }
+
+  template<typename T, DepthSampling S>
+  static void packedDepth( const SourceImage &src,
+                           const int16_t *xy, const uint16_t *frac, int fracBits,
+                           void *dstv, int count )
+  {
+    T *dst = static_cast<T *>( dstv );
+    const int mask = (1 << fracBits) - 1, half = 1 << (fracBits - 1);
+
+    for( int i = 0; i < count; ++i ) {
+      const int x = xy[2*i], y = xy[2*i+1];
+      T d;
+
+      if( S == SAMPLE_NEAREST ) {
+        d = depthTap<T>( src, x + ((frac[i] & mask) >= half), y + ((frac[i] >> fracBits) >= half) );
+      } else {
+        const T taps[4] = { depthTap<T>( src, x, y ),   depthTap<T>( src, x+1, y ),
+                            depthTap<T>( src, x, y+1 ), depthTap<T>( src, x+1, y+1 ) };
+        d = T(0);
+        for( int t = 0; t < 4; ++t ) {
+          if( validDepth( taps[t] ) && (!validDepth( d ) || taps[t] < d) ) d = taps[t];
+        }
+      }
+
+      dst[i] = validDepth( d ) ? d : T(0);
+    }
+  }
+
+  PackedRemapFunc packedDepthFunc( Depth depth, DepthSampling sampling )
+  {
+    switch( depth ) {
+      case DEPTH_16U:
+        return sampling == SAMPLE_MIN_DEPTH ? packedDepth<uint16_t, SAMPLE_MIN_DEPTH>
+                                            : packedDepth<uint16_t, SAMPLE_NEAREST>;
+      case DEPTH_32F:
+        return sampling == SAMPLE_MIN_DEPTH ? packedDepth<float, SAMPLE_MIN_DEPTH>
+                                            : packedDepth<float, SAMPLE_NEAREST>;
+      default:
+        break;
+    }
+
+    return nullptr;
+  }
+
+  //==== Converting kernels ====
+
+  template<typename T>
+  static inline T convertedValue( float v );
+
+  template<>
+  inline uint8_t convertedValue<uint8_t>( float v )
+  {
+    return (uint8_t)std::min( std::max( (int)(v + 0.5f), 0 ), 255 );
+  }
+
+  template<>
+  inline float convertedValue<float>( float v ) { return v; }
+
+  template<int SC, int DC, typename D>
+  static void convertingBilinear( const SourceImage &src,
+                                  const int16_t *xy, const uint16_t *frac, int fracBits,
+                                  const Conversion &conversion, void *dstv, int count )
+  {
+    D *dst = static_cast<D *>( dstv );
+    const int mask = (1 << fracBits) - 1;
+    const float scale = 1.0f / (1 << fracBits);
+
+    for( int i = 0; i < count; ++i ) {
+      const int x = xy[2*i], y = xy[2*i+1];
+      const float fx = (frac[i] & mask) * scale, fy = (frac[i] >> fracBits) * scale;
+      const float w00 = (1-fx)*(1-fy), w01 = fx*(1-fy), w10 = (1-fx)*fy, w11 = fx*fy;
+
+      // Total weight of the taps inside the image, which is all that
+      // beta applies to:  converting first and remapping after would
+      // convert the pixels, not the 0 border
+      float inside = 1;
+
+      float v[SC];
+      if( x >= 0 && y >= 0 && x < src.width-1 && y < src.height-1 ) {
+        const uint8_t *p0 = src.data + y*src.step + x*SC, *p1 = p0 + src.step;
+        for( int c = 0; c < SC; ++c ) {
+          v[c] = w00*p0[c] + w01*p0[SC+c] + w10*p1[c] + w11*p1[SC+c];
+        }
+      } else {
+        // Border:  taps outside the image are 0
+        const float w[4] = { w00, w01, w10, w11 };
+        for( int c = 0; c < SC; ++c ) v[c] = 0;
+        inside = 0;
+
+        for( int t = 0; t < 4; ++t ) {
+          const int tx = x + (t & 1), ty = y + (t >> 1);
+          if( (unsigned)tx >= (unsigned)src.width || (unsigned)ty >= (unsigned)src.height ) continue;
+
+          const uint8_t *p = src.data + ty*src.step + tx*SC;
+          for( int c = 0; c < SC; ++c ) v[c] += w[t] * p[c];
+          inside += w[t];
+        }
+      }
+
+      const float beta = conversion.beta * inside;
+      if( DC == 1 && SC > 1 ) {
+        float gray = 0;
+        for( int c = 0; c < SC; ++c ) gray += conversion.weights[c] * v[c];
+        dst[i] = convertedValue<D>( conversion.alpha * gray + beta );
+      } else {
+        for( int c = 0; c < DC; ++c ) {
+          dst[i*DC + c] = convertedValue<D>( conversion.alpha * v[c] + beta );
+        }
+      }
+    }
+  }
+
+  template<typename D>
+  static ConvertingRemapFunc convertingBilinearFor( int srcChannels, int dstChannels )
+  {
+    switch( srcChannels ) {
+      case 1:
+        if( dstChannels == 1 ) return convertingBilinear<1,1,D>;
+        break;
+      case 3:
+        if( dstChannels == 1 ) return convertingBilinear<3,1,D>;
+        if( dstChannels == 3 ) return convertingBilinear<3,3,D>;
+        break;
+      case 4:
+        if( dstChannels == 1 ) return convertingBilinear<4,1,D>;
+        if( dstChannels == 4 ) return convertingBilinear<4,4,D>;
+        break;
+    }
+
+    return nullptr;
+  }
+
+  ConvertingRemapFunc convertingBilinearFunc( int srcChannels, int dstChannels, Depth dstDepth )
+  {
+    switch( dstDepth ) {
+      case DEPTH_8U:  return convertingBilinearFor<uint8_t>( srcChannels, dstChannels );
+      case DEPTH_32F: return convertingBilinearFor<float>( srcChannels, dstChannels );
+      default:        break;
+    }
+
+    return nullptr;
+  }
+
+  //==== Packed tables ====
+
+  void RemapTable::build( const float *mapX, const float *mapY, int w, int h,
+                          int srcWidth, int srcHeight, int bits )
+  {
+    width = w;
+    height = h;
+    fracBits = bits;
+
+    const int one = 1 << bits;
+
+    xy.assign( 2*w*h, 0 );
+    frac.assign( w*h, 0 );
+
+    spans.clear();
+    rowSpans.assign( 1, 0 );
+    rowSpans.reserve( h+1 );
+
+    for( int y = 0; y < h; ++y ) {
+      int spanBegin = -1;
+
+      for( int x = 0; x < w; ++x ) {
+        const int idx = y*w + x;
+        const float fx = mapX[idx], fy = mapY[idx];
+
+        if( fx < 0 ) {
+          if( spanBegin >= 0 ) spans.push_back( Span( spanBegin, x ) );
+          spanBegin = -1;
+          continue;
+        }
+
+        int xi = fx, yi = fy;
+        int qx = (fx - xi) * one + 0.5f;
+        int qy = (fy - yi) * one + 0.5f;
+
+        // Rounding can carry into the next pixel;  keep the 2x2
+        // neighbourhood inside the source image
+        if( qx == one ) {
+          if( xi + 1 < srcWidth - 1 ) { ++xi; qx = 0; } else { qx = one - 1; }
+        }
+        if( qy == one ) {
+          if( yi + 1 < srcHeight - 1 ) { ++yi; qy = 0; } else { qy = one - 1; }
+        }
+
+        xy[2*idx] = xi;
+        xy[2*idx+1] = yi;
+        frac[idx] = (qy << bits) | qx;
+
+        if( spanBegin < 0 ) spanBegin = x;
+      }
+
+      if( spanBegin >= 0 ) spans.push_back( Span( spanBegin, w ) );
+      rowSpans.push_back( spans.size() );
+    }
+
+    buildTiles();
+  }
+
+  // Initial band height and the smallest tile buildTiles() will produce
+  static const int TILE_BAND_ROWS = 16;
+  static const int MIN_TILE_WIDTH = 32;
+  static const int MIN_TILE_HEIGHT = 4;
+
+  // Area of the bounding box of the 2x2 source neighbourhoods read by the
+  // valid pixels in a tile
+  static long long tileFootprint( const RemapTable &table, const Tile &tile )
+  {
+    int minX = INT_MAX, minY = INT_MAX, maxX = INT_MIN, maxY = INT_MIN;
+
+    for( int y = tile.y0; y < tile.y1; ++y ) {
+      const int16_t *xy = table.xyRow( y );
+
+      for( const Span *span = table.spansBegin( y ); span != table.spansEnd( y ); ++span ) {
+        const int b = std::max( span->begin, tile.x0 ), e = std::min( span->end, tile.x1 );
+
+        for( int x = b; x < e; ++x ) {
+          minX = std::min<int>( minX, xy[2*x] );
+          maxX = std::max<int>( maxX, xy[2*x] );
+          minY = std::min<int>( minY, xy[2*x+1] );
+          maxY = std::max<int>( maxY, xy[2*x+1] );
+        }
+      }
+    }
+
+    if( minX > maxX ) return 0;
+    return (long long)(maxX - minX + 2) * (maxY - minY + 2);
+  }
+
+  static void splitTile( const RemapTable &table, const Tile &tile, int maxFootprint,
+                         std::vector<Tile> &tiles )
+  {
+    const int w = tile.x1 - tile.x0, h = tile.y1 - tile.y0;
+    const bool canSplitX = w >= 2*MIN_TILE_WIDTH, canSplitY = h >= 2*MIN_TILE_HEIGHT;
+
+    if( (!canSplitX && !canSplitY) || tileFootprint( table, tile ) <= maxFootprint ) {
+      tiles.push_back( tile );
+      return;
+    }
+
+    // Halve the longer side, keeping tiles wider than they are tall so
+    // rows still run through the kernels in reasonably long spans
+    if( canSplitX && (w >= 4*h || !canSplitY) ) {
+      const int xm = tile.x0 + w/2;
+      splitTile( table, Tile( tile.x0, tile.y0, xm, tile.y1 ), maxFootprint, tiles );
+      splitTile( table, Tile( xm, tile.y0, tile.x1, tile.y1 ), maxFootprint, tiles );
+    } else {
+      const int ym = tile.y0 + h/2;
+      splitTile( table, Tile( tile.x0, tile.y0, tile.x1, ym ), maxFootprint, tiles );
+      splitTile( table, Tile( tile.x0, ym, tile.x1, tile.y1 ), maxFootprint, tiles );
+    }
+  }
+
+  void RemapTable::buildTiles( int maxFootprint )
+  {
+    tiles.clear();
+
+    for( int y = 0; y < height; y += TILE_BAND_ROWS ) {
+      splitTile( *this, Tile( 0, y, width, std::min( y + TILE_BAND_ROWS, height ) ),
+                 maxFootprint, tiles );
+    }
+  }
+
+  bool RemapTable::consistent( int srcWidth, int srcHeight ) const
+  {
+    if( width <= 0 || height <= 0 || fracBits < 1 || fracBits > 8 ) return false;
+    if( xy.size() != 2 * (size_t)width * height || frac.size() != (size_t)width * height ) return false;
+    if( rowSpans.size() != (size_t)height + 1 || rowSpans.front() != 0 || rowSpans.back() != (int)spans.size() ) return false;
+
+    for( int y = 0; y < height; ++y ) {
+      if( rowSpans[y+1] < rowSpans[y] ) return false;
+    }
+
+    const int fracLimit = 1 << (2 * fracBits);
+
+    for( int y = 0; y < height; ++y ) {
+      const int16_t *xyr = xyRow( y );
+      const uint16_t *fracr = fracRow( y );
+
+      int previousEnd = 0;
+      for( const Span *span = spansBegin( y ); span != spansEnd( y ); ++span ) {
+        if( span->begin < previousEnd || span->end <= span->begin || span->end > width ) return false;
+        previousEnd = span->end;
+
+        for( int x = span->begin; x < span->end; ++x ) {
+          if( xyr[2*x] < 0 || xyr[2*x] >= srcWidth - 1 ||
+              xyr[2*x+1] < 0 || xyr[2*x+1] >= srcHeight - 1 ||
+              fracr[x] >= fracLimit ) return false;
+        }
+      }
+    }
+
+    std::vector<uint8_t> covered( (size_t)width * height, 0 );
+    for( const Tile &tile : tiles ) {
+      if( tile.x0 < 0 || tile.y0 < 0 || tile.x1 > width || tile.y1 > height ||
+          tile.x0 >= tile.x1 || tile.y0 >= tile.y1 ) return false;
+
+      for( int y = tile.y0; y < tile.y1; ++y )
+        for( int x = tile.x0; x < tile.x1; ++x ) {
+          if( covered[(size_t)y * width + x]++ ) return false;
+        }
+    }
+
+    return std::find( covered.begin(), covered.end(), 0 ) == covered.end();
+  }
+
+  size_t RemapTable::bytes() const
+  {
+    return xy.size() * sizeof(int16_t) + frac.size() * sizeof(uint16_t)
+         + spans.size() * sizeof(Span) + rowSpans.size() * sizeof(int)
+         + tiles.size() * sizeof(Tile);
+  }
+
+  void remapSpan( const SourceImage &src, const RemapTable &table,
+                  PackedRemapFunc kernel, size_t pixelSize,
+                  int y, int x0, int x1, uint8_t *dst )
+  {
+    const int16_t *xy = table.xyRow( y );
+    const uint16_t *frac = table.fracRow( y );
+
+    // Column x of the table is written to dst + (x - x0)*pixelSize
+    int x = x0;
+    for( const Span *span = table.spansBegin( y ); span != table.spansEnd( y ); ++span ) {
+      if( span->end <= x ) continue;
+
+      const int b = std::max( span->begin, x ), e = std::min( span->end, x1 );
+      if( b >= e ) break;
+
+      memset( dst + (x - x0)*pixelSize, 0, (b - x) * pixelSize );
+      kernel( src, xy + 2*b, frac + b, table.fracBits, dst + (b - x0)*pixelSize, e - b );
+      x = e;
+    }
+
+    if( x < x1 ) memset( dst + (x - x0)*pixelSize, 0, (x1 - x) * pixelSize );
+  }
+
+  void remapRow( const SourceImage &src, const RemapTable &table,
+                 PackedRemapFunc kernel, size_t pixelSize,
+                 int y, int x0, int x1, uint8_t *dstRow )
+  {
+    remapSpan( src, table, kernel, pixelSize, y, x0, x1, dstRow + x0*pixelSize );
+  }
+
+  void remapTile( const SourceImage &src, const RemapTable &table,
+                  PackedRemapFunc kernel, size_t pixelSize,
+                  const Tile &tile, uint8_t *dst, size_t dstStep )
+  {
+    for( int y = tile.y0; y < tile.y1; ++y ) {
+      remapRow( src, table, kernel, pixelSize, y, tile.x0, tile.x1, dst + y*dstStep );
+    }
+  }
+
+}
+}
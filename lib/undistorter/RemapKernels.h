@@ -0,0 +1,237 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Low-level remap kernels shared by the native (non-OpenCV) undistorters.
+//
+// Kernels work on raw pointers so they can be called on arbitrary row
+// ranges of the output.  The SIMD variants are compiled with per-function
+// target attributes and selected at runtime, so they are available
+// regardless of the -march / ENABLE_SSE flags used for the rest of the build.
+
+namespace libvideoio {
+namespace remap {
+
+  enum KernelLevel {
+    KERNEL_SCALAR = 0,
+    KERNEL_SSE41,
+    KERNEL_AVX2
+  };
+
+  // Best kernel supported by the running CPU, capped by setMaxKernelLevel()
+  KernelLevel kernelLevel();
+
+  // Caps the kernel returned by kernelLevel(), e.g. to force the scalar
+  // path when comparing results.  Returns the previous cap.
+  KernelLevel setMaxKernelLevel( KernelLevel level );
+
+  const char *kernelLevelName( KernelLevel level );
+
+  // bilinear8U() and bilinearFunc() quantize weights to FRAC_BITS bits
+  // per axis, within 1 LSB of float bilinear interpolation.  The packed
+  // table kernels use the table's own, usually coarser, fractions.
+  static const int FRAC_BITS = 11;
+  static const int FRAC_ONE = 1 << FRAC_BITS;
+
+  struct SourceImage {
+    SourceImage( const uint8_t *d, int s, int w, int h )
+      : data(d), step(s), width(w), height(h) {;}
+
+    const uint8_t *data;
+    int step;
+    int width, height;
+  };
+
+  enum Depth {
+    DEPTH_8U = 0,
+    DEPTH_16U,
+    DEPTH_32F
+  };
+
+  // Bilinear remap of `count` consecutive output pixels from a single-channel
+  // 8-bit image.  mapX/mapY hold source coordinates; a negative mapX marks
+  // an invalid output pixel, which is written as 0.  Valid coordinates must
+  // satisfy 0 <= x < width-1 and 0 <= y < height-1.
+  void bilinear8U( const SourceImage &src,
+                   const float *mapX, const float *mapY,
+                   uint8_t *dst, int count,
+                   KernelLevel level = kernelLevel() );
+
+  // Type-erased remap kernel;  dst points to `count` pixels of the
+  // kernel's depth and channel count.
+  typedef void (*RemapFunc)( const SourceImage &src,
+                             const float *mapX, const float *mapY,
+                             void *dst, int count );
+
+  // Bilinear kernel for 8U, 16U or 32F images with 1, 3 or 4 channels, or
+  // nullptr if the combination isn't supported.  Integer depths use
+  // fixed-point weights (FRAC_BITS for 8U, 16 bits for 16U) and stay within
+  // 1 LSB of float interpolation;  32F interpolates in float.
+  RemapFunc bilinearFunc( Depth depth, int channels,
+                          KernelLevel level = kernelLevel() );
+
+  //==== Packed remap tables ====
+
+  // Half-open run [begin,end) of valid pixels within a table row
+  struct Span {
+    Span( int b, int e ) : begin(b), end(e) {;}
+    int begin, end;
+  };
+
+  // Output rectangle [x0,x1) x [y0,y1)
+  struct Tile {
+    Tile( int l, int t, int r, int b ) : x0(l), y0(t), x1(r), y1(b) {;}
+    int x0, y0, x1, y1;
+  };
+
+  // Source footprint (in pixels) a tile may touch before it is split, sized
+  // so a tile of 4-byte pixels stays within a 256 KB L2 cache.
+  static const int DEFAULT_TILE_FOOTPRINT = 64 * 1024;
+
+  // Compact remap table, laid out like OpenCV's CV_16SC2 + CV_16UC1 maps:
+  // per output pixel an int16 (x,y) integer source coordinate and a uint16
+  // interpolation index holding fracBits of x fraction in the low bits and
+  // fracBits of y fraction above them.  6 bytes per pixel rather than 8 for
+  // a pair of float maps.
+  //
+  // Each row additionally stores the spans of valid pixels, so kernels
+  // never test individual pixels for validity;  pixels outside the spans
+  // are written as 0.
+  //
+  // The table also carries a tile schedule covering the output.  Tiles start
+  // as full-width bands of rows and are split until the bounding box of the
+  // source pixels each reads fits in the footprint budget, so strongly
+  // distorting maps (where neighbouring output rows read distant source
+  // rows) are traversed in cache-sized pieces, while mild maps keep a
+  // row-major order.
+  struct RemapTable {
+    RemapTable()
+      : width(0), height(0), fracBits(0) {;}
+
+    // Builds the table from float maps in which a negative x marks an
+    // invalid pixel.  Valid coordinates must satisfy 0 <= x < srcWidth-1
+    // and 0 <= y < srcHeight-1;  fracBits must be <= 8.
+    void build( const float *mapX, const float *mapY, int w, int h,
+                int srcWidth, int srcHeight, int bits = 8 );
+
+    // Recomputes the tile schedule for a different footprint budget.
+    // build() calls this with DEFAULT_TILE_FOOTPRINT.
+    void buildTiles( int maxFootprint = DEFAULT_TILE_FOOTPRINT );
+
+    // True if the table holds the invariants build() establishes for a
+    // source of this size, which the kernels rely on instead of checking
+    // bounds:  ordered spans within each row, tiles covering the output
+    // exactly once, and valid pixels whose 2x2 neighbourhood lies inside
+    // the source.  For tables read back from disk.
+    bool consistent( int srcWidth, int srcHeight ) const;
+
+    bool empty() const { return xy.empty(); }
+
+    const int16_t *xyRow( int y ) const     { return xy.data() + 2*y*width; }
+    const uint16_t *fracRow( int y ) const  { return frac.data() + y*width; }
+
+    const Span *spansBegin( int y ) const   { return spans.data() + rowSpans[y]; }
+    const Span *spansEnd( int y ) const     { return spans.data() + rowSpans[y+1]; }
+
+    // Memory used by the table
+    size_t bytes() const;
+
+    int width, height, fracBits;
+
+    std::vector<int16_t> xy;
+    std::vector<uint16_t> frac;
+
+    std::vector<Span> spans;
+    std::vector<int> rowSpans;    // spans of row y are [rowSpans[y], rowSpans[y+1])
+
+    std::vector<Tile> tiles;      // disjoint, covering the output, in traversal order
+  };
+
+  // Packed-table kernel over `count` consecutive pixels, all of which are
+  // valid.  Results are interpolated at the table's quantized coordinate.
+  // With 8-bit fractions that keeps 8U within 2 LSB of float interpolation
+  // at the exact coordinate, but the coordinate error (up to 1/512 px per
+  // axis) is amplified by the image gradient:  on steep 16U or 32F
+  // gradients it can cost hundreds of LSB, so callers needing accuracy
+  // there should use bilinearFunc() with float maps.
+  typedef void (*PackedRemapFunc)( const SourceImage &src,
+                                   const int16_t *xy, const uint16_t *frac, int fracBits,
+                                   void *dst, int count );
+
+  // Same depths and channel counts as bilinearFunc();  8UC1 has SSE4.1 and
+  // AVX2 variants.
+  PackedRemapFunc packedBilinearFunc( Depth depth, int channels,
+                                      KernelLevel level = kernelLevel() );
+
+  // Nearest-neighbour kernel:  each pixel copies the tap nearest its exact
+  // coordinate.  Same depths and channel counts as bilinearFunc().
+  PackedRemapFunc packedNearestFunc( Depth depth, int channels );
+
+  // Bicubic kernel (Keys' cubic with a = -0.75, as cv::INTER_CUBIC) over
+  // the 4x4 neighbourhood of each pixel.  Taps outside the source read as
+  // 0, as cv::remap with BORDER_CONSTANT.  Integer results are rounded
+  // and saturated.  Same depths and channel counts as bilinearFunc().
+  PackedRemapFunc packedBicubicFunc( Depth depth, int channels );
+
+  //==== Depth kernels ====
+
+  // Blending depths across an object boundary invents surfaces, so depth
+  // kernels pick one of the four bilinear taps of each map entry instead.
+  enum DepthSampling {
+    SAMPLE_NEAREST = 0,   // the tap nearest the exact coordinate
+    SAMPLE_MIN_DEPTH      // the nearest surface:  the smallest valid tap
+  };
+
+  // Depth kernel for single-channel 16U or 32F images, or nullptr for other
+  // depths.  A depth is valid if > 0, so 0 and NaN mark missing values;
+  // missing results are written as 0.  Unlike the bilinear kernels, taps
+  // outside the source image are read as missing, so the kernel also
+  // accepts unclipped fixed-point maps as produced by cv::convertMaps
+  // (CV_16SC2 + CV_16UC1, cv::INTER_BITS fraction bits).
+  PackedRemapFunc packedDepthFunc( Depth depth, DepthSampling sampling );
+
+  //==== Converting kernels ====
+
+  // Colour and type conversion applied while remapping, so a raw 8-bit
+  // frame is read once rather than once per conversion step.  Channels
+  // are interpolated first, then combined and scaled, which for these
+  // linear conversions is equivalent up to rounding.
+  struct Conversion {
+    float weights[4];   // per source channel, for a single-channel result
+    float alpha, beta;  // result = alpha * value + beta, as cv::Mat::convertTo
+  };
+
+  typedef void (*ConvertingRemapFunc)( const SourceImage &src,
+                                       const int16_t *xy, const uint16_t *frac, int fracBits,
+                                       const Conversion &conversion, void *dst, int count );
+
+  // Bilinear kernel from an 8-bit image with srcChannels (1, 3 or 4) to
+  // 8U or 32F with dstChannels, either 1 (a weighted sum of the source
+  // channels) or srcChannels;  nullptr for other combinations.  Like the
+  // depth kernels it accepts unclipped fixed-point maps:  taps outside the
+  // source read as 0, as cv::remap with BORDER_CONSTANT, and beta is
+  // weighted by the taps inside it, so the border matches converting
+  // before remapping.
+  ConvertingRemapFunc convertingBilinearFunc( int srcChannels, int dstChannels, Depth dstDepth );
+
+  // Remaps columns [x0,x1) of table row y into dstRow (which points at
+  // column 0 of the output row), zeroing pixels outside the valid spans.
+  void remapRow( const SourceImage &src, const RemapTable &table,
+                 PackedRemapFunc kernel, size_t pixelSize,
+                 int y, int x0, int x1, uint8_t *dstRow );
+
+  // As remapRow(), but dst points at column x0 of the output, e.g. into an
+  // image holding only a region of the output
+  void remapSpan( const SourceImage &src, const RemapTable &table,
+                  PackedRemapFunc kernel, size_t pixelSize,
+                  int y, int x0, int x1, uint8_t *dst );
+
+  // Remaps one tile into dst, an image with row stride dstStep.
+  void remapTile( const SourceImage &src, const RemapTable &table,
+                  PackedRemapFunc kernel, size_t pixelSize,
+                  const Tile &tile, uint8_t *dst, size_t dstStep );
+
+}
+}
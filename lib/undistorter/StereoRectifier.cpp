@@ -0,0 +1,114 @@
+
+#include "libvideoio/StereoRectifier.h"
+#include "libvideoio/ThreadPool.h"
+#include "libvideoio/FramePool.h"
+
+namespace libvideoio
+{
+
+StereoRectifier::StereoRectifier( const std::shared_ptr<OpenCVUndistorter> &left,
+                                  const std::shared_ptr<OpenCVUndistorter> &right )
+  : _left( left ),
+    _right( right ),
+    _baseline( 0.0 ),
+    _numThreads( 0 )
+{
+  CHECK( _left && _right ) << "StereoRectifier needs both undistorters";
+  CHECK( _left->outputImageSize()() == _right->outputImageSize()() )
+      << "Rectified left and right images must be the same size";
+
+  // OpenCVUndistorter stores -Tx/fx from each projection matrix, which is
+  // zero for the left camera of a ROS stereo calibration
+  _baseline = _right->baseline()[0] - _left->baseline()[0];
+
+  if( _baseline == 0.0 ) {
+    LOG(WARNING) << "StereoRectifier: zero baseline, Q is undefined";
+    return;
+  }
+
+  const cv::Mat K1( _left->getK() ), K2( _right->getK() );
+  const double f = K1.at<double>(0,0);
+  const double cx = K1.at<double>(0,2), cy = K1.at<double>(1,2);
+  const double cx2 = K2.at<double>(0,2);
+
+  // As cv::stereoRectify, with Tx = -baseline
+  _Q = (cv::Mat_<double>(4,4) << 1, 0, 0, -cx,
+                                 0, 1, 0, -cy,
+                                 0, 0, 0, f,
+                                 0, 0, 1.0 / _baseline, (cx2 - cx) / _baseline );
+}
+
+StereoRectifier *StereoRectifier::loadFromFiles( const std::string &leftYaml,
+                                                 const std::string &rightYaml )
+{
+  std::shared_ptr<OpenCVUndistorter> left( ROSUndistorterFactory::loadFromFile( leftYaml ) );
+  std::shared_ptr<OpenCVUndistorter> right( ROSUndistorterFactory::loadFromFile( rightYaml ) );
+
+  if( !left || !right ) return nullptr;
+
+  return new StereoRectifier( left, right );
+}
+
+int StereoRectifier::numThreads() const
+{
+  return (_numThreads > 0) ? _numThreads : ThreadPool::global().numWorkers() + 1;
+}
+
+void StereoRectifier::rectify( const cv::Mat &left, const cv::Mat &right,
+                               cv::OutputArray leftResult, cv::OutputArray rightResult ) const
+{
+  ThreadPool &pool( ThreadPool::global() );
+
+  // Any deferred maps are built concurrently.  parallelFor rather than
+  // submit() and get(), as the caller runs whichever image no worker has
+  // taken, so this can't deadlock when rectify() runs on a pool worker.
+  pool.parallelFor( 0, 2, 2, [this]( int b0, int b1 ) {
+    for( int b = b0; b < b1; ++b ) (b == 0 ? _left : _right)->prepare();
+  });
+
+  // Stages wrapped by either undistorter run first, one per thread, into
+  // pooled buffers
+  cv::Mat leftIn, rightIn;
+  pool.parallelFor( 0, 2, 2, [&]( int b0, int b1 ) {
+    for( int b = b0; b < b1; ++b ) {
+      const OpenCVUndistorter &undistorter( b == 0 ? *_left : *_right );
+      const cv::Mat &in( b == 0 ? left : right );
+      cv::Mat &out( b == 0 ? leftIn : rightIn );
+
+      if( undistorter.wrapped() ) {
+        out = FramePool::global().acquire( undistorter.wrapped()->outputImageSize()(), in.type() );
+        undistorter.wrapped()->undistort( in, out );
+      } else {
+        out = in;
+      }
+    }
+  });
+
+  leftResult.create( _left->outputImageSize()(), leftIn.type() );
+  rightResult.create( _right->outputImageSize()(), rightIn.type() );
+  cv::Mat leftOut( leftResult.getMat() ), rightOut( rightResult.getMat() );
+
+  // Either result may be either input, e.g. rectify( l, r, l, r )
+  leftIn = Undistorter::unaliased( Undistorter::unaliased( leftIn, leftOut ), rightOut );
+  rightIn = Undistorter::unaliased( Undistorter::unaliased( rightIn, leftOut ), rightOut );
+
+  // Even bands are left, odd bands right, so whichever threads are free
+  // alternate between the images and both finish together
+  const int bandsPerImage = numThreads();
+  const int rows = leftOut.rows;
+
+  pool.parallelFor( 0, 2*bandsPerImage, 2*bandsPerImage, [&]( int b0, int b1 ) {
+    for( int b = b0; b < b1; ++b ) {
+      const int band = b / 2;
+      const int y0 = (long long)rows * band / bandsPerImage;
+      const int y1 = (long long)rows * (band+1) / bandsPerImage;
+
+      if( b % 2 == 0 )
+        _left->undistortRows( leftIn, leftOut, y0, y1 );
+      else
+        _right->undistortRows( rightIn, rightOut, y0, y1 );
+    }
+  });
+}
+
+}
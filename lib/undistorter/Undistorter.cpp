@@ -0,0 +1,622 @@
+
+#include "libvideoio/Undistorter.h"
+#include "libvideoio/ThreadPool.h"
+#include "libvideoio/FramePool.h"
+#include "PointGrid.h"
+#include "RemapKernels.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <deque>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+namespace libvideoio
+{
+
+  const float Undistorter::InvalidCoordinate = -1e5f;
+
+  static std::atomic<int> DefaultNumThreads( 1 );
+
+  void Undistorter::setDefaultNumThreads( int n )
+  {
+    DefaultNumThreads = std::max( 1, n );
+  }
+
+  int Undistorter::defaultNumThreads()
+  {
+    return DefaultNumThreads;
+  }
+
+  static std::atomic<int> DefaultMapBuildPolicy( Undistorter::BuildMapsEagerly );
+
+  void Undistorter::setDefaultMapBuildPolicy( MapBuildPolicy policy )
+  {
+    DefaultMapBuildPolicy = policy;
+  }
+
+  Undistorter::MapBuildPolicy Undistorter::defaultMapBuildPolicy()
+  {
+    return static_cast<MapBuildPolicy>( DefaultMapBuildPolicy.load() );
+  }
+
+  // Set by undistortBatch() on the threads it runs frames on, overriding
+  // every undistorter's own thread count
+  static thread_local int BatchNumThreads = 0;
+
+  struct ScopedBatchThreads {
+    ScopedBatchThreads( int n ) : previous( BatchNumThreads ) { BatchNumThreads = n; }
+    ~ScopedBatchThreads() { BatchNumThreads = previous; }
+    int previous;
+  };
+
+  int Undistorter::numThreads() const
+  {
+    if( BatchNumThreads > 0 ) return BatchNumThreads;
+    return (_numThreads > 0) ? _numThreads : defaultNumThreads();
+  }
+
+  void Undistorter::undistort( const cv::Mat &image, cv::OutputArray result, const cv::Rect &outputRoi ) const
+  {
+    cv::Mat full;
+    undistort( image, full );
+
+    CHECK( (outputRoi & cv::Rect( 0, 0, full.cols, full.rows )) == outputRoi ) << "ROI outside output image";
+    full( outputRoi ).copyTo( result );
+  }
+
+  // Frames smaller than this are always processed one per thread, as
+  // splitting them into bands costs more than it gains
+  static const int MinBandParallelPixels = 640 * 480;
+
+  void Undistorter::undistortBatch( const cv::Mat *images, cv::Mat *results, size_t count ) const
+  {
+    if( count == 0 ) return;
+
+    // Build any deferred maps once, up front, rather than in every task
+    prepare();
+
+    ThreadPool &pool( ThreadPool::global() );
+    const int threads = pool.numWorkers() + 1;
+
+    const bool frameParallel = count >= (size_t)threads ||
+                               images[0].rows * images[0].cols < MinBandParallelPixels;
+
+    if( frameParallel ) {
+      // One band per frame, so threads pick up frames dynamically
+      pool.parallelFor( 0, (int)count, (int)count, [&]( int i0, int i1 ) {
+        ScopedBatchThreads serial( 1 );
+        for( int i = i0; i < i1; ++i ) undistort( images[i], results[i] );
+      });
+    } else {
+      ScopedBatchThreads banded( threads );
+      for( size_t i = 0; i < count; ++i ) undistort( images[i], results[i] );
+    }
+  }
+
+  void Undistorter::undistortBatch( const std::vector<cv::Mat> &images, std::vector<cv::Mat> &results ) const
+  {
+    results.resize( images.size() );
+    undistortBatch( images.data(), results.data(), images.size() );
+  }
+
+  void Undistorter::undistortRGBD( const cv::Mat &image, const cv::Mat &depth,
+                                   cv::OutputArray result, cv::OutputArray depthResult ) const
+  {
+    undistort( image, result );
+    undistortDepth( depth, depthResult );
+  }
+
+  void Undistorter::convertAndUndistort( const cv::Mat &image, cv::OutputArray result,
+                                         int code, int rdepth, double alpha, double beta ) const
+  {
+    cv::Mat converted( image );
+
+    if( code >= 0 ) {
+      cv::Mat colour;
+      cv::cvtColor( converted, colour, code );
+      converted = colour;
+    }
+
+    if( converted.depth() != rdepth || alpha != 1.0 || beta != 0.0 ) {
+      cv::Mat typed;
+      converted.convertTo( typed, rdepth, alpha, beta );
+      converted = typed;
+    }
+
+    undistort( converted, result );
+  }
+
+  void Undistorter::setDepthSampling( DepthSampling sampling )
+  {
+    _depthSampling = sampling;
+    if( _wrapped ) _wrapped->setDepthSampling( sampling );
+  }
+
+  void Undistorter::setInterpolation( Interpolation mode )
+  {
+    _interpolation = mode;
+    if( _wrapped ) _wrapped->setInterpolation( mode );
+  }
+
+  cv::Mat Undistorter::unaliased( const cv::Mat &src, const cv::Mat &dst )
+  {
+    if( src.empty() || dst.empty() ) return src;
+
+    const bool overlap = src.datastart < dst.dataend && dst.datastart < src.dataend;
+    return overlap ? src.clone() : src;
+  }
+
+  void Undistorter::remapDepthRows( const cv::Mat &depth, const cv::Mat &map1, const cv::Mat &map2,
+                                    cv::Mat &out, int y0, int y1 ) const
+  {
+    // DepthSampling and remap::DepthSampling share values
+    const remap::DepthSampling sampling( static_cast<remap::DepthSampling>( _depthSampling ) );
+    remap::PackedRemapFunc kernel = nullptr;
+    if( depth.channels() == 1 ) {
+      switch( depth.depth() ) {
+        case CV_16U: kernel = remap::packedDepthFunc( remap::DEPTH_16U, sampling ); break;
+        case CV_32F: kernel = remap::packedDepthFunc( remap::DEPTH_32F, sampling ); break;
+        default: break;
+      }
+    }
+
+    // Other types are sampled nearest by cv::remap, which never blends
+    // depths.  Through float maps, as with fixed-point maps its
+    // INTER_NEAREST truncates rather than rounds.
+    if( !kernel ) {
+      static std::once_flag warning;
+      std::call_once( warning, [&]() {
+        LOG(WARNING) << "No depth kernel for type " << depth.type() << ", sampling nearest with cv::remap";
+      });
+
+      cv::Mat mapX, mapY, band( out.rowRange(y0, y1) );
+      cv::convertMaps( map1.rowRange(y0, y1), map2.rowRange(y0, y1), mapX, mapY, CV_32FC1 );
+      cv::remap( depth, band, mapX, mapY, cv::INTER_NEAREST, cv::BORDER_CONSTANT );
+      return;
+    }
+
+    const remap::SourceImage src( depth.data, depth.step, depth.cols, depth.rows );
+    for( int y = y0; y < y1; ++y ) {
+      kernel( src, map1.ptr<int16_t>(y), map2.ptr<uint16_t>(y), cv::INTER_BITS, out.ptr(y), out.cols );
+    }
+  }
+
+  bool Undistorter::remapExact( const cv::Mat &src, cv::Mat &out,
+                                const cv::Mat &mapX, const cv::Mat &mapY, const cv::Point &offset )
+  {
+    remap::Depth depth;
+    switch( src.depth() ) {
+      case CV_8U:  depth = remap::DEPTH_8U;  break;
+      case CV_16U: depth = remap::DEPTH_16U; break;
+      case CV_32F: depth = remap::DEPTH_32F; break;
+      default:     return false;
+    }
+
+    const remap::RemapFunc kernel = remap::bilinearFunc( depth, src.channels() );
+    if( !kernel ) return false;
+
+    const remap::SourceImage source( src.data, (int)src.step, src.cols, src.rows );
+    const int width = out.cols;
+    std::vector<float> xs( width ), ys( width );
+
+    for( int y = 0; y < out.rows; ++y ) {
+      const float *mx = mapX.ptr<float>(y), *my = mapY.ptr<float>(y);
+
+      if( offset != cv::Point(0,0) ) {
+        // Invalid pixels stay negative, as the offset is never negative
+        for( int x = 0; x < width; ++x ) {
+          xs[x] = (mx[x] < 0) ? -1.0f : mx[x] - offset.x;
+          ys[x] = my[x] - offset.y;
+        }
+        mx = xs.data();
+        my = ys.data();
+      }
+
+      kernel( source, mx, my, out.ptr(y), width );
+    }
+
+    return true;
+  }
+
+  struct Undistorter::PyramidMaps {
+    PyramidMaps() : valid( false ) {;}
+
+    // Maps for levels 1.., each into sourceLevel of the input's
+    // cv::pyrDown pyramid, the one nearest its scale:  CV_16SC2 /
+    // CV_16UC1 fixed-point maps, the same rounded for InterpolateNearest,
+    // and CV_32FC1 maps for InterpolateLinearExact (as remapExact())
+    std::vector<cv::Mat> map1, map2, nearest, exactX, exactY;
+    std::vector<int> sourceLevel;
+    bool valid;
+  };
+
+  void Undistorter::undistortPyramid( const cv::Mat &image, std::vector<cv::Mat> &levels, int numLevels ) const
+  {
+    CHECK( numLevels > 0 ) << "Pyramid needs at least one level";
+
+    levels.resize( numLevels );
+    undistort( image, levels[0] );
+    if( numLevels == 1 ) return;
+
+    std::shared_ptr<const PyramidMaps> maps( pyramidMaps( numLevels ) );
+
+    if( !maps->valid || image.size() != originalInputSize()() ) {
+      for( int l = 1; l < numLevels; ++l ) cv::pyrDown( levels[l-1], levels[l] );
+      return;
+    }
+
+    // Every level samples the input pyramid level nearest its scale, so
+    // detail too fine for the level is filtered out by cv::pyrDown rather
+    // than aliased, and is resampled in a single pass
+    std::vector<cv::Mat> inputLevels( 1, image );
+    for( int l = 1; l < numLevels; ++l ) {
+      const cv::Mat &map1( maps->map1[l-1] ), &map2( maps->map2[l-1] );
+
+      while( (int)inputLevels.size() <= maps->sourceLevel[l-1] ) {
+        cv::Mat reduced;
+        cv::pyrDown( inputLevels.back(), reduced );
+        inputLevels.push_back( reduced );
+      }
+      const cv::Mat &source( inputLevels[ maps->sourceLevel[l-1] ] );
+
+      levels[l].create( map1.size(), image.type() );
+      cv::Mat out( levels[l] );
+
+      forEachBand( out.rows, [&]( int y0, int y1 ) {
+        cv::Mat band( out.rowRange(y0, y1) );
+
+        switch( interpolation() ) {
+          case InterpolateNearest:
+            cv::remap( source, band, maps->nearest[l-1].rowRange(y0, y1), cv::noArray(), cv::INTER_NEAREST );
+            return;
+
+          case InterpolateLinearExact:
+            if( remapExact( source, band, maps->exactX[l-1].rowRange(y0, y1), maps->exactY[l-1].rowRange(y0, y1) ) ) return;
+            break;    // other types use the fixed-point maps
+
+          default:
+            break;
+        }
+
+        cv::remap( source, band, map1.rowRange(y0, y1), map2.rowRange(y0, y1),
+                   interpolation() == InterpolateCubic ? cv::INTER_CUBIC : cv::INTER_LINEAR );
+      });
+    }
+  }
+
+  std::shared_ptr<const Undistorter::PyramidMaps> Undistorter::pyramidMaps( int numLevels ) const
+  {
+    std::lock_guard<std::mutex> lock( _pyramidMutex );
+    if( _pyramidMaps && (!_pyramidMaps->valid || (int)_pyramidMaps->map1.size() >= numLevels-1) ) return _pyramidMaps;
+
+    std::shared_ptr<PyramidMaps> maps( new PyramidMaps );
+    _pyramidMaps = maps;
+
+    // Level sizes as cv::pyrDown
+    std::vector<ImageSize> sizes;
+    ImageSize size( outputImageSize() );
+    for( int l = 1; l < numLevels; ++l ) {
+      size = ImageSize( (size.width + 1) / 2, (size.height + 1) / 2 );
+      sizes.push_back( size );
+    }
+
+    std::vector<cv::Mat> mapX, mapY;
+    if( !pyramidSourceMaps( sizes, mapX, mapY ) ) return _pyramidMaps;
+
+    // The input pyramid level whose pixels are nearest in size to the
+    // level's, judged from the whole image;  input pixel u is pixel
+    // u / 2^k of input level k
+    const ImageSize inSize( originalInputSize() );
+    const size_t n = sizes.size();
+    maps->map1.resize( n );
+    maps->map2.resize( n );
+    maps->nearest.resize( n );
+    maps->exactX.resize( n );
+    maps->exactY.resize( n );
+    maps->sourceLevel.resize( n );
+    for( size_t i = 0; i < n; ++i ) {
+      const double ratio = std::min( double(inSize.width) / sizes[i].width, double(inSize.height) / sizes[i].height );
+      const int k = std::max( 0, (int)std::floor( std::log2( ratio ) + 0.5 ) );
+      maps->sourceLevel[i] = k;
+
+      const double scale = 1.0 / (1 << k);
+      cv::Mat x( mapX[i] * scale ), y( mapY[i] * scale );
+      cv::convertMaps( x, y, maps->map1[i], maps->map2[i], CV_16SC2 );
+      cv::convertMaps( x, y, maps->nearest[i], cv::noArray(), CV_16SC2, true );
+
+      // Input level k's size, as cv::pyrDown.  The exact kernels read
+      // (x,y) .. (x+1,y+1) without bounds checks, so sources outside that
+      // range are marked invalid.
+      int levelW = inSize.width, levelH = inSize.height;
+      for( int j = 0; j < k; ++j ) {
+        levelW = (levelW + 1) / 2;
+        levelH = (levelH + 1) / 2;
+      }
+
+      const float maxX = levelW - 1, maxY = levelH - 1;
+      for( int r = 0; r < x.rows; ++r ) {
+        float *px = x.ptr<float>(r), *py = y.ptr<float>(r);
+        for( int c = 0; c < x.cols; ++c ) {
+          if( !( px[c] >= 0 && px[c] < maxX && py[c] >= 0 && py[c] < maxY ) )
+            px[c] = py[c] = -1.0f;
+        }
+      }
+      maps->exactX[i] = x;
+      maps->exactY[i] = y;
+    }
+
+    maps->valid = true;
+    return _pyramidMaps;
+  }
+
+  bool Undistorter::pyramidSourceMaps( const std::vector<ImageSize> &sizes,
+                                       std::vector<cv::Mat> &mapX, std::vector<cv::Mat> &mapY ) const
+  {
+    cv::Mat fullX, fullY;
+    if( !getSourceMap( fullX, fullY ) ) return false;
+
+    // Bilinear resampling evaluates the map at each level's pixel centres;
+    // entries mixed with invalid ones stay far outside the input
+    mapX.resize( sizes.size() );
+    mapY.resize( sizes.size() );
+    for( size_t i = 0; i < sizes.size(); ++i ) {
+      cv::resize( fullX, mapX[i], sizes[i](), 0, 0, cv::INTER_LINEAR );
+      cv::resize( fullY, mapY[i], sizes[i](), 0, 0, cv::INTER_LINEAR );
+    }
+
+    return true;
+  }
+
+  // Scratch buffers for undistortWrapped(), one per level of nesting.  A
+  // deque, as nested calls append while outer levels hold references.
+  static thread_local std::deque<cv::Mat> WrappedScratch;
+  static thread_local size_t WrappedDepth = 0;
+
+  cv::Mat Undistorter::undistortWrapped( const cv::Mat &image ) const
+  {
+    if( !_wrapped ) return image;
+
+    const size_t depth = WrappedDepth;
+    if( WrappedScratch.size() <= depth ) WrappedScratch.resize( depth+1 );
+
+    // Only write into buffers nothing else references.  A stage may
+    // have returned a view of its input (e.g. ImageCropper), or the
+    // caller may still hold a previous intermediate.
+    cv::Mat &scratch( WrappedScratch[depth] );
+    if( !scratch.u || scratch.u->refcount != 1 ) scratch.release();
+
+    struct DepthGuard {
+      DepthGuard() { ++WrappedDepth; }
+      ~DepthGuard() { --WrappedDepth; }
+    } guard;
+
+    _wrapped->undistort( image, scratch );
+    return scratch;
+  }
+
+  cv::Mat Undistorter::undistortDepthWrapped( const cv::Mat &depth ) const
+  {
+    if( !_wrapped ) return depth;
+
+    cv::Mat intermediate( FramePool::global().acquire( _wrapped->outputImageSize()(), depth.type() ) );
+    _wrapped->undistortDepth( depth, intermediate );
+    return intermediate;
+  }
+
+  void Undistorter::forEachBand( int rows, const std::function<void(int,int)> &fn ) const
+  {
+    ThreadPool::global().parallelFor( 0, rows, numThreads(), fn );
+  }
+
+  bool Undistorter::composeWithWrapped( const cv::Mat &localX, const cv::Mat &localY,
+                                        cv::Mat &mapX, cv::Mat &mapY ) const
+  {
+    if( !_wrapped ) {
+      mapX = localX;
+      mapY = localY;
+      return true;
+    }
+
+    cv::Mat innerX, innerY;
+    if( !_wrapped->getSourceMap( innerX, innerY ) ) return false;
+
+    CHECK( localX.type() == CV_32F && localY.type() == CV_32F );
+    CHECK( innerX.type() == CV_32F && innerY.type() == CV_32F );
+
+    mapX.create( localX.size(), CV_32F );
+    mapY.create( localX.size(), CV_32F );
+
+    const int innerW = innerX.cols, innerH = innerX.rows;
+    const float invalidThreshold = InvalidCoordinate / 2;
+
+    // Bilinear lookup into the inner maps.  A pixel is invalid if it falls
+    // outside the inner map or any of the taps it uses is invalid.
+    forEachBand( localX.rows, [&]( int y0, int y1 ) {
+      for( int y = y0; y < y1; ++y ) {
+        const float *lx = localX.ptr<float>(y), *ly = localY.ptr<float>(y);
+        float *ox = mapX.ptr<float>(y), *oy = mapY.ptr<float>(y);
+
+        for( int x = 0; x < localX.cols; ++x ) {
+          ox[x] = oy[x] = InvalidCoordinate;
+
+          if( !(lx[x] >= 0 && ly[x] >= 0 && lx[x] <= innerW-1 && ly[x] <= innerH-1) ) continue;
+
+          const int xi = std::min( (int)lx[x], std::max( innerW-2, 0 ) );
+          const int yi = std::min( (int)ly[x], std::max( innerH-2, 0 ) );
+          const int xn = std::min( xi+1, innerW-1 ), yn = std::min( yi+1, innerH-1 );
+          const float fx = lx[x] - xi, fy = ly[x] - yi;
+
+          const float x00 = innerX.at<float>(yi,xi), x01 = innerX.at<float>(yi,xn),
+                      x10 = innerX.at<float>(yn,xi), x11 = innerX.at<float>(yn,xn);
+          const float y00 = innerY.at<float>(yi,xi), y01 = innerY.at<float>(yi,xn),
+                      y10 = innerY.at<float>(yn,xi), y11 = innerY.at<float>(yn,xn);
+
+          if( std::min( std::min(x00, x01), std::min(x10, x11) ) < invalidThreshold ) continue;
+
+          ox[x] = (1-fy) * ((1-fx)*x00 + fx*x01) + fy * ((1-fx)*x10 + fx*x11);
+          oy[x] = (1-fy) * ((1-fx)*y00 + fx*y01) + fy * ((1-fx)*y10 + fx*y11);
+        }
+      }
+    });
+
+    return true;
+  }
+
+  //==== Sparse points ====
+
+  struct Undistorter::PointGrids {
+    PointGrids() : valid( false ) {;}
+
+    remap::PointGrid forward;     // output pixel -> input pixel
+    remap::PointGrid inverse;     // input pixel -> output pixel
+    bool valid;
+  };
+
+  // Bilinear sample of a pair of CV_32F maps, or false if (x,y) is outside
+  // the maps or touches an invalid entry
+  static bool sampleMaps( const cv::Mat &mapX, const cv::Mat &mapY, float x, float y, cv::Point2f &out )
+  {
+    if( !(x >= 0 && y >= 0 && x <= mapX.cols-1 && y <= mapX.rows-1) ) return false;
+
+    const int xi = std::min( (int)x, mapX.cols-2 ), yi = std::min( (int)y, mapX.rows-2 );
+    const float fx = x - xi, fy = y - yi;
+
+    const float x00 = mapX.at<float>(yi,xi),   x01 = mapX.at<float>(yi,xi+1),
+                x10 = mapX.at<float>(yi+1,xi), x11 = mapX.at<float>(yi+1,xi+1);
+    if( std::min( std::min(x00, x01), std::min(x10, x11) ) < Undistorter::InvalidCoordinate / 2 ) return false;
+
+    const float y00 = mapY.at<float>(yi,xi),   y01 = mapY.at<float>(yi,xi+1),
+                y10 = mapY.at<float>(yi+1,xi), y11 = mapY.at<float>(yi+1,xi+1);
+
+    out.x = (1-fy) * ((1-fx)*x00 + fx*x01) + fy * ((1-fx)*x10 + fx*x11);
+    out.y = (1-fy) * ((1-fx)*y00 + fx*y01) + fy * ((1-fx)*y10 + fx*y11);
+    return true;
+  }
+
+  ImageSize Undistorter::originalInputSize() const
+  {
+    const Undistorter *innermost = this;
+    while( innermost->_wrapped ) innermost = innermost->_wrapped.get();
+    return innermost->inputImageSize();
+  }
+
+  bool Undistorter::undistortPointsExact( const std::vector<cv::Point2f> &in,
+                                          std::vector<cv::Point2f> &out ) const
+  {
+    cv::Mat mapX, mapY;
+    if( !getSourceMap( mapX, mapY ) ) return false;
+
+    const ImageSize inSize( originalInputSize() );
+    const float maxU = mapX.cols - 1, maxV = mapX.rows - 1;
+    const float scaleX = maxU / std::max( inSize.width-1, 1 ), scaleY = maxV / std::max( inSize.height-1, 1 );
+
+    out.resize( in.size() );
+
+    ThreadPool::global().parallelFor( 0, (int)in.size(), ThreadPool::global().numWorkers()+1, [&]( int k0, int k1 ) {
+      for( int k = k0; k < k1; ++k ) {
+        const cv::Point2f &p( in[k] );
+        cv::Point2f q( p.x * scaleX, p.y * scaleY );
+        out[k] = cv::Point2f( InvalidCoordinate, InvalidCoordinate );
+
+        // Newton iteration on the source map, with a finite difference
+        // Jacobian.  Steps are clamped to the output image, so points
+        // which aren't visible in the output fail to converge.
+        for( int iter = 0; iter < 20; ++iter ) {
+          cv::Point2f f, fu, fv;
+          const float du = (q.x < maxU) ? 1 : -1, dv = (q.y < maxV) ? 1 : -1;
+
+          if( !sampleMaps( mapX, mapY, q.x, q.y, f ) ||
+              !sampleMaps( mapX, mapY, q.x + du, q.y, fu ) ||
+              !sampleMaps( mapX, mapY, q.x, q.y + dv, fv ) ) break;
+
+          const cv::Point2f r( f - p );
+          if( r.dot(r) < 1e-6f ) {
+            out[k] = q;
+            break;
+          }
+
+          const float a = (fu.x - f.x) / du, b = (fv.x - f.x) / dv;
+          const float c = (fu.y - f.y) / du, d = (fv.y - f.y) / dv;
+          const float det = a*d - b*c;
+          if( std::abs(det) < 1e-9f ) break;
+
+          q.x = std::min( std::max( q.x - ( d*r.x - b*r.y) / det, 0.0f ), maxU );
+          q.y = std::min( std::max( q.y - (-c*r.x + a*r.y) / det, 0.0f ), maxV );
+        }
+      }
+    });
+
+    return true;
+  }
+
+  std::shared_ptr<const Undistorter::PointGrids> Undistorter::pointGrids() const
+  {
+    std::lock_guard<std::mutex> lock( _pointGridMutex );
+    if( _pointGrids ) return _pointGrids;
+
+    std::shared_ptr<PointGrids> grids( new PointGrids );
+    _pointGrids = grids;
+
+    cv::Mat mapX, mapY;
+    if( !getSourceMap( mapX, mapY ) ) return _pointGrids;
+
+    // Forward grid:  sample the dense source map at the nodes
+    const ImageSize outSize( outputImageSize() );
+    remap::PointGrid &forward( grids->forward );
+    forward.layout( outSize.width, outSize.height, remap::POINT_GRID_SPACING, InvalidCoordinate );
+
+    for( int j = 0; j < forward.rows; ++j ) {
+      for( int i = 0; i < forward.cols; ++i ) {
+        const cv::Point2f n( forward.node(i,j) );
+        cv::Point2f v;
+        if( sampleMaps( mapX, mapY, n.x, n.y, v ) ) {
+          forward.x[j*forward.cols + i] = v.x;
+          forward.y[j*forward.cols + i] = v.y;
+        }
+      }
+    }
+
+    // Inverse grid:  evaluate the exact mapping at the nodes
+    const ImageSize inSize( originalInputSize() );
+    remap::PointGrid &inverse( grids->inverse );
+    inverse.layout( inSize.width, inSize.height, remap::POINT_GRID_SPACING, InvalidCoordinate );
+
+    std::vector<cv::Point2f> nodes, values;
+    for( int j = 0; j < inverse.rows; ++j ) {
+      for( int i = 0; i < inverse.cols; ++i ) nodes.push_back( inverse.node(i,j) );
+    }
+
+    if( !undistortPointsExact( nodes, values ) ) return _pointGrids;
+
+    for( size_t n = 0; n < values.size(); ++n ) {
+      inverse.x[n] = values[n].x;
+      inverse.y[n] = values[n].y;
+    }
+
+    grids->valid = true;
+    return _pointGrids;
+  }
+
+  bool Undistorter::undistortPoints( const std::vector<cv::Point2f> &in, std::vector<cv::Point2f> &out ) const
+  {
+    std::shared_ptr<const PointGrids> grids( pointGrids() );
+    if( !grids->valid ) return false;
+
+    out.resize( in.size() );
+    grids->inverse.lookup( in.data(), out.data(), in.size() );
+    return true;
+  }
+
+  bool Undistorter::distortPoints( const std::vector<cv::Point2f> &in, std::vector<cv::Point2f> &out ) const
+  {
+    std::shared_ptr<const PointGrids> grids( pointGrids() );
+    if( !grids->valid ) return false;
+
+    out.resize( in.size() );
+    grids->forward.lookup( in.data(), out.data(), in.size() );
+    return true;
+  }
+
+}
@@ -0,0 +1,95 @@
+
+#include <cmath>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "undistorter/ATANModel.h"
+
+using namespace libvideoio;
+
+namespace {
+
+  // Reference evaluation of the model in double precision
+  void referenceCoordinate( const remap::ATANModel &m, int x, int y, double &ix, double &iy )
+  {
+    const double d2t = 2.0 * std::tan( m.dist / 2.0 );
+    const double nx = (x - m.ocx) / m.ofx, ny = (y - m.ocy) / m.ofy;
+    const double r = std::sqrt( nx*nx + ny*ny );
+    const double fac = (r == 0 || m.dist == 0) ? 1.0 : std::atan( r * d2t ) / (m.dist * r);
+
+    ix = m.fx*fac*nx + m.cx;
+    iy = m.fy*fac*ny + m.cy;
+  }
+
+}
+
+TEST( ATANModel, AtanApprox ) {
+  for( float t = 0; t < 50.0f; t += 0.001f ) {
+    ASSERT_NEAR( remap::atanApprox(t), std::atan( (double)t ), 2e-7 ) << t;
+  }
+}
+
+TEST( ATANModel, MapWithinBoundOfReference ) {
+  // A wide-angle 4K camera
+  const int inWidth = 3840, inHeight = 2160;
+  const int outWidth = 3840, outHeight = 2160;
+
+  remap::ATANModel m;
+  m.fx = 0.5f * inWidth;  m.fy = 0.9f * inHeight;
+  m.cx = 0.5f * inWidth - 0.5f;  m.cy = 0.5f * inHeight - 0.5f;
+  m.dist = 0.95f;
+  m.ofx = 0.35f * outWidth;  m.ofy = 0.6f * outHeight;
+  m.ocx = 0.5f * outWidth - 0.5f;  m.ocy = 0.5f * outHeight - 0.5f;
+
+  std::vector<float> mapX( outWidth*outHeight ), mapY( outWidth*outHeight );
+
+  for( int level = remap::KERNEL_SCALAR; level <= remap::kernelLevel(); ++level ) {
+    remap::buildATANMap( m, inWidth, inHeight, outWidth, outHeight,
+                         mapX.data(), mapY.data(), static_cast<remap::KernelLevel>(level) );
+
+    int numValid = 0;
+    for( int y = 0; y < outHeight; ++y ) {
+      for( int x = 0; x < outWidth; ++x ) {
+        double ix, iy;
+        referenceCoordinate( m, x, y, ix, iy );
+
+        const float mx = mapX[y*outWidth + x], my = mapY[y*outWidth + x];
+        if( mx < 0 ) {
+          // Only pixels at (or within rounding of) the border may disagree
+          ASSERT_TRUE( ix < 0.01 || iy < 0.01 || ix > inWidth-1.01 || iy > inHeight-1.01 )
+              << x << "," << y << " " << remap::kernelLevelName( static_cast<remap::KernelLevel>(level) );
+          continue;
+        }
+
+        ++numValid;
+
+        // Coordinates landing exactly on the border are nudged inwards by 0.01
+        const double tolX = (ix < 0.02 || ix > inWidth-1.02) ? 0.011 : 1e-3;
+        const double tolY = (iy < 0.02 || iy > inHeight-1.02) ? 0.011 : 1e-3;
+        ASSERT_NEAR( mx, ix, tolX ) << x << "," << y;
+        ASSERT_NEAR( my, iy, tolY ) << x << "," << y;
+        ASSERT_TRUE( mx > 0 && my > 0 && mx < inWidth-1 && my < inHeight-1 );
+      }
+    }
+
+    ASSERT_GT( numValid, outWidth*outHeight / 2 );
+  }
+}
+
+TEST( ATANModel, NoDistortion ) {
+  remap::ATANModel m;
+  m.fx = m.ofx = 300;  m.fy = m.ofy = 300;
+  m.cx = m.ocx = 160;  m.cy = m.ocy = 120;
+  m.dist = 0;
+
+  std::vector<float> mapX( 320*240 ), mapY( 320*240 );
+  remap::buildATANMap( m, 320, 240, 320, 240, mapX.data(), mapY.data() );
+
+  ASSERT_NEAR( mapX[100*320 + 50], 50, 1e-4 );
+  ASSERT_NEAR( mapY[100*320 + 50], 100, 1e-4 );
+
+  // Nudged inside the image rather than rejected
+  ASSERT_EQ( mapX[239*320 + 319], 319 - 0.01f );
+  ASSERT_EQ( mapY[239*320 + 319], 239 - 0.01f );
+}
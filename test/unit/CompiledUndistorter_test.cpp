@@ -0,0 +1,71 @@
+
+#include <iostream>
+
+#include <gtest/gtest.h>
+
+#include "test_files.h"
+
+#include "libvideoio/Undistorter.h"
+
+using namespace libvideoio;
+
+using namespace std;
+
+namespace {
+
+  // Smooth test pattern;  resampling a smooth image once or three times
+  // should give nearly the same result
+  cv::Mat smoothImage( const ImageSize &sz )
+  {
+    cv::Mat image( sz(), CV_8UC1 );
+    for( int y = 0; y < image.rows; ++y ) {
+      for( int x = 0; x < image.cols; ++x ) {
+        image.at<uint8_t>(y,x) = 128 + 100 * sin( x / 40.0 ) * cos( y / 30.0 );
+      }
+    }
+    return image;
+  }
+
+}
+
+TEST(CompiledUndistorter, RemapCropResizeChain) {
+
+  std::shared_ptr<Undistorter> remap( ROSUndistorterFactory::loadFromFile( ROS_YAML ) );
+  ASSERT_TRUE( (bool)remap );
+
+  std::shared_ptr<Undistorter> crop( new ImageCropper( 1600, 1200, 200, 150, remap ) );
+  std::shared_ptr<Undistorter> chain( new ImageResizer( 800, 600, crop ) );
+
+  std::shared_ptr<CompiledUndistorter> compiled( CompiledUndistorter::compile( chain ) );
+  ASSERT_TRUE( (bool)compiled );
+
+  ASSERT_EQ( compiled->getOutputWidth(), 800 );
+  ASSERT_EQ( compiled->getOutputHeight(), 600 );
+  ASSERT_EQ( compiled->inputImageSize().width, remap->inputImageSize().width );
+
+  cv::Mat image( smoothImage( remap->inputImageSize() ) );
+
+  cv::Mat staged, fused;
+  chain->undistort( image, staged );
+  compiled->undistort( image, fused );
+
+  ASSERT_EQ( staged.size(), fused.size() );
+
+  // Ignore the outermost pixels, where the staged chain sees the remap's
+  // zero border through the resize filter
+  const cv::Rect inner( 2, 2, fused.cols-4, fused.rows-4 );
+  cv::Mat diff;
+  cv::absdiff( staged(inner), fused(inner), diff );
+
+  EXPECT_LT( cv::mean(diff)[0], 0.5 );
+  EXPECT_LE( cv::norm( diff, cv::NORM_INF ), 3 );
+}
+
+TEST(CompiledUndistorter, UnsupportedChain) {
+
+  // An unwrapped resizer doesn't know its input size
+  std::shared_ptr<Undistorter> resizer( new ImageResizer( 320, 240 ) );
+  std::shared_ptr<CompiledUndistorter> compiled( CompiledUndistorter::compile( resizer ) );
+
+  ASSERT_FALSE( (bool)compiled );
+}
@@ -0,0 +1,76 @@
+
+#include <gtest/gtest.h>
+
+#include "libvideoio/FramePool.h"
+
+using namespace libvideoio;
+
+TEST( FramePool, ReusesReleasedBuffers ) {
+  FramePool pool;
+
+  const unsigned char *data;
+  {
+    cv::Mat a( pool.acquire( cv::Size( 64, 48 ), CV_8UC3 ) );
+    data = a.data;
+  }
+
+  // Steady state:  the same buffer every frame
+  for( int frame = 0; frame < 10; ++frame ) {
+    cv::Mat a( pool.acquire( cv::Size( 64, 48 ), CV_8UC3 ) );
+    ASSERT_EQ( a.data, data );
+  }
+
+  ASSERT_EQ( pool.allocations(), 1u );
+  ASSERT_EQ( pool.size(), 1u );
+}
+
+TEST( FramePool, NeverSharesBuffersInUse ) {
+  FramePool pool;
+
+  cv::Mat a( pool.acquire( cv::Size( 64, 48 ), CV_8UC1 ) );
+  cv::Mat b( pool.acquire( cv::Size( 64, 48 ), CV_8UC1 ) );
+  ASSERT_NE( a.data, b.data );
+
+  // A copy keeps the buffer in use
+  const unsigned char *data = a.data;
+  cv::Mat held( a );
+  a.release();
+  cv::Mat c( pool.acquire( cv::Size( 64, 48 ), CV_8UC1 ) );
+  ASSERT_NE( c.data, data );
+  ASSERT_NE( c.data, b.data );
+
+  // Size and type are both part of the key
+  held.release();
+  cv::Mat d( pool.acquire( cv::Size( 48, 64 ), CV_8UC1 ) );
+  cv::Mat e( pool.acquire( cv::Size( 64, 48 ), CV_16UC1 ) );
+  ASSERT_NE( d.data, data );
+  ASSERT_NE( e.data, data );
+
+  ASSERT_EQ( pool.allocations(), 5u );
+}
+
+TEST( FramePool, BoundedSize ) {
+  FramePool pool( 2 );
+
+  {
+    cv::Mat a( pool.acquire( cv::Size( 8, 8 ), CV_8UC1 ) );
+    cv::Mat b( pool.acquire( cv::Size( 16, 16 ), CV_8UC1 ) );
+
+    // Full and nothing free:  allocated outside the pool
+    cv::Mat c( pool.acquire( cv::Size( 32, 32 ), CV_8UC1 ) );
+    ASSERT_EQ( pool.size(), 2u );
+  }
+
+  // A free buffer of another size is replaced
+  cv::Mat d( pool.acquire( cv::Size( 32, 32 ), CV_8UC1 ) );
+  ASSERT_EQ( pool.size(), 2u );
+  d.release();
+
+  const size_t allocations = pool.allocations();
+  cv::Mat e( pool.acquire( cv::Size( 32, 32 ), CV_8UC1 ) );
+  ASSERT_EQ( pool.allocations(), allocations );
+
+  pool.clear();
+  ASSERT_EQ( pool.size(), 0u );
+  ASSERT_EQ( pool.allocations(), 0u );
+}
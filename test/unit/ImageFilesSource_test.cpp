@@ -0,0 +1,62 @@
+#include <gtest/gtest.h>
+
+#include "libvideoio/ImageSource.h"
+
+#include "test_helpers.h"
+
+using namespace libvideoio;
+using namespace libvideoio::test;
+
+static void expectFrames( ImageFilesSource &source, int numFrames )
+{
+  for( int n = 0; n < numFrames; ++n ) {
+    ASSERT_TRUE( source.grab() );
+
+    cv::Mat image;
+    ASSERT_EQ( source.getRawImage( 0, image ), n );
+    ASSERT_EQ( image.size(), cv::Size( 32, 24 ) );
+    EXPECT_EQ( cv::countNonZero( image != n ), 0 ) << "frame " << n;
+  }
+
+  ASSERT_FALSE( source.grab() );
+}
+
+TEST( ImageFilesSource, DecodeAheadKeepsPathOrder ) {
+  NumberedFiles files( 40 );
+
+  for( int ahead : { 0, 1, 3, 8, 100 } ) {
+    ImageFilesSource source( files.paths );
+    source.setDecodeAhead( ahead );
+    expectFrames( source, 40 );
+  }
+}
+
+TEST( ImageFilesSource, DecodeAheadRepeatsAndSkips ) {
+  NumberedFiles files( 10 );
+
+  ImageFilesSource source( files.paths );
+  source.setDecodeAhead( 4 );
+
+  // Reading the same frame twice, after modifying the first read in
+  // place, and grabbing without reading
+  for( int n = 0; n < 10; ++n ) {
+    ASSERT_TRUE( source.grab() );
+    if( n % 3 == 2 ) continue;
+
+    cv::Mat a, b;
+    ASSERT_EQ( source.getRawImage( 0, a ), n );
+    EXPECT_EQ( cv::countNonZero( a != n ), 0 );
+    a.setTo( 255 );
+    ASSERT_EQ( source.getRawImage( 0, b ), n );
+    EXPECT_EQ( cv::countNonZero( b != n ), 0 );
+  }
+
+  // Switching modes mid-stream
+  ImageFilesSource switched( files.paths );
+  ASSERT_TRUE( switched.grab() );
+  switched.setDecodeAhead( 5 );
+
+  cv::Mat image;
+  ASSERT_EQ( switched.getRawImage( 0, image ), 0 );
+  EXPECT_EQ( cv::countNonZero( image != 0 ), 0 );
+}
@@ -0,0 +1,79 @@
+#include <iostream>
+
+#include <gtest/gtest.h>
+
+#include "test_files.h"
+#include "test_helpers.h"
+
+#include "libvideoio/MapCache.h"
+#include "libvideoio/Undistorter.h"
+
+using namespace libvideoio;
+using namespace libvideoio::test;
+
+using namespace std;
+
+TEST(MapCache, StoreAndLoad) {
+  ScopedCacheDir dir;
+
+  cv::Mat a( 37, 53, CV_16SC2 ), b( 37, 53, CV_16UC1 );
+  cv::randu( a, cv::Scalar::all(-1000), cv::Scalar::all(1000) );
+  cv::randu( b, cv::Scalar::all(0), cv::Scalar::all(1024) );
+
+  MapCache::Key key( "test" );
+  key.add( 1.0f ).add( 42 );
+
+  ASSERT_FALSE( (bool)MapCache::load( key, 2 ) );
+  ASSERT_TRUE( MapCache::store( key, { a, b } ) );
+
+  std::shared_ptr<const MapCache::Maps> maps( MapCache::load( key, 2 ) );
+  ASSERT_TRUE( (bool)maps );
+  ASSERT_EQ( maps->size(), 2u );
+
+  ASSERT_EQ( (*maps)[0].type(), a.type() );
+  ASSERT_EQ( (*maps)[0].size(), a.size() );
+  ASSERT_EQ( cv::norm( (*maps)[0], a, cv::NORM_INF ), 0 );
+  ASSERT_EQ( cv::norm( (*maps)[1], b, cv::NORM_INF ), 0 );
+
+  // Any change to the key is a miss
+  MapCache::Key other( "test" );
+  other.add( 1.0001f ).add( 42 );
+  ASSERT_NE( key.hash(), other.hash() );
+  ASSERT_FALSE( (bool)MapCache::load( other, 2 ) );
+
+  // ... as is a different number of maps
+  ASSERT_FALSE( (bool)MapCache::load( key, 3 ) );
+}
+
+TEST(MapCache, TruncatedEntryIsAMiss) {
+  ScopedCacheDir dir;
+
+  cv::Mat a( 20, 20, CV_32FC1, cv::Scalar(3.0f) );
+  MapCache::Key key( "test" );
+  ASSERT_TRUE( MapCache::store( key, { a } ) );
+
+  const fs::path file( dir.path / key.filename() );
+  fs::resize_file( file, fs::file_size(file) - 16 );
+
+  ASSERT_FALSE( (bool)MapCache::load( key, 1 ) );
+}
+
+TEST(MapCache, OpenCVUndistorterUsesCache) {
+  ScopedCacheDir dir;
+
+  std::shared_ptr<OpenCVUndistorter> first( ROSUndistorterFactory::loadFromFile( ROS_YAML ) );
+  ASSERT_TRUE( (bool)first );
+  ASSERT_FALSE( fs::is_empty( dir.path ) );
+
+  std::shared_ptr<OpenCVUndistorter> second( ROSUndistorterFactory::loadFromFile( ROS_YAML ) );
+  ASSERT_TRUE( (bool)second );
+
+  cv::Mat image( first->inputImageSize()(), CV_8UC1 );
+  cv::randu( image, cv::Scalar::all(0), cv::Scalar::all(255) );
+
+  cv::Mat computed, cached;
+  first->undistort( image, computed );
+  second->undistort( image, cached );
+
+  ASSERT_EQ( cv::norm( computed, cached, cv::NORM_INF ), 0 );
+}
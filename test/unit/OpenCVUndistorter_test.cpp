@@ -0,0 +1,541 @@
+
+#include <iostream>
+#include <random>
+
+#include <gtest/gtest.h>
+
+#include "test_files.h"
+
+#include "libvideoio/Undistorter.h"
+
+using namespace libvideoio;
+
+using namespace std;
+
+TEST(OpenCVUndistorter, ParallelMatchesSerial) {
+
+  std::shared_ptr<OpenCVUndistorter> undistorter( ROSUndistorterFactory::loadFromFile( ROS_YAML ) );
+  ASSERT_TRUE( (bool)undistorter );
+
+  cv::Mat image( undistorter->inputImageSize()(), CV_8UC3 );
+  cv::randu( image, cv::Scalar::all(0), cv::Scalar::all(255) );
+
+  cv::Mat serial, parallel;
+
+  undistorter->setNumThreads( 1 );
+  undistorter->undistort( image, serial );
+
+  undistorter->setNumThreads( 7 );
+  undistorter->undistort( image, parallel );
+
+  ASSERT_EQ( serial.size(), parallel.size() );
+  ASSERT_EQ( cv::norm( serial, parallel, cv::NORM_INF ), 0 );
+}
+
+TEST(OpenCVUndistorter, InPlace) {
+
+  std::shared_ptr<Undistorter> undistorter( ROSUndistorterFactory::loadFromFile( ROS_YAML ) );
+  ASSERT_TRUE( (bool)undistorter );
+
+  std::shared_ptr<Undistorter> compiled( CompiledUndistorter::compile( undistorter ) );
+  ASSERT_TRUE( (bool)compiled );
+
+  std::shared_ptr<Undistorter> legacy( new PTAMUndistorter( PTAM_LEGACY ) );
+
+  // With several bands, later bands must not read rows earlier ones wrote
+  for( auto u : { undistorter, compiled, legacy } ) {
+    u->setNumThreads( 7 );
+
+    cv::Mat image( u->inputImageSize()(), CV_8UC3 );
+    cv::randu( image, cv::Scalar::all(0), cv::Scalar::all(255) );
+
+    cv::Mat expected;
+    u->undistort( image, expected );
+
+    cv::Mat inPlace( image.clone() );
+    u->undistort( inPlace, inPlace );
+
+    ASSERT_EQ( inPlace.size(), expected.size() ) << u->name();
+    ASSERT_EQ( cv::norm( inPlace, expected, cv::NORM_INF ), 0 ) << u->name();
+  }
+}
+
+namespace {
+
+  // Restores the default policy when a test ends
+  struct ScopedMapBuildPolicy {
+    ScopedMapBuildPolicy( Undistorter::MapBuildPolicy policy )
+      : previous( Undistorter::defaultMapBuildPolicy() )
+      { Undistorter::setDefaultMapBuildPolicy( policy ); }
+
+    ~ScopedMapBuildPolicy()
+      { Undistorter::setDefaultMapBuildPolicy( previous ); }
+
+    Undistorter::MapBuildPolicy previous;
+  };
+
+}
+
+TEST(OpenCVUndistorter, DeferredMapsMatchEager) {
+
+  std::shared_ptr<OpenCVUndistorter> eager( ROSUndistorterFactory::loadFromFile( ROS_YAML ) );
+  ASSERT_TRUE( eager->isReady() );
+
+  std::shared_ptr<OpenCVUndistorter> background, onFirstUse;
+  {
+    ScopedMapBuildPolicy policy( Undistorter::BuildMapsInBackground );
+    background.reset( ROSUndistorterFactory::loadFromFile( ROS_YAML ) );
+  }
+  {
+    ScopedMapBuildPolicy policy( Undistorter::BuildMapsOnFirstUse );
+    onFirstUse.reset( ROSUndistorterFactory::loadFromFile( ROS_YAML ) );
+  }
+
+  ASSERT_FALSE( onFirstUse->isReady() );
+
+  cv::Mat image( eager->inputImageSize()(), CV_8UC1 );
+  cv::randu( image, cv::Scalar::all(0), cv::Scalar::all(255) );
+
+  cv::Mat expected, out;
+  eager->undistort( image, expected );
+
+  // undistort() waits for (or performs) the build
+  background->undistort( image, out );
+  ASSERT_TRUE( background->isReady() );
+  ASSERT_EQ( cv::norm( expected, out, cv::NORM_INF ), 0 );
+
+  onFirstUse->prepare();
+  ASSERT_TRUE( onFirstUse->isReady() );
+  onFirstUse->undistort( image, out );
+  ASSERT_EQ( cv::norm( expected, out, cv::NORM_INF ), 0 );
+}
+
+TEST(OpenCVUndistorter, DestroyBeforeBackgroundBuild) {
+  ScopedMapBuildPolicy policy( Undistorter::BuildMapsInBackground );
+
+  // Destroying undistorters whose builds are queued or running must
+  // neither crash nor block indefinitely
+  for( int i = 0; i < 16; ++i ) {
+    std::unique_ptr<OpenCVUndistorter> undistorter( ROSUndistorterFactory::loadFromFile( ROS_YAML ) );
+    ASSERT_TRUE( (bool)undistorter );
+  }
+}
+
+TEST(OpenCVUndistorter, BatchMatchesSingle) {
+
+  std::shared_ptr<Undistorter> inner( ROSUndistorterFactory::loadFromFile( ROS_YAML ) );
+  ASSERT_TRUE( (bool)inner );
+
+  // A chain exercises the per-thread intermediate buffers
+  const ImageSize in( inner->inputImageSize() );
+  std::shared_ptr<Undistorter> chain( new ImageResizer( in.width/2, in.height/2, inner ) );
+
+  for( auto undistorter : { inner, chain } ) {
+    std::vector<cv::Mat> images( 9 );
+    for( auto &image : images ) {
+      image.create( in(), CV_8UC3 );
+      cv::randu( image, cv::Scalar::all(0), cv::Scalar::all(255) );
+    }
+
+    std::vector<cv::Mat> batch;
+    undistorter->undistortBatch( images, batch );
+    ASSERT_EQ( batch.size(), images.size() );
+
+    // Band-parallel path for a pair of large frames
+    std::vector<cv::Mat> pair;
+    undistorter->undistortBatch( std::vector<cv::Mat>( images.begin(), images.begin()+2 ), pair );
+
+    for( size_t i = 0; i < images.size(); ++i ) {
+      cv::Mat single;
+      undistorter->undistort( images[i], single );
+
+      ASSERT_EQ( single.size(), batch[i].size() );
+      ASSERT_EQ( cv::norm( single, batch[i], cv::NORM_INF ), 0 ) << i;
+      if( i < 2 ) ASSERT_EQ( cv::norm( single, pair[i], cv::NORM_INF ), 0 ) << i;
+    }
+  }
+}
+
+TEST(OpenCVUndistorter, SparsePoints) {
+
+  std::shared_ptr<OpenCVUndistorter> undistorter( ROSUndistorterFactory::loadFromFile( ROS_YAML ) );
+  const ImageSize in( undistorter->inputImageSize() ), out( undistorter->outputImageSize() );
+
+  std::mt19937 rng(1234);
+  std::uniform_real_distribution<float> xs( 0, in.width-1 ), ys( 0, in.height-1 );
+
+  std::vector<cv::Point2f> distorted( 500 );
+  for( auto &p : distorted ) p = cv::Point2f( xs(rng), ys(rng) );
+
+  std::vector<cv::Point2f> fast;
+  ASSERT_TRUE( undistorter->undistortPoints( distorted, fast ) );
+  ASSERT_EQ( fast.size(), distorted.size() );
+
+  // The ROS camera has a rectification rotation, so compare against the
+  // round trip through distortPoints rather than the unrectified points
+  std::vector<cv::Point2f> roundTrip;
+  ASSERT_TRUE( undistorter->distortPoints( fast, roundTrip ) );
+
+  int numChecked = 0;
+  for( size_t k = 0; k < distorted.size(); ++k ) {
+    if( fast[k].x == Undistorter::InvalidCoordinate ) continue;
+
+    // Points outside the output are marked invalid rather than returned
+    ASSERT_GE( fast[k].x, 0 ) << k;
+    ASSERT_GE( fast[k].y, 0 ) << k;
+    ASSERT_LE( fast[k].x, out.width-1 ) << k;
+    ASSERT_LE( fast[k].y, out.height-1 ) << k;
+
+    ++numChecked;
+    ASSERT_NEAR( roundTrip[k].x, distorted[k].x, 0.05 ) << k;
+    ASSERT_NEAR( roundTrip[k].y, distorted[k].y, 0.05 ) << k;
+  }
+  ASSERT_GT( numChecked, 100 );
+
+  // distortPoints agrees with the dense maps
+  cv::Mat mapX, mapY;
+  ASSERT_TRUE( undistorter->getSourceMap( mapX, mapY ) );
+
+  std::vector<cv::Point2f> pixels, sources;
+  for( int y = 3; y < out.height; y += 97 ) {
+    for( int x = 5; x < out.width; x += 89 ) pixels.push_back( cv::Point2f( x, y ) );
+  }
+  ASSERT_TRUE( undistorter->distortPoints( pixels, sources ) );
+
+  for( size_t k = 0; k < pixels.size(); ++k ) {
+    const int x = pixels[k].x, y = pixels[k].y;
+    ASSERT_NEAR( sources[k].x, mapX.at<float>(y,x), 0.05 );
+    ASSERT_NEAR( sources[k].y, mapY.at<float>(y,x), 0.05 );
+  }
+}
+
+TEST(OpenCVUndistorter, RegionOfInterest) {
+
+  std::shared_ptr<Undistorter> inner( ROSUndistorterFactory::loadFromFile( ROS_YAML ) );
+  ASSERT_TRUE( (bool)inner );
+
+  // Chains exercise the window propagated through wrapped stages
+  const ImageSize in( inner->inputImageSize() );
+  std::shared_ptr<Undistorter> cropped( new ImageCropper( in.width/2, in.height/2, in.width/4, in.height/4, inner ) );
+  std::shared_ptr<Undistorter> twice( ROSUndistorterFactory::loadFromFile( ROS_YAML, inner ) );
+  std::shared_ptr<Undistorter> legacy( new PTAMUndistorter( PTAM_LEGACY ) );
+
+  for( auto undistorter : { inner, cropped, twice, legacy } ) {
+    cv::Mat image( undistorter->inputImageSize()(), CV_8UC3 );
+    cv::randu( image, cv::Scalar::all(0), cv::Scalar::all(255) );
+
+    cv::Mat full;
+    undistorter->undistort( image, full );
+
+    const cv::Rect roi( full.cols/3, full.rows/4, std::min( 256, full.cols/2 ), std::min( 256, full.rows/2 ) );
+
+    cv::Mat window;
+    undistorter->undistort( image, window, roi );
+
+    ASSERT_EQ( window.size(), roi.size() );
+    ASSERT_EQ( cv::norm( window, full(roi), cv::NORM_INF ), 0 ) << undistorter->name();
+
+    // The window's offset into the wrapped output must not be applied to
+    // the shared maps, or each call would shift the next one further
+    for( auto mode : { Undistorter::InterpolateLinear, Undistorter::InterpolateNearest } ) {
+      undistorter->setInterpolation( mode );
+
+      cv::Mat first, second, fullAfter;
+      undistorter->undistort( image, first, roi );
+      undistorter->undistort( image, second, roi );
+      undistorter->undistort( image, fullAfter );
+
+      ASSERT_EQ( cv::norm( first, second, cv::NORM_INF ), 0 ) << undistorter->name() << " mode " << mode;
+      ASSERT_EQ( cv::norm( first, fullAfter(roi), cv::NORM_INF ), 0 ) << undistorter->name() << " mode " << mode;
+    }
+  }
+}
+
+TEST(OpenCVUndistorter, Pyramid) {
+
+  std::shared_ptr<Undistorter> inner( ROSUndistorterFactory::loadFromFile( ROS_YAML ) );
+  ASSERT_TRUE( (bool)inner );
+
+  // The chain's levels come from its resampled source map rather than
+  // the calibration
+  const ImageSize in( inner->inputImageSize() );
+  std::shared_ptr<Undistorter> chain( new ImageResizer( in.width/2, in.height/2, inner ) );
+
+  // Bilinear sampling is exact on a linear ramp, so every level should
+  // match level 0 resized, up to rounding
+  cv::Mat image( in(), CV_8UC1 );
+  for( int y = 0; y < image.rows; ++y ) {
+    for( int x = 0; x < image.cols; ++x ) {
+      image.at<uchar>(y,x) = (x * 127) / image.cols + (y * 127) / image.rows;
+    }
+  }
+
+  for( auto undistorter : { inner, chain } ) {
+    std::vector<cv::Mat> levels;
+    undistorter->undistortPyramid( image, levels, 4 );
+    ASSERT_EQ( levels.size(), 4u );
+
+    cv::Mat level0;
+    undistorter->undistort( image, level0 );
+    ASSERT_EQ( cv::norm( level0, levels[0], cv::NORM_INF ), 0 );
+
+    for( int l = 1; l < 4; ++l ) {
+      const cv::Size expected( (levels[l-1].cols + 1) / 2, (levels[l-1].rows + 1) / 2 );
+      ASSERT_EQ( levels[l].size(), expected ) << l;
+
+      cv::Mat resized;
+      cv::resize( levels[0], resized, expected, 0, 0, cv::INTER_LINEAR );
+
+      // Compare away from the image border, where zero fill is blended in
+      const cv::Rect centre( expected.width/4, expected.height/4, expected.width/2, expected.height/2 );
+      EXPECT_LE( cv::norm( levels[l](centre), resized(centre), cv::NORM_INF ), 2 ) << undistorter->name() << " level " << l;
+    }
+  }
+}
+
+TEST(OpenCVUndistorter, PyramidDoesNotAlias) {
+
+  std::shared_ptr<Undistorter> inner( ROSUndistorterFactory::loadFromFile( ROS_YAML ) );
+  ASSERT_TRUE( (bool)inner );
+
+  const ImageSize in( inner->inputImageSize() );
+  std::shared_ptr<Undistorter> chain( new ImageResizer( in.width/2, in.height/2, inner ) );
+
+  // A one-pixel checkerboard is all detail at the Nyquist frequency.
+  // Every reduced level should be flat grey;  point sampling would give
+  // anything from black to white.
+  cv::Mat image( in(), CV_8UC1 );
+  for( int y = 0; y < image.rows; ++y ) {
+    for( int x = 0; x < image.cols; ++x ) image.at<uchar>(y,x) = ((x + y) & 1) ? 255 : 0;
+  }
+
+  for( auto undistorter : { inner, chain } ) {
+    std::vector<cv::Mat> levels;
+    undistorter->undistortPyramid( image, levels, 4 );
+
+    for( int l = 1; l < 4; ++l ) {
+      const cv::Size size( levels[l].size() );
+      const cv::Rect centre( size.width/4, size.height/4, size.width/2, size.height/2 );
+
+      double lo, hi;
+      cv::minMaxLoc( levels[l](centre), &lo, &hi );
+      EXPECT_GE( lo, 126 ) << undistorter->name() << " level " << l;
+      EXPECT_LE( hi, 129 ) << undistorter->name() << " level " << l;
+    }
+  }
+}
+
+TEST(OpenCVUndistorter, PyramidFollowsInterpolation) {
+
+  std::shared_ptr<Undistorter> undistorter( ROSUndistorterFactory::loadFromFile( ROS_YAML ) );
+  ASSERT_TRUE( (bool)undistorter );
+
+  cv::Mat image( undistorter->inputImageSize()(), CV_8UC1 );
+  cv::randu( image, cv::Scalar::all(0), cv::Scalar::all(256) );
+
+  const Undistorter::Interpolation modes[] = { Undistorter::InterpolateLinear, Undistorter::InterpolateNearest,
+                                               Undistorter::InterpolateLinearExact, Undistorter::InterpolateCubic };
+  std::vector< std::vector<cv::Mat> > pyramids;
+  for( auto mode : modes ) {
+    undistorter->setInterpolation( mode );
+    pyramids.push_back( std::vector<cv::Mat>() );
+    undistorter->undistortPyramid( image, pyramids.back(), 3 );
+  }
+
+  // Nearest and cubic resample differently;  exact bilinear differs from
+  // the fixed-point maps only by their coarser coordinates
+  for( int l = 1; l < 3; ++l ) {
+    const cv::Mat &linear( pyramids[0][l] );
+    EXPECT_GT( cv::norm( pyramids[1][l], linear, cv::NORM_INF ), 0 ) << "level " << l;
+    EXPECT_GT( cv::norm( pyramids[3][l], linear, cv::NORM_INF ), 0 ) << "level " << l;
+
+    cv::Mat diff;
+    cv::absdiff( pyramids[2][l], linear, diff );
+    EXPECT_LT( cv::mean( diff )[0], 1.0 ) << "level " << l;
+  }
+}
+
+TEST(OpenCVUndistorter, DepthSharesColourMaps) {
+
+  std::shared_ptr<Undistorter> opencv( ROSUndistorterFactory::loadFromFile( ROS_YAML ) );
+  ASSERT_TRUE( (bool)opencv );
+  std::shared_ptr<Undistorter> legacy( new PTAMUndistorter( PTAM_LEGACY ) );
+
+  for( auto undistorter : { opencv, legacy } ) {
+    const cv::Size size( undistorter->inputImageSize()() );
+
+    // Blocks of two depths, with holes
+    cv::Mat depth( size, CV_16UC1 );
+    for( int y = 0; y < size.height; ++y ) {
+      for( int x = 0; x < size.width; ++x ) {
+        depth.at<uint16_t>(y,x) = ((x / 16 + y / 16) % 5 == 0) ? 0 : (((x / 32) % 2) ? 3000 : 1000);
+      }
+    }
+
+    cv::Mat image( size, CV_8UC3 );
+    cv::randu( image, cv::Scalar::all(0), cv::Scalar::all(255) );
+
+    for( auto sampling : { Undistorter::DepthNearest, Undistorter::DepthMinimum } ) {
+      undistorter->setDepthSampling( sampling );
+
+      cv::Mat out;
+      undistorter->undistortDepth( depth, out );
+      ASSERT_EQ( out.size(), undistorter->outputImageSize()() );
+      ASSERT_EQ( out.type(), CV_16UC1 );
+
+      // Depths are selected, never blended
+      for( int y = 0; y < out.rows; ++y ) {
+        for( int x = 0; x < out.cols; ++x ) {
+          const uint16_t d = out.at<uint16_t>(y,x);
+          ASSERT_TRUE( d == 0 || d == 1000 || d == 3000 ) << x << "," << y;
+        }
+      }
+
+      // The combined call matches the separate ones
+      cv::Mat colour, rgb, rgbDepth;
+      undistorter->undistort( image, colour );
+      undistorter->undistortRGBD( image, depth, rgb, rgbDepth );
+
+      ASSERT_EQ( cv::norm( colour, rgb, cv::NORM_INF ), 0 );
+      ASSERT_EQ( cv::norm( out, rgbDepth, cv::NORM_INF ), 0 );
+    }
+  }
+}
+
+TEST(OpenCVUndistorter, UnsupportedDepthTypesSampleNearest) {
+
+  std::shared_ptr<Undistorter> undistorter( ROSUndistorterFactory::loadFromFile( ROS_YAML ) );
+  ASSERT_TRUE( (bool)undistorter );
+  const cv::Size size( undistorter->inputImageSize()() );
+
+  cv::Mat depth( size, CV_16UC1 );
+  for( int y = 0; y < size.height; ++y ) {
+    for( int x = 0; x < size.width; ++x ) depth.at<uint16_t>(y,x) = ((x / 32) % 2) ? 30 : 10;
+  }
+
+  cv::Mat expected;
+  undistorter->undistortDepth( depth, expected );
+
+  for( int type : { CV_8UC1, CV_32SC1, CV_16UC2 } ) {
+    cv::Mat converted, out;
+    depth.convertTo( converted, CV_MAT_DEPTH( type ) );
+    if( CV_MAT_CN( type ) == 2 ) cv::merge( std::vector<cv::Mat>( 2, converted ), converted );
+
+    undistorter->undistortDepth( converted, out );
+    ASSERT_EQ( out.type(), type );
+    ASSERT_EQ( out.size(), expected.size() );
+
+    // Depths are selected, never blended, and almost always the same
+    // ones as the kernel (which may round ties the other way)
+    std::vector<cv::Mat> channels;
+    cv::split( out, channels );
+    for( cv::Mat &c : channels ) {
+      c.convertTo( c, CV_16U );
+
+      int differ = 0;
+      for( int y = 0; y < c.rows; ++y ) {
+        for( int x = 0; x < c.cols; ++x ) {
+          const uint16_t d = c.at<uint16_t>(y,x);
+          ASSERT_TRUE( d == 0 || d == 10 || d == 30 ) << x << "," << y;
+          if( d != expected.at<uint16_t>(y,x) ) ++differ;
+        }
+      }
+      EXPECT_LT( differ, (int)c.total() / 100 ) << "type " << type;
+    }
+  }
+}
+
+TEST(OpenCVUndistorter, FusedConversion) {
+
+  std::shared_ptr<Undistorter> opencv( ROSUndistorterFactory::loadFromFile( ROS_YAML ) );
+  ASSERT_TRUE( (bool)opencv );
+  std::shared_ptr<Undistorter> compiled( CompiledUndistorter::compile( opencv ) );
+  ASSERT_TRUE( (bool)compiled );
+  std::shared_ptr<Undistorter> legacy( new PTAMUndistorter( PTAM_LEGACY ) );
+
+  for( auto undistorter : { opencv, compiled, legacy } ) {
+    cv::Mat image( undistorter->inputImageSize()(), CV_8UC3 );
+    cv::randu( image, cv::Scalar::all(0), cv::Scalar::all(255) );
+
+    // Against the three separate passes, which round to 8 bits after the
+    // colour conversion
+    cv::Mat gray, grayF, expected, fused;
+    cv::cvtColor( image, gray, cv::COLOR_BGR2GRAY );
+    gray.convertTo( grayF, CV_32F, 1.0/255 );
+    undistorter->undistort( grayF, expected );
+
+    undistorter->convertAndUndistort( image, fused, cv::COLOR_BGR2GRAY, CV_32F, 1.0/255 );
+    ASSERT_EQ( fused.type(), CV_32FC1 );
+    ASSERT_EQ( fused.size(), expected.size() );
+    EXPECT_LE( cv::norm( fused, expected, cv::NORM_INF ), 1.0/255 ) << undistorter->name();
+
+    // An offset applies to the image, not to the 0 border around it
+    cv::Mat expectedOffset, fusedOffset;
+    undistorter->undistort( cv::Mat( grayF + 0.5 ), expectedOffset );
+    undistorter->convertAndUndistort( image, fusedOffset, cv::COLOR_BGR2GRAY, CV_32F, 1.0/255, 0.5 );
+    EXPECT_LE( cv::norm( fusedOffset, expectedOffset, cv::NORM_INF ), 1.0/255 ) << undistorter->name();
+
+    cv::Mat expected8U, fused8U;
+    undistorter->undistort( gray, expected8U );
+    undistorter->convertAndUndistort( image, fused8U, cv::COLOR_BGR2GRAY, CV_8U );
+    ASSERT_EQ( fused8U.type(), CV_8UC1 );
+    EXPECT_LE( cv::norm( fused8U, expected8U, cv::NORM_INF ), 2 ) << undistorter->name();
+  }
+}
+
+TEST(OpenCVUndistorter, InterpolationModes) {
+
+  std::shared_ptr<Undistorter> inner( ROSUndistorterFactory::loadFromFile( ROS_YAML ) );
+  ASSERT_TRUE( (bool)inner );
+  std::shared_ptr<Undistorter> twice( ROSUndistorterFactory::loadFromFile( ROS_YAML, inner ) );
+  std::shared_ptr<Undistorter> legacy( new PTAMUndistorter( PTAM_LEGACY ) );
+
+  const Undistorter::Interpolation modes[] = { Undistorter::InterpolateNearest, Undistorter::InterpolateLinear,
+                                               Undistorter::InterpolateLinearExact, Undistorter::InterpolateCubic };
+
+  for( auto undistorter : { inner, twice, legacy } ) {
+    const cv::Size size( undistorter->inputImageSize()() );
+
+    // Two-level noise:  nearest-neighbour output only ever holds those
+    // levels, or 0 outside the input
+    cv::Mat noise( size, CV_8UC1 );
+    cv::randu( noise, cv::Scalar(0), cv::Scalar(2) );
+    noise = noise * 150 + 50;
+
+    // Smooth image, on which every mode should agree closely
+    cv::Mat smooth( size, CV_8UC1 );
+    for( int y = 0; y < size.height; ++y )
+      for( int x = 0; x < size.width; ++x )
+        smooth.at<uchar>(y,x) = cv::saturate_cast<uchar>( 128 + 100 * sin( x / 40.0 ) * cos( y / 40.0 ) );
+
+    undistorter->setInterpolation( Undistorter::InterpolateLinear );
+    cv::Mat linear;
+    undistorter->undistort( smooth, linear );
+
+    // Borders differ by mode, so only the centre is compared
+    const cv::Rect centre( linear.cols/4, linear.rows/4, linear.cols/2, linear.rows/2 );
+
+    for( auto mode : modes ) {
+      undistorter->setInterpolation( mode );
+
+      cv::Mat out;
+      undistorter->undistort( smooth, out );
+      ASSERT_EQ( out.size(), linear.size() );
+      ASSERT_EQ( out.type(), linear.type() );
+      EXPECT_LE( cv::norm( out(centre), linear(centre), cv::NORM_INF ), 3 ) << undistorter->name() << " mode " << mode;
+
+      // Regions take the same path as full frames
+      cv::Mat window;
+      undistorter->undistort( smooth, window, centre );
+      EXPECT_EQ( cv::norm( window, out(centre), cv::NORM_INF ), 0 ) << undistorter->name() << " mode " << mode;
+
+      if( mode == Undistorter::InterpolateNearest ) {
+        undistorter->undistort( noise, out );
+        const int kept = cv::countNonZero( out == 0 ) + cv::countNonZero( out == 50 ) + cv::countNonZero( out == 200 );
+        EXPECT_EQ( kept, (int)out.total() ) << undistorter->name();
+      }
+    }
+
+    undistorter->setInterpolation( Undistorter::InterpolateLinear );
+  }
+}
@@ -0,0 +1,251 @@
+
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+#include <gtest/gtest.h>
+
+#include "test_files.h"
+#include "test_helpers.h"
+
+#include "libvideoio/Undistorter.h"
+
+using namespace libvideoio;
+using namespace libvideoio::test;
+
+using namespace std;
+
+namespace {
+
+  // The test calibrations have no distortion, so undistort as PTAM_LEGACY
+  // through an ATAN lens cropped to the same size
+  std::shared_ptr<PTAMUndistorter> distortingUndistorter( const std::shared_ptr<Undistorter> &wrap = nullptr )
+  {
+    std::ifstream legacy( PTAM_LEGACY );
+    float fx, fy, cx, cy;
+    if( !(legacy >> fx >> fy >> cx >> cy) ) return nullptr;
+
+    ScratchDir scratch( "videoio-ptam" );
+    const fs::path config( scratch.path / "ptam.txt" );
+    {
+      std::ofstream out( config.string() );
+      out << fx << " " << fy << " " << cx << " " << cy << " 0.9\n"
+          << "640 480\n"
+          << "crop\n"
+          << "640 480\n";
+    }
+
+    std::shared_ptr<PTAMUndistorter> undistorter( new PTAMUndistorter( config.string().c_str(), wrap ) );
+
+    return undistorter->isValid() ? undistorter : nullptr;
+  }
+
+  // Bilinear interpolation of image as floats at the exact source
+  // coordinates, the reference for the other depths
+  cv::Mat exactReference( const cv::Mat &image )
+  {
+    std::shared_ptr<PTAMUndistorter> exact( distortingUndistorter() );
+    exact->setInterpolation( Undistorter::InterpolateLinearExact );
+
+    cv::Mat floatImage, result;
+    image.convertTo( floatImage, CV_MAKETYPE( CV_32F, image.channels() ) );
+    exact->undistort( floatImage, result );
+    return result;
+  }
+
+}
+
+TEST(PTAMUndistorter, Linear8UMatchesExactInterpolation) {
+
+  std::shared_ptr<PTAMUndistorter> undistorter( distortingUndistorter() );
+  ASSERT_TRUE( (bool)undistorter );
+
+  // The packed table's coarser coordinates are only used on request
+  const struct { Undistorter::Interpolation mode; double tolerance; } runs[] = {
+    { Undistorter::InterpolateLinear, 1.0 }, { Undistorter::InterpolateLinearFast, 2.0 } };
+
+  for( const auto &run : runs ) {
+    undistorter->setInterpolation( run.mode );
+
+    for( int channels : { 1, 3 } ) {
+      cv::Mat image( undistorter->inputImageSize()(), CV_MAKETYPE( CV_8U, channels ) );
+      cv::randu( image, cv::Scalar::all(0), cv::Scalar::all(256) );
+
+      cv::Mat result;
+      undistorter->undistort( image, result );
+      ASSERT_EQ( result.type(), image.type() );
+
+      cv::Mat resultFloat;
+      result.convertTo( resultFloat, CV_MAKETYPE( CV_32F, channels ) );
+      EXPECT_LE( cv::norm( resultFloat, exactReference( image ), cv::NORM_INF ), run.tolerance )
+          << "mode " << run.mode << ", " << channels << " channels";
+    }
+  }
+}
+
+TEST(PTAMUndistorter, Linear16UMatchesExactInterpolation) {
+
+  std::shared_ptr<PTAMUndistorter> undistorter( distortingUndistorter() );
+  ASSERT_TRUE( (bool)undistorter );
+
+  // Full-range noise has the steepest gradients, where a quantized source
+  // coordinate costs the most
+  for( int channels : { 1, 3 } ) {
+    cv::Mat image( undistorter->inputImageSize()(), CV_MAKETYPE( CV_16U, channels ) );
+    cv::randu( image, cv::Scalar::all(0), cv::Scalar::all(65536) );
+
+    cv::Mat result;
+    undistorter->undistort( image, result );
+    ASSERT_EQ( result.type(), image.type() );
+
+    cv::Mat resultFloat;
+    result.convertTo( resultFloat, CV_MAKETYPE( CV_32F, channels ) );
+    EXPECT_LE( cv::norm( resultFloat, exactReference( image ), cv::NORM_INF ), 1.0 ) << channels << " channels";
+  }
+}
+
+TEST(PTAMUndistorter, Linear32FMatchesExactInterpolation) {
+
+  std::shared_ptr<PTAMUndistorter> undistorter( distortingUndistorter() );
+  ASSERT_TRUE( (bool)undistorter );
+
+  for( int channels : { 1, 3 } ) {
+    cv::Mat image( undistorter->inputImageSize()(), CV_MAKETYPE( CV_32F, channels ) );
+    cv::randu( image, cv::Scalar::all(0), cv::Scalar::all(1) );
+
+    cv::Mat result;
+    undistorter->undistort( image, result );
+    ASSERT_EQ( result.type(), image.type() );
+
+    EXPECT_LE( cv::norm( result, exactReference( image ), cv::NORM_INF ), 1e-5 ) << channels << " channels";
+  }
+}
+
+TEST(PTAMUndistorter, UnsupportedTypesFallBackToOpenCV) {
+
+  std::shared_ptr<PTAMUndistorter> undistorter( distortingUndistorter() );
+  ASSERT_TRUE( (bool)undistorter );
+  undistorter->setNumThreads( 3 );
+
+  // Smooth ramps, so cv::remap's coarser coordinates barely matter
+  const cv::Size size( undistorter->inputImageSize()() );
+  cv::Mat ramp( size, CV_32F );
+  for( int y = 0; y < ramp.rows; ++y )
+    for( int x = 0; x < ramp.cols; ++x ) ramp.at<float>(y,x) = x + y;
+
+  const cv::Mat reference( exactReference( ramp ) );
+  const cv::Rect roi( 100, 50, 200, 150 );
+
+  for( int type : { CV_16SC1, CV_64FC1, CV_32SC1 } ) {
+    cv::Mat image;
+    ramp.convertTo( image, type );
+
+    cv::Mat result, roiResult;
+    undistorter->undistort( image, result );
+    undistorter->undistort( image, roiResult, roi );
+    ASSERT_EQ( result.type(), type );
+    ASSERT_EQ( result.size(), reference.size() );
+
+    // 32S is sampled nearest, up to half a pixel from the exact coordinate
+    cv::Mat resultFloat;
+    result.convertTo( resultFloat, CV_32F );
+    EXPECT_LE( cv::norm( resultFloat, reference, cv::NORM_INF ), type == CV_32SC1 ? 2.0 : 1.0 ) << "type " << type;
+    EXPECT_EQ( cv::norm( roiResult, result(roi), cv::NORM_INF ), 0 ) << "type " << type;
+  }
+
+  // Two channels have no kernel either
+  cv::Mat pair( size, CV_8UC2, cv::Scalar( 10, 200 ) ), pairResult;
+  undistorter->undistort( pair, pairResult );
+  ASSERT_EQ( pairResult.type(), CV_8UC2 );
+  ASSERT_EQ( pairResult.size(), reference.size() );
+}
+
+TEST(PTAMUndistorter, UnsupportedDepthTypesSampleNearest) {
+
+  std::shared_ptr<PTAMUndistorter> undistorter( distortingUndistorter() );
+  ASSERT_TRUE( (bool)undistorter );
+  const cv::Size size( undistorter->inputImageSize()() );
+
+  cv::Mat depth( size, CV_16UC1 );
+  for( int y = 0; y < size.height; ++y ) {
+    for( int x = 0; x < size.width; ++x ) depth.at<uint16_t>(y,x) = ((x / 32) % 2) ? 30 : 10;
+  }
+
+  cv::Mat image( size, CV_8UC3 );
+  cv::randu( image, cv::Scalar::all(0), cv::Scalar::all(255) );
+
+  cv::Mat expectedColour;
+  undistorter->undistort( image, expectedColour );
+
+  for( int type : { CV_8UC1, CV_32SC1 } ) {
+    cv::Mat converted, out, colour, rgbDepth;
+    depth.convertTo( converted, type );
+
+    undistorter->undistortDepth( converted, out );
+    undistorter->undistortRGBD( image, converted, colour, rgbDepth );
+    ASSERT_EQ( out.type(), type );
+    ASSERT_EQ( out.size(), expectedColour.size() );
+
+    ASSERT_EQ( cv::norm( out, rgbDepth, cv::NORM_INF ), 0 ) << "type " << type;
+    ASSERT_EQ( cv::norm( colour, expectedColour, cv::NORM_INF ), 0 ) << "type " << type;
+
+    // Depths are selected, never blended
+    out.convertTo( out, CV_16U );
+    for( int y = 0; y < out.rows; ++y ) {
+      for( int x = 0; x < out.cols; ++x ) {
+        const uint16_t d = out.at<uint16_t>(y,x);
+        ASSERT_TRUE( d == 0 || d == 10 || d == 30 ) << x << "," << y;
+      }
+    }
+  }
+}
+
+TEST(PTAMUndistorter, RGBDSizeMismatchUndistortsSeparately) {
+
+  std::shared_ptr<PTAMUndistorter> undistorter( distortingUndistorter() );
+  ASSERT_TRUE( (bool)undistorter );
+  const cv::Size size( undistorter->inputImageSize()() );
+
+  cv::Mat image( size, CV_8UC3 ), depth( size / 2, CV_16UC1, cv::Scalar(1000) );
+  cv::randu( image, cv::Scalar::all(0), cv::Scalar::all(255) );
+
+  cv::Mat expected, colour, depthOut;
+  undistorter->undistort( image, expected );
+  undistorter->undistortRGBD( image, depth, colour, depthOut );
+
+  ASSERT_EQ( cv::norm( colour, expected, cv::NORM_INF ), 0 );
+
+  // Depth of the wrong size is passed through, as by undistortDepth()
+  ASSERT_EQ( depthOut.size(), depth.size() );
+}
+
+TEST(PTAMUndistorter, WrappedStageRunsFirst) {
+
+  std::shared_ptr<Undistorter> crop( new ImageCropper( 640, 480, 40, 30 ) );
+  std::shared_ptr<PTAMUndistorter> wrapping( distortingUndistorter( crop ) ), plain( distortingUndistorter() );
+  ASSERT_TRUE( (bool)wrapping && (bool)plain );
+
+  // Smooth, so the compiled chain's coarser coordinates barely matter
+  cv::Mat image( 540, 720, CV_8UC1 );
+  for( int y = 0; y < image.rows; ++y )
+    for( int x = 0; x < image.cols; ++x ) image.at<uint8_t>(y,x) = 128 + 100 * sin( x / 40.0 ) * cos( y / 30.0 );
+
+  const cv::Rect window( 40, 30, 640, 480 ), roi( 100, 50, 200, 150 );
+  cv::Mat expected, result, roiResult;
+  plain->undistort( image( window ), expected );
+  wrapping->undistort( image, result );
+  wrapping->undistort( image, roiResult, roi );
+
+  ASSERT_EQ( cv::norm( result, expected, cv::NORM_INF ), 0 );
+  ASSERT_EQ( cv::norm( roiResult, expected( roi ), cv::NORM_INF ), 0 );
+
+  // The compiled chain samples the same coordinates
+  std::shared_ptr<CompiledUndistorter> compiled( CompiledUndistorter::compile( wrapping ) );
+  ASSERT_TRUE( (bool)compiled );
+
+  cv::Mat fused, diff;
+  compiled->undistort( image, fused );
+  ASSERT_EQ( fused.size(), expected.size() );
+  cv::absdiff( fused, expected, diff );
+  EXPECT_LT( cv::mean( diff )[0], 0.5 );
+}
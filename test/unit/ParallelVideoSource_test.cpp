@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <stdexcept>
+
+#include "libvideoio/ParallelVideoSource.h"
+
+#include "test_helpers.h"
+
+using namespace libvideoio;
+using namespace libvideoio::test;
+
+TEST( ParallelVideoSource, Split ) {
+  const std::vector<ParallelVideoSource::Range> ranges( ParallelVideoSource::split( 10, 4 ) );
+  ASSERT_EQ( ranges.size(), 4u );
+
+  int next = 0;
+  for( const auto &range : ranges ) {
+    EXPECT_EQ( range.begin, next );
+    EXPECT_GE( range.end - range.begin, 2 );
+    EXPECT_LE( range.end - range.begin, 3 );
+    next = range.end;
+  }
+  EXPECT_EQ( next, 10 );
+
+  EXPECT_EQ( ParallelVideoSource::split( 3, 8 ).size(), 3u );
+  EXPECT_TRUE( ParallelVideoSource::split( 0, 8 ).empty() );
+}
+
+TEST( ParallelVideoSource, DeliversFramesInOrder ) {
+  ScratchDir scratch( "videoio-parallel" );
+  const std::string video( ( scratch.path / "clip.avi" ).string() );
+  if( !writeClip( video ) ) return;
+
+  // One worker, chunks dealt across workers, and more workers than chunks
+  const struct { int workers, chunkFrames; } configs[] = { { 1, 16 }, { 4, 7 }, { 16, 40 } };
+  for( const auto &config : configs ) {
+    ParallelVideoSource source( video, config.workers, config.chunkFrames );
+    ASSERT_EQ( source.numFrames(), ClipFrames );
+    EXPECT_LE( source.numWorkers(), config.workers );
+
+    for( int frame = 0; frame < ClipFrames; ++frame ) {
+      ASSERT_TRUE( source.grab() ) << "frame " << frame;
+      cv::Mat image;
+      source.getImage( image );
+      EXPECT_EQ( frameNumber( image ), frame );
+      EXPECT_EQ( source.timestamp(), source.index()->timestamp( frame ) );
+    }
+    EXPECT_FALSE( source.grab() );
+  }
+
+  // A budget of one 64x48 frame per worker still delivers every frame,
+  // as the consumer's worker is never held back
+  {
+    ParallelVideoSource source( video, 4, 7, 1 );
+    EXPECT_EQ( source.bufferFrames(), source.numWorkers() );
+
+    for( int frame = 0; frame < ClipFrames; ++frame ) {
+      ASSERT_TRUE( source.grab() ) << "frame " << frame;
+      cv::Mat image;
+      source.getImage( image );
+      EXPECT_EQ( frameNumber( image ), frame );
+    }
+    EXPECT_FALSE( source.grab() );
+  }
+
+  // Destroyed with workers still waiting to deliver
+  ParallelVideoSource partial( video, 4, 8 );
+  ASSERT_TRUE( partial.grab() );
+}
+
+TEST( ParallelVideoSource, ForEachFrame ) {
+  ScratchDir scratch( "videoio-parallel" );
+  const std::string video( ( scratch.path / "clip.avi" ).string() );
+  if( !writeClip( video ) ) return;
+
+  std::vector< std::atomic<int> > seen( ClipFrames );
+  std::atomic<int> mismatched( 0 );
+
+  ASSERT_TRUE( ParallelVideoSource::forEachFrame( video, [&]( int frame, const cv::Mat &image ) {
+    ++seen[frame];
+    if( frameNumber( image ) != frame ) ++mismatched;
+  }, 4 ) );
+
+  for( int frame = 0; frame < ClipFrames; ++frame ) EXPECT_EQ( seen[frame].load(), 1 ) << "frame " << frame;
+  EXPECT_EQ( mismatched.load(), 0 );
+
+  EXPECT_THROW( ParallelVideoSource::forEachFrame( video, []( int frame, const cv::Mat & ) {
+    if( frame == 50 ) throw std::runtime_error( "stop" );
+  }, 4 ), std::runtime_error );
+}
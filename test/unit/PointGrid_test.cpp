@@ -0,0 +1,56 @@
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "undistorter/PointGrid.h"
+
+using namespace libvideoio;
+
+TEST( PointGrid, SIMDMatchesScalar ) {
+  remap::PointGrid grid;
+  grid.layout( 203, 157, 8, -1e5f );
+
+  for( int j = 0; j < grid.rows; ++j ) {
+    for( int i = 0; i < grid.cols; ++i ) {
+      const cv::Point2f n( grid.node(i,j) );
+      grid.x[j*grid.cols + i] = 1.1f * n.x + std::sin( 0.01f * n.y );
+      grid.y[j*grid.cols + i] = 0.9f * n.y + 0.01f * n.x;
+    }
+  }
+
+  // One invalid node
+  grid.x[5*grid.cols + 7] = grid.y[5*grid.cols + 7] = -1e5f;
+
+  std::mt19937 rng(1234);
+  std::uniform_real_distribution<float> coord( -5, 210 );
+
+  std::vector<cv::Point2f> in( 1003 );
+  for( auto &p : in ) p = cv::Point2f( coord(rng), coord(rng) );
+  in[0] = cv::Point2f( 202, 156 );     // far corner of the domain
+
+  std::vector<cv::Point2f> expected( in.size() );
+  grid.lookup( in.data(), expected.data(), in.size(), remap::KERNEL_SCALAR );
+
+  ASSERT_NEAR( expected[0].x, 1.1f * 202 + std::sin( 0.01f * 156 ), 1e-3 );
+
+  int numInvalid = 0;
+  for( size_t k = 0; k < in.size(); ++k ) {
+    const bool outside = in[k].x < 0 || in[k].y < 0 || in[k].x > 202 || in[k].y > 156;
+    if( outside ) ASSERT_EQ( expected[k].x, -1e5f );
+    if( expected[k].x == -1e5f ) ++numInvalid;
+  }
+  ASSERT_GT( numInvalid, 0 );
+
+  for( int level = remap::KERNEL_SCALAR; level <= remap::kernelLevel(); ++level ) {
+    std::vector<cv::Point2f> out( in.size() );
+    grid.lookup( in.data(), out.data(), in.size(), static_cast<remap::KernelLevel>(level) );
+
+    for( size_t k = 0; k < in.size(); ++k ) {
+      ASSERT_FLOAT_EQ( out[k].x, expected[k].x ) << k << " " << remap::kernelLevelName( static_cast<remap::KernelLevel>(level) );
+      ASSERT_FLOAT_EQ( out[k].y, expected[k].y ) << k;
+    }
+  }
+}
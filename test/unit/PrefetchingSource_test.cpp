@@ -0,0 +1,198 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "libvideoio/PrefetchingSource.h"
+
+using namespace libvideoio;
+
+// Source of numFrames stereo frames with depth, where every pixel of
+// frame n is n (images) or n+100 (depth).  With `reuse` the source
+// decodes into buffers of its own and returns references to them, as
+// LoggerSource does.
+class CountingSource : public ImageSource {
+public:
+  CountingSource( int numFrames, bool reuse = false )
+    : grabs( 0 ), _frames( numFrames ), _frame( -1 ), _reuse( reuse )
+  {
+    _numImages = 2;
+    _hasDepth = true;
+    setFPS( 30 );
+  }
+
+  virtual int numFrames( void ) const { return _frames; }
+  virtual ImageSize imageSize( void ) const { return ImageSize( 16, 8 ); }
+
+  virtual bool grab( void )
+  {
+    ++grabs;
+    return ++_frame < _frames;
+  }
+
+  virtual int getRawImage( int i, cv::Mat &mat )
+  {
+    if( i < 0 || i >= _numImages ) return -1;
+    fill( _buffers[i], mat, CV_8UC1, _frame );
+    return _frame;
+  }
+
+  virtual void getDepth( cv::Mat &mat )
+  {
+    fill( _depth, mat, CV_16UC1, _frame + 100 );
+  }
+
+  virtual int cvtToGray() { return 42; }
+
+  std::atomic<int> grabs;
+
+protected:
+
+  void fill( cv::Mat &buffer, cv::Mat &mat, int type, int value )
+  {
+    cv::Mat &target( _reuse ? buffer : mat );
+    target.create( 8, 16, type );
+    target.setTo( cv::Scalar( value ) );
+    if( _reuse ) mat = buffer;
+  }
+
+  int _frames, _frame;
+  bool _reuse;
+  cv::Mat _buffers[2], _depth;
+};
+
+static void expectFrame( ImageSource &source, int n )
+{
+  cv::Mat left, right, depth;
+  EXPECT_EQ( source.getRawImage( 0, left ), n );
+  EXPECT_EQ( source.getRawImage( 1, right ), n );
+  source.getDepth( depth );
+
+  ASSERT_FALSE( left.empty() );
+  EXPECT_EQ( cv::countNonZero( left != n ), 0 );
+  EXPECT_EQ( cv::countNonZero( right != n ), 0 );
+  EXPECT_EQ( cv::countNonZero( depth != n + 100 ), 0 );
+}
+
+TEST( PrefetchingSource, DeliversEveryFrameInOrder ) {
+  std::shared_ptr<CountingSource> counting( new CountingSource( 20 ) );
+  PrefetchingSource source( counting, 3 );
+
+  ASSERT_EQ( source.numImages(), 2 );
+  ASSERT_TRUE( source.hasDepth() );
+  ASSERT_EQ( source.numFrames(), 20 );
+  ASSERT_EQ( source.cvtToGray(), 42 );
+  ASSERT_FLOAT_EQ( source.fps(), 30 );
+
+  for( int n = 0; n < 20; ++n ) {
+    ASSERT_TRUE( source.grab() );
+    expectFrame( source, n );
+  }
+
+  ASSERT_FALSE( source.grab() );
+  ASSERT_FALSE( source.grab() );
+}
+
+TEST( PrefetchingSource, CopiesBuffersTheSourceReuses ) {
+  std::shared_ptr<CountingSource> counting( new CountingSource( 12, true ) );
+  PrefetchingSource source( counting, 4 );
+
+  // Frames held by the consumer are never overwritten by later decodes
+  std::vector<cv::Mat> held;
+  for( int n = 0; n < 12; ++n ) {
+    ASSERT_TRUE( source.grab() );
+    cv::Mat image;
+    source.getRawImage( 0, image );
+    held.push_back( image );
+  }
+
+  for( int n = 0; n < 12; ++n ) EXPECT_EQ( cv::countNonZero( held[n] != n ), 0 );
+}
+
+TEST( PrefetchingSource, StaysWithinDepth ) {
+  std::shared_ptr<CountingSource> counting( new CountingSource( 1000 ) );
+  PrefetchingSource source( counting, 2 );
+
+  ASSERT_TRUE( source.grab() );
+  expectFrame( source, 0 );
+
+  // One frame taken, two ready, and the thread blocked on the third
+  std::this_thread::sleep_for( std::chrono::milliseconds( 50 ) );
+  EXPECT_LE( counting->grabs.load(), 3 );
+
+  // Destroyed while the thread is waiting for space
+}
+
+TEST( PrefetchingSource, GetImageWithOutputType ) {
+  std::shared_ptr<CountingSource> counting( new CountingSource( 3 ) );
+  PrefetchingSource source( counting );
+  source.setOutputType( CV_8UC1 );
+
+  cv::Mat image;
+  for( int n = 0; n < 3; ++n ) {
+    ASSERT_TRUE( source.grab() );
+    source.getImage( image );
+    ASSERT_EQ( image.type(), CV_8UC1 );
+    EXPECT_EQ( cv::countNonZero( image != n ), 0 );
+  }
+}
+
+// CountingSource with BGR images, recording the threads which convert
+// them in getImage()
+class ColourSource : public CountingSource {
+public:
+  ColourSource( int numFrames )
+    : CountingSource( numFrames ) {;}
+
+  virtual int getRawImage( int i, cv::Mat &mat )
+  {
+    if( i < 0 || i >= _numImages ) return -1;
+    mat.create( 8, 16, CV_8UC3 );
+    mat.setTo( cv::Scalar::all( _frame ) );
+    return _frame;
+  }
+
+  virtual int getImage( int i, cv::Mat &mat )
+  {
+    {
+      std::lock_guard<std::mutex> lock( threadMutex );
+      threads.insert( std::this_thread::get_id() );
+    }
+    return CountingSource::getImage( i, mat );
+  }
+
+  virtual int cvtToGray() { return cv::COLOR_BGR2GRAY; }
+
+  std::mutex threadMutex;
+  std::set<std::thread::id> threads;
+};
+
+TEST( PrefetchingSource, ConvertsToSourceOutputTypeWhilePrefetching ) {
+  std::shared_ptr<ColourSource> colour( new ColourSource( 6 ) );
+  colour->setOutputType( CV_8UC1 );
+
+  PrefetchingSource source( colour, 2 );
+  ASSERT_EQ( source.outputType(), CV_8UC1 );
+
+  cv::Mat image;
+  for( int n = 0; n < 6; ++n ) {
+    ASSERT_TRUE( source.grab() );
+
+    // Already converted, so the raw image is the output type too
+    source.getRawImage( 0, image );
+    ASSERT_EQ( image.type(), CV_8UC1 );
+
+    source.getImage( image );
+    ASSERT_EQ( image.type(), CV_8UC1 );
+    EXPECT_EQ( cv::countNonZero( image != n ), 0 );
+  }
+
+  std::lock_guard<std::mutex> lock( colour->threadMutex );
+  EXPECT_EQ( colour->threads.count( std::this_thread::get_id() ), 0u );
+  EXPECT_EQ( colour->threads.size(), 1u );
+}
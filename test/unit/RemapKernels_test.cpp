@@ -0,0 +1,402 @@
+
+#include <cmath>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "undistorter/RemapKernels.h"
+
+using namespace libvideoio;
+
+namespace {
+
+  struct RemapFixture {
+    RemapFixture( int w, int h, int n )
+      : width(w), height(h), image(w*h), mapX(n), mapY(n)
+    {
+      std::mt19937 rng(1234);
+      std::uniform_int_distribution<int> pixel(0,255);
+      std::uniform_real_distribution<float> xs(0.01f, width-1.01f), ys(0.01f, height-1.01f);
+
+      for( auto &p : image ) p = pixel(rng);
+
+      for( int i = 0; i < n; ++i ) {
+        if( i % 13 == 0 ) {
+          mapX[i] = mapY[i] = -1;
+        } else {
+          mapX[i] = xs(rng);
+          mapY[i] = ys(rng);
+        }
+      }
+
+      // Exercise the last valid source pixel (tests the gather bounds check)
+      mapX[1] = width-1.01f;
+      mapY[1] = height-1.01f;
+    }
+
+    remap::SourceImage source() const
+      { return remap::SourceImage( image.data(), width, width, height ); }
+
+    int width, height;
+    std::vector<uint8_t> image;
+    std::vector<float> mapX, mapY;
+  };
+
+}
+
+TEST( RemapKernels, SIMDMatchesScalar ) {
+  RemapFixture f( 203, 157, 5003 );
+
+  std::vector<uint8_t> scalar( f.mapX.size() );
+  remap::bilinear8U( f.source(), f.mapX.data(), f.mapY.data(), scalar.data(), scalar.size(), remap::KERNEL_SCALAR );
+
+  for( int level = remap::KERNEL_SSE41; level <= remap::kernelLevel(); ++level ) {
+    std::vector<uint8_t> simd( f.mapX.size() );
+    remap::bilinear8U( f.source(), f.mapX.data(), f.mapY.data(), simd.data(), simd.size(), static_cast<remap::KernelLevel>(level) );
+
+    ASSERT_EQ( scalar, simd ) << remap::kernelLevelName( static_cast<remap::KernelLevel>(level) ) << " differs from scalar kernel";
+  }
+}
+
+TEST( RemapKernels, FixedPointWithinOneLSB ) {
+  RemapFixture f( 64, 48, 2000 );
+
+  std::vector<uint8_t> out( f.mapX.size() );
+  remap::bilinear8U( f.source(), f.mapX.data(), f.mapY.data(), out.data(), out.size() );
+
+  for( size_t i = 0; i < out.size(); ++i ) {
+    if( f.mapX[i] < 0 ) {
+      ASSERT_EQ( out[i], 0 );
+      continue;
+    }
+
+    const int xi = f.mapX[i], yi = f.mapY[i];
+    const float xx = f.mapX[i] - xi, yy = f.mapY[i] - yi;
+    const uint8_t *p = f.image.data() + xi + yi*f.width;
+
+    const float expected = (1-xx)*(1-yy)*p[0] + xx*(1-yy)*p[1] + (1-xx)*yy*p[f.width] + xx*yy*p[f.width+1];
+    ASSERT_LE( std::abs( out[i] - expected ), 1.0f ) << "at output pixel " << i;
+  }
+}
+
+namespace {
+
+  template< typename T, int CN >
+  void checkBilinear( remap::Depth depth, float maxValue, float tolerance )
+  {
+    const int width = 37, height = 29, n = 500;
+
+    std::mt19937 rng(4321);
+    std::uniform_real_distribution<float> pixel(0, maxValue);
+    std::uniform_real_distribution<float> xs(0.01f, width-1.01f), ys(0.01f, height-1.01f);
+
+    std::vector<T> image( width*height*CN );
+    for( auto &p : image ) p = pixel(rng);
+
+    std::vector<float> mapX(n), mapY(n);
+    for( int i = 0; i < n; ++i ) {
+      mapX[i] = (i % 7 == 0) ? -1 : xs(rng);
+      mapY[i] = (i % 7 == 0) ? -1 : ys(rng);
+    }
+
+    remap::RemapFunc func = remap::bilinearFunc( depth, CN );
+    ASSERT_TRUE( func != nullptr );
+
+    const remap::SourceImage src( reinterpret_cast<const uint8_t *>(image.data()), width*CN*sizeof(T), width, height );
+    std::vector<T> out( n*CN );
+    func( src, mapX.data(), mapY.data(), out.data(), n );
+
+    for( int i = 0; i < n; ++i ) {
+      for( int c = 0; c < CN; ++c ) {
+        if( mapX[i] < 0 ) {
+          ASSERT_EQ( out[i*CN+c], 0 );
+          continue;
+        }
+
+        const int xi = mapX[i], yi = mapY[i];
+        const float xx = mapX[i] - xi, yy = mapY[i] - yi;
+        const T *p = image.data() + (xi + yi*width)*CN + c;
+
+        const float expected = (1-xx)*(1-yy)*p[0] + xx*(1-yy)*p[CN] + (1-xx)*yy*p[width*CN] + xx*yy*p[(width+1)*CN];
+        ASSERT_NEAR( out[i*CN+c], expected, tolerance ) << "at output pixel " << i << " channel " << c;
+      }
+    }
+  }
+
+}
+
+TEST( RemapKernels, MultiChannelAndDepth ) {
+  checkBilinear<uint8_t,3>( remap::DEPTH_8U, 255, 1 );
+  checkBilinear<uint8_t,4>( remap::DEPTH_8U, 255, 1 );
+  checkBilinear<uint16_t,1>( remap::DEPTH_16U, 65535, 1 );
+  checkBilinear<uint16_t,3>( remap::DEPTH_16U, 65535, 1 );
+  checkBilinear<float,1>( remap::DEPTH_32F, 10, 1e-4 );
+  checkBilinear<float,4>( remap::DEPTH_32F, 10, 1e-4 );
+
+  ASSERT_TRUE( remap::bilinearFunc( remap::DEPTH_8U, 2 ) == nullptr );
+}
+
+TEST( RemapKernels, PackedTableMatchesQuantizedFloatMaps ) {
+  const int outWidth = 97, outHeight = 23;
+  RemapFixture f( 203, 157, outWidth*outHeight );
+
+  // Invalidate a border so rows carry several spans
+  for( int y = 0; y < outHeight; ++y ) {
+    for( int x = 0; x < 5; ++x ) f.mapX[y*outWidth + x] = f.mapY[y*outWidth + x] = -1;
+  }
+
+  remap::RemapTable table;
+  table.build( f.mapX.data(), f.mapY.data(), outWidth, outHeight, f.width, f.height );
+  ASSERT_LT( table.bytes(), f.mapX.size() * 2 * sizeof(float) );
+
+  // With coordinates already on the table's 1/256 grid, the packed
+  // kernel must reproduce the float-map kernel exactly
+  const float one = 1 << table.fracBits;
+  std::vector<float> qx( f.mapX.size() ), qy( f.mapY.size() );
+  for( size_t i = 0; i < qx.size(); ++i ) {
+    if( f.mapX[i] < 0 ) {
+      qx[i] = qy[i] = -1;
+    } else {
+      const uint16_t fr = table.frac[i];
+      qx[i] = table.xy[2*i]   + (fr & ((1 << table.fracBits)-1)) / one;
+      qy[i] = table.xy[2*i+1] + (fr >> table.fracBits) / one;
+    }
+  }
+
+  std::vector<uint8_t> expected( qx.size() );
+  remap::bilinear8U( f.source(), qx.data(), qy.data(), expected.data(), expected.size(), remap::KERNEL_SCALAR );
+
+  for( int level = remap::KERNEL_SCALAR; level <= remap::kernelLevel(); ++level ) {
+    remap::PackedRemapFunc kernel = remap::packedBilinearFunc( remap::DEPTH_8U, 1, static_cast<remap::KernelLevel>(level) );
+
+    std::vector<uint8_t> out( qx.size(), 0xAA );
+    for( int y = 0; y < outHeight; ++y )
+      remap::remapRow( f.source(), table, kernel, 1, y, 0, outWidth, out.data() + y*outWidth );
+
+    ASSERT_EQ( expected, out ) << remap::kernelLevelName( static_cast<remap::KernelLevel>(level) );
+
+    // Partial rows only touch their own columns
+    std::vector<uint8_t> partial( outWidth, 0xAA );
+    remap::remapRow( f.source(), table, kernel, 1, 3, 2, 40, partial.data() );
+    for( int x = 0; x < outWidth; ++x ) {
+      if( x < 2 || x >= 40 )
+        ASSERT_EQ( partial[x], 0xAA );
+      else
+        ASSERT_EQ( partial[x], expected[3*outWidth + x] );
+    }
+  }
+}
+
+TEST( RemapKernels, TilesCoverOutputAndBoundFootprint ) {
+  // A transposing map is the worst case for row-major traversal:  each
+  // output row walks down a source column
+  const int size = 300;
+  RemapFixture f( size, size, size*size );
+  for( int y = 0; y < size; ++y ) {
+    for( int x = 0; x < size; ++x ) {
+      f.mapX[y*size + x] = std::min( y + 0.25f, size - 1.01f );
+      f.mapY[y*size + x] = std::min( x + 0.5f, size - 1.01f );
+    }
+  }
+
+  remap::RemapTable table;
+  table.build( f.mapX.data(), f.mapY.data(), size, size, size, size );
+
+  // The default budget covers this whole source, so only bands are used
+  for( const auto &tile : table.tiles ) ASSERT_EQ( tile.x1 - tile.x0, size );
+
+  const int budget = 4096;
+  table.buildTiles( budget );
+  ASSERT_GT( table.tiles.size(), (size_t)size / 16 );
+
+  std::vector<int> covered( size*size, 0 );
+  for( const auto &tile : table.tiles ) {
+    int minX = size, minY = size, maxX = -1, maxY = -1;
+    for( int y = tile.y0; y < tile.y1; ++y ) {
+      for( int x = tile.x0; x < tile.x1; ++x ) {
+        ++covered[y*size + x];
+        minX = std::min<int>( minX, table.xy[2*(y*size+x)] );
+        maxX = std::max<int>( maxX, table.xy[2*(y*size+x)] );
+        minY = std::min<int>( minY, table.xy[2*(y*size+x)+1] );
+        maxY = std::max<int>( maxY, table.xy[2*(y*size+x)+1] );
+      }
+    }
+    ASSERT_LE( (maxX - minX + 2) * (maxY - minY + 2), budget );
+  }
+  for( int c : covered ) ASSERT_EQ( c, 1 );
+
+  // Tiled traversal produces the same image as row-major traversal
+  remap::PackedRemapFunc kernel = remap::packedBilinearFunc( remap::DEPTH_8U, 1 );
+
+  std::vector<uint8_t> rows( size*size ), tiled( size*size, 0xAA );
+  for( int y = 0; y < size; ++y )
+    remap::remapRow( f.source(), table, kernel, 1, y, 0, size, rows.data() + y*size );
+  for( const auto &tile : table.tiles )
+    remap::remapTile( f.source(), table, kernel, 1, tile, tiled.data(), size );
+
+  ASSERT_EQ( rows, tiled );
+}
+
+TEST( RemapKernels, ConsistencyCheckRejectsCorruptTables ) {
+  const int w = 80, h = 60;
+  RemapFixture f( w, h, w*h );
+
+  remap::RemapTable table;
+  table.build( f.mapX.data(), f.mapY.data(), w, h, w, h );
+  ASSERT_TRUE( table.consistent( w, h ) );
+
+  // A smaller source puts the table's coordinates out of bounds
+  ASSERT_FALSE( table.consistent( w/2, h/2 ) );
+
+  std::vector<std::function<void( remap::RemapTable & )>> corruptions = {
+    []( remap::RemapTable &t ) { std::swap( t.rowSpans[10], t.rowSpans[20] ); },
+    []( remap::RemapTable &t ) { t.rowSpans.back() += 1; },
+    []( remap::RemapTable &t ) { t.spans[3].end = t.width + 1; },
+    []( remap::RemapTable &t ) { std::swap( t.spans[3].begin, t.spans[3].end ); },
+    []( remap::RemapTable &t ) { t.tiles[0].y1 = t.height + 1; },
+    []( remap::RemapTable &t ) { t.tiles.pop_back(); },
+    []( remap::RemapTable &t ) { t.tiles.push_back( t.tiles.front() ); },
+    []( remap::RemapTable &t ) { t.xy[2*t.spans[0].begin] = t.width - 1; },
+    []( remap::RemapTable &t ) { t.fracBits = 9; }
+  };
+
+  for( size_t i = 0; i < corruptions.size(); ++i ) {
+    remap::RemapTable corrupt( table );
+    corruptions[i]( corrupt );
+    EXPECT_FALSE( corrupt.consistent( w, h ) ) << "corruption " << i;
+  }
+}
+
+TEST( RemapKernels, DepthKernelsNeverBlend ) {
+  // 4x2 depth image:  a step from 1000 to 3000 between columns 1 and 2,
+  // with a missing measurement at (1,1)
+  const uint16_t image[8] = { 1000, 1000, 3000, 3000,
+                              1000,    0, 3000, 3000 };
+  const remap::SourceImage src( reinterpret_cast<const uint8_t *>( image ), 4*sizeof(uint16_t), 4, 2 );
+
+  // 5 fraction bits per axis, as cv::convertMaps produces
+  const int bits = 5;
+  const int16_t xy[] = { 1,0,   1,0,   0,0,   3,1,   -40,-40 };
+  const uint16_t frac[] = { 20,             // x + 20/32, nearest is column 2
+                            10,             // x + 10/32, nearest is column 1
+                            (20 << bits) | 20,  // nearest is the hole at (1,1)
+                            0,              // last pixel, right/bottom taps outside
+                            0 };            // entirely outside the image
+  const int count = 5;
+
+  uint16_t nearest[count], minDepth[count];
+  remap::packedDepthFunc( remap::DEPTH_16U, remap::SAMPLE_NEAREST )( src, xy, frac, bits, nearest, count );
+  remap::packedDepthFunc( remap::DEPTH_16U, remap::SAMPLE_MIN_DEPTH )( src, xy, frac, bits, minDepth, count );
+
+  const uint16_t expectNearest[count] = { 3000, 1000, 0, 3000, 0 };
+  const uint16_t expectMin[count] = { 1000, 1000, 1000, 3000, 0 };
+
+  for( int i = 0; i < count; ++i ) {
+    EXPECT_EQ( nearest[i], expectNearest[i] ) << i;
+    EXPECT_EQ( minDepth[i], expectMin[i] ) << i;
+  }
+
+  // NaN is missing in float depth
+  const float fimage[4] = { NAN, 2.0f, 0.5f, 4.0f };
+  const remap::SourceImage fsrc( reinterpret_cast<const uint8_t *>( fimage ), 2*sizeof(float), 2, 2 );
+  const int16_t fxy[] = { 0,0 };
+  const uint16_t ffrac[] = { 0 };
+  float fnearest, fmin;
+  remap::packedDepthFunc( remap::DEPTH_32F, remap::SAMPLE_NEAREST )( fsrc, fxy, ffrac, bits, &fnearest, 1 );
+  remap::packedDepthFunc( remap::DEPTH_32F, remap::SAMPLE_MIN_DEPTH )( fsrc, fxy, ffrac, bits, &fmin, 1 );
+  EXPECT_EQ( fnearest, 0.0f );
+  EXPECT_EQ( fmin, 0.5f );
+
+  ASSERT_TRUE( remap::packedDepthFunc( remap::DEPTH_8U, remap::SAMPLE_NEAREST ) == nullptr );
+}
+
+TEST( RemapKernels, ConvertingKernelMatchesReference ) {
+  // 3x3 BGR image
+  std::vector<uint8_t> image( 3*3*3 );
+  for( size_t i = 0; i < image.size(); ++i ) image[i] = (i * 37) % 256;
+  const remap::SourceImage src( image.data(), 3*3, 3, 3 );
+
+  const int bits = 5;
+  const int16_t xy[] = { 0,0,   1,1,   2,1,   -1,-1 };
+  const uint16_t frac[] = { (8 << bits) | 16,   0,   31,   (16 << bits) | 16 };
+  const int count = 4;
+
+  remap::Conversion gray = { { 0.114f, 0.587f, 0.299f, 0.0f }, 1.0f/255, 0.0f };
+  float out[count];
+  remap::convertingBilinearFunc( 3, 1, remap::DEPTH_32F )( src, xy, frac, bits, gray, out, count );
+
+  for( int i = 0; i < count; ++i ) {
+    const float fx = (frac[i] & 31) / 32.0f, fy = (frac[i] >> bits) / 32.0f;
+
+    // Gray of each tap, outside taps are 0, then interpolated
+    float expected = 0;
+    for( int t = 0; t < 4; ++t ) {
+      const int tx = xy[2*i] + (t & 1), ty = xy[2*i+1] + (t >> 1);
+      if( tx < 0 || ty < 0 || tx > 2 || ty > 2 ) continue;
+
+      const uint8_t *p = &image[ (ty*3 + tx) * 3 ];
+      const float g = 0.114f*p[0] + 0.587f*p[1] + 0.299f*p[2];
+      expected += ((t & 1) ? fx : 1-fx) * ((t >> 1) ? fy : 1-fy) * g;
+    }
+
+    EXPECT_NEAR( out[i], expected / 255, 1e-5 ) << i;
+  }
+
+  // Type conversion only, with rounding and saturation
+  remap::Conversion scale = { { 0, 0, 0, 0 }, 2.0f, 0.0f };
+  uint8_t bgr[count*3];
+  remap::convertingBilinearFunc( 3, 3, remap::DEPTH_8U )( src, xy, frac, bits, scale, bgr, count );
+  EXPECT_EQ( bgr[3], std::min( 255, 2 * image[ (1*3 + 1)*3 ] ) );
+
+  ASSERT_TRUE( remap::convertingBilinearFunc( 3, 4, remap::DEPTH_8U ) == nullptr );
+}
+
+TEST( RemapKernels, NearestAndBicubic ) {
+  const int w = 8, h = 8;
+  std::vector<float> image( w*h );
+  for( int y = 0; y < h; ++y )
+    for( int x = 0; x < w; ++x ) image[y*w + x] = 3*x + 5*y;
+  const remap::SourceImage src( reinterpret_cast<const uint8_t *>( image.data() ), w*sizeof(float), w, h );
+
+  const int bits = 8;
+  const int16_t xy[] = { 2,3,   4,4,   3,2 };
+  const uint16_t frac[] = { (64 << bits) | 200,   0,   (128 << bits) | 127 };
+  const int count = 3;
+
+  float nearest[count], cubic[count];
+  remap::packedNearestFunc( remap::DEPTH_32F, 1 )( src, xy, frac, bits, nearest, count );
+  remap::packedBicubicFunc( remap::DEPTH_32F, 1 )( src, xy, frac, bits, cubic, count );
+
+  // x rounds up at 200/256, y down at 64/256;  128/256 rounds up
+  EXPECT_EQ( nearest[0], image[3*w + 3] );
+  EXPECT_EQ( nearest[1], image[4*w + 4] );
+  EXPECT_EQ( nearest[2], image[3*w + 3] );
+
+  // Exact at pixel centres;  elsewhere between the neighbouring values of
+  // the ramp, with a small overshoot from the negative lobes
+  EXPECT_NEAR( cubic[1], image[4*w + 4], 1e-4 );
+  for( int i = 0; i < count; ++i ) {
+    const float x = xy[2*i] + (frac[i] & 255) / 256.0f, y = xy[2*i+1] + (frac[i] >> bits) / 256.0f;
+    EXPECT_NEAR( cubic[i], 3*x + 5*y, 0.25 ) << i;
+  }
+
+  // The weights sum to one
+  std::vector<float> flat( w*h, 7.0f );
+  const remap::SourceImage flatSrc( reinterpret_cast<const uint8_t *>( flat.data() ), w*sizeof(float), w, h );
+  remap::packedBicubicFunc( remap::DEPTH_32F, 1 )( flatSrc, xy, frac, bits, cubic, count );
+  for( int i = 0; i < count; ++i ) EXPECT_NEAR( cubic[i], 7.0f, 1e-5 ) << i;
+
+  // Integer results round and saturate
+  const uint8_t edge[16] = { 0,   0,   0, 0,
+                             0, 255, 255, 0,
+                             0, 255, 255, 0,
+                             0,   0,   0, 0 };
+  const remap::SourceImage src8( edge, 4, 4, 4 );
+  const int16_t centre[] = { 1,1 };
+  const uint16_t atPixel[] = { 0 };
+  uint8_t out;
+  remap::packedBicubicFunc( remap::DEPTH_8U, 1 )( src8, centre, atPixel, bits, &out, 1 );
+  EXPECT_EQ( out, 255 );
+}
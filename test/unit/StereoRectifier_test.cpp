@@ -0,0 +1,114 @@
+#include <iostream>
+
+#include <gtest/gtest.h>
+
+#include "test_files.h"
+
+#include "libvideoio/StereoRectifier.h"
+#include "libvideoio/ThreadPool.h"
+
+using namespace libvideoio;
+
+using namespace std;
+
+namespace {
+
+  // Builds the ROS_YAML camera with a horizontal offset of tx (in the
+  // calibration's units) in its projection matrix
+  std::shared_ptr<OpenCVUndistorter> offsetCamera( double tx )
+  {
+    std::shared_ptr<OpenCVUndistorter> base( ROSUndistorterFactory::loadFromFile( ROS_YAML ) );
+
+    cv::Mat projection( 3, 4, CV_64F, cv::Scalar(0) );
+    base->getK().copyTo( projection( cv::Rect(0,0,3,3) ) );
+    projection.at<double>(0,3) = -projection.at<double>(0,0) * tx;
+
+    cv::Mat distortion = (cv::Mat_<double>(1,5) << -0.176771, 0.108290, -0.001019, 0.000326, 0.0);
+
+    return std::shared_ptr<OpenCVUndistorter>( new OpenCVUndistorter( base->getOriginalK(), projection,
+                                                                      cv::Mat::eye(3,3,CV_64F), distortion,
+                                                                      base->inputImageSize() ) );
+  }
+
+}
+
+TEST(StereoRectifier, MatchesIndividualUndistort) {
+  std::shared_ptr<OpenCVUndistorter> left( offsetCamera( 0.0 ) ), right( offsetCamera( 0.12 ) );
+  StereoRectifier rectifier( left, right );
+
+  ASSERT_NEAR( rectifier.baseline(), 0.12, 1e-9 );
+
+  cv::Mat leftImage( left->inputImageSize()(), CV_8UC1 ), rightImage( right->inputImageSize()(), CV_8UC1 );
+  cv::randu( leftImage, cv::Scalar::all(0), cv::Scalar::all(255) );
+  cv::randu( rightImage, cv::Scalar::all(0), cv::Scalar::all(255) );
+
+  cv::Mat leftOut, rightOut;
+  rectifier.setNumThreads( 5 );
+  rectifier.rectify( leftImage, rightImage, leftOut, rightOut );
+
+  cv::Mat leftExpected, rightExpected;
+  left->undistort( leftImage, leftExpected );
+  right->undistort( rightImage, rightExpected );
+
+  ASSERT_EQ( cv::norm( leftOut, leftExpected, cv::NORM_INF ), 0 );
+  ASSERT_EQ( cv::norm( rightOut, rightExpected, cv::NORM_INF ), 0 );
+
+  // In place, and with the results swapped onto the inputs
+  ASSERT_EQ( leftOut.size(), leftImage.size() );
+
+  cv::Mat leftInPlace( leftImage.clone() ), rightInPlace( rightImage.clone() );
+  rectifier.rectify( leftInPlace, rightInPlace, leftInPlace, rightInPlace );
+  EXPECT_EQ( cv::norm( leftInPlace, leftExpected, cv::NORM_INF ), 0 );
+  EXPECT_EQ( cv::norm( rightInPlace, rightExpected, cv::NORM_INF ), 0 );
+
+  cv::Mat leftSwapped( leftImage.clone() ), rightSwapped( rightImage.clone() );
+  rectifier.rectify( leftSwapped, rightSwapped, rightSwapped, leftSwapped );
+  EXPECT_EQ( cv::norm( rightSwapped, leftExpected, cv::NORM_INF ), 0 );
+  EXPECT_EQ( cv::norm( leftSwapped, rightExpected, cv::NORM_INF ), 0 );
+}
+
+TEST(StereoRectifier, RectifiesOnPoolWorkers) {
+  std::shared_ptr<OpenCVUndistorter> left( offsetCamera( 0.0 ) ), right( offsetCamera( 0.12 ) );
+  StereoRectifier rectifier( left, right );
+
+  cv::Mat leftImage( left->inputImageSize()(), CV_8UC1 ), rightImage( right->inputImageSize()(), CV_8UC1 );
+  cv::randu( leftImage, cv::Scalar::all(0), cv::Scalar::all(255) );
+  cv::randu( rightImage, cv::Scalar::all(0), cv::Scalar::all(255) );
+
+  cv::Mat leftExpected, rightExpected;
+  left->undistort( leftImage, leftExpected );
+  right->undistort( rightImage, rightExpected );
+
+  // With every worker inside rectify(), none is left to run work it
+  // hands to the pool, so this would hang if rectify() waited on it
+  ThreadPool &pool( ThreadPool::global() );
+  const int pairs = pool.numWorkers() + 1;
+  std::vector<cv::Mat> leftOut( pairs ), rightOut( pairs );
+
+  pool.parallelFor( 0, pairs, pairs, [&]( int p0, int p1 ) {
+    for( int p = p0; p < p1; ++p )
+      rectifier.rectify( leftImage, rightImage, leftOut[p], rightOut[p] );
+  });
+
+  for( int p = 0; p < pairs; ++p ) {
+    ASSERT_EQ( cv::norm( leftOut[p], leftExpected, cv::NORM_INF ), 0 );
+    ASSERT_EQ( cv::norm( rightOut[p], rightExpected, cv::NORM_INF ), 0 );
+  }
+}
+
+TEST(StereoRectifier, QReprojectsDisparity) {
+  StereoRectifier rectifier( offsetCamera( 0.0 ), offsetCamera( 0.12 ) );
+
+  const cv::Mat &Q( rectifier.Q() );
+  ASSERT_EQ( Q.rows, 4 );
+  ASSERT_EQ( Q.cols, 4 );
+
+  // A point on the optical axis at depth Z has disparity f*B/Z
+  const double f = rectifier.left()->getK().at<double>(0,0);
+  const double cx = rectifier.left()->getK().at<double>(0,2);
+  const double cy = rectifier.left()->getK().at<double>(1,2);
+  const double Z = 3.0, d = f * 0.12 / Z;
+
+  cv::Mat p = Q * (cv::Mat_<double>(4,1) << cx, cy, d, 1.0);
+  ASSERT_NEAR( p.at<double>(2) / p.at<double>(3), Z, 1e-6 );
+}
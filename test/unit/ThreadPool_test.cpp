@@ -0,0 +1,57 @@
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "libvideoio/ThreadPool.h"
+
+using namespace libvideoio;
+
+TEST( ThreadPool, ParallelForCoversRange ) {
+  ThreadPool pool( 3 );
+
+  for( int bands = 1; bands <= 9; ++bands ) {
+    std::vector<int> hits( 101, 0 );
+
+    pool.parallelFor( 0, hits.size(), bands, [&]( int b0, int b1 ) {
+      for( int i = b0; i < b1; ++i ) hits[i]++;
+    });
+
+    for( auto h : hits ) ASSERT_EQ( h, 1 ) << "with " << bands << " bands";
+  }
+}
+
+TEST( ThreadPool, NestedParallelFor ) {
+  ThreadPool pool( 2 );
+  std::atomic<int> count( 0 );
+
+  pool.parallelFor( 0, 4, 4, [&]( int b0, int b1 ) {
+    for( int i = b0; i < b1; ++i ) {
+      pool.parallelFor( 0, 10, 4, [&]( int c0, int c1 ) { count += c1 - c0; });
+    }
+  });
+
+  ASSERT_EQ( count, 40 );
+}
+
+TEST( ThreadPool, ParallelForRethrows ) {
+  ThreadPool pool( 2 );
+
+  ASSERT_THROW( pool.parallelFor( 0, 8, 4, []( int b0, int b1 ) {
+                  if( b0 == 0 ) throw std::runtime_error("band failed");
+                }), std::runtime_error );
+}
+
+TEST( ThreadPool, Submit ) {
+  ThreadPool pool( 2 );
+  std::atomic<int> count( 0 );
+
+  std::vector< std::future<void> > futures;
+  for( int i = 0; i < 16; ++i )
+    futures.push_back( pool.submit( [&count]() { ++count; } ) );
+
+  for( auto &f : futures ) f.get();
+  ASSERT_EQ( count, 16 );
+}
@@ -0,0 +1,130 @@
+#include <gtest/gtest.h>
+
+#include <fstream>
+
+#include "libvideoio/ImageSource.h"
+#include "libvideoio/VideoIndex.h"
+
+#include "test_helpers.h"
+
+using namespace libvideoio;
+using namespace libvideoio::test;
+
+TEST( VideoIndex, SidecarRoundTrip ) {
+  ScratchDir scratch( "videoio-index" );
+  const std::string video( ( scratch.path / "video.avi" ).string() );
+  { std::ofstream out( video ); out << "not really a video"; }
+
+  std::vector<double> timestamps;
+  for( int i = 0; i < 100; ++i ) timestamps.push_back( 40.0 * i );
+
+  const VideoIndex index( timestamps );
+  ASSERT_TRUE( index.hasTimestamps() );
+  ASSERT_TRUE( index.save( video ) );
+
+  std::shared_ptr<VideoIndex> loaded( VideoIndex::load( video ) );
+  ASSERT_TRUE( (bool)loaded );
+  ASSERT_EQ( loaded->numFrames(), 100 );
+  for( int i = 0; i < 100; ++i ) ASSERT_EQ( loaded->timestamp(i), timestamps[i] );
+
+  EXPECT_EQ( loaded->frameAt( 41 ), 1 );
+  EXPECT_EQ( loaded->frameAt( 59 ), 1 );
+  EXPECT_EQ( loaded->frameAt( 61 ), 2 );
+  EXPECT_EQ( loaded->frameAt( -5 ), 0 );
+  EXPECT_EQ( loaded->frameAt( 1e9 ), 99 );
+
+  // A changed video invalidates the sidecar
+  { std::ofstream out( video, std::ios::app ); out << " any more"; }
+  EXPECT_FALSE( (bool)VideoIndex::load( video ) );
+
+  // As does a corrupt one
+  ASSERT_TRUE( index.save( video ) );
+  { std::ofstream out( VideoIndex::sidecarPath( video ), std::ios::binary | std::ios::trunc ); out << "garbage"; }
+  EXPECT_FALSE( (bool)VideoIndex::load( video ) );
+
+  // ... or one whose frame count (the header's last field) is more than
+  // the file holds, which must be rejected before it is allocated
+  ASSERT_TRUE( index.save( video ) );
+  {
+    std::fstream out( VideoIndex::sidecarPath( video ), std::ios::binary | std::ios::in | std::ios::out );
+    const uint64_t count = uint64_t(1) << 60;
+    out.seekp( 32 );
+    out.write( reinterpret_cast<const char *>( &count ), sizeof(count) );
+  }
+  EXPECT_FALSE( (bool)VideoIndex::load( video ) );
+}
+
+TEST( VideoIndex, UnusableTimestamps ) {
+  EXPECT_FALSE( VideoIndex( std::vector<double>( 10, 0.0 ) ).hasTimestamps() );
+  EXPECT_FALSE( VideoIndex().hasTimestamps() );
+  EXPECT_EQ( VideoIndex().frameAt( 0 ), -1 );
+}
+
+TEST( VideoIndex, VideoSourceSeeksExactly ) {
+  ScratchDir scratch( "videoio-index" );
+  const std::string video( ( scratch.path / "clip.avi" ).string() );
+  const int numFrames = ClipFrames;
+
+  if( !writeClip( video, numFrames ) ) return;
+
+  VideoSource source( video );
+  ASSERT_TRUE( source.useIndex() );
+  ASSERT_EQ( source.numFrames(), numFrames );
+  ASSERT_TRUE( fs::exists( VideoIndex::sidecarPath( video ) ) );
+
+  // Backwards, short and long forward skips, and the last frame
+  for( int frame : { 50, 10, 11, 12, 40, 85, 5, 89, 0 } ) {
+    cv::Mat image;
+    ASSERT_TRUE( source.getFrame( frame, image ) ) << "frame " << frame;
+    EXPECT_EQ( frameNumber( image ), frame );
+    EXPECT_EQ( source.frameNum(), frame + 1 );
+  }
+
+  // Sequential reads continue from the seek
+  source.skipTo( 70 );
+  for( int frame = 70; frame < numFrames; ++frame ) {
+    ASSERT_TRUE( source.grab() );
+    cv::Mat image;
+    source.getImage( image );
+    EXPECT_EQ( frameNumber( image ), frame );
+  }
+  EXPECT_FALSE( source.grab() );
+
+  cv::Mat image;
+  EXPECT_FALSE( source.getFrame( numFrames, image ) );
+
+  // A second source reuses the sidecar
+  VideoSource again( video );
+  ASSERT_TRUE( again.useIndex() );
+  ASSERT_EQ( again.numFrames(), numFrames );
+}
+
+TEST( VideoIndex, VideoSourceFrameStep ) {
+  ScratchDir scratch( "videoio-index" );
+  const std::string video( ( scratch.path / "clip.avi" ).string() );
+  const int numFrames = ClipFrames;
+
+  if( !writeClip( video, numFrames ) ) return;
+
+  // Unindexed, then indexed with steps which decode forward and which seek
+  const struct { int step; bool indexed; } runs[] = { { 7, false }, { 7, true }, { 40, true } };
+  for( const auto &run : runs ) {
+    const int step = run.step;
+
+    VideoSource source( video );
+    if( run.indexed ) ASSERT_TRUE( source.useIndex() );
+
+    source.skipTo( 3 );
+    source.setFrameStep( step );
+
+    int frame = 3;
+    for( ; frame < numFrames; frame += step ) {
+      ASSERT_TRUE( source.grab() ) << "step " << step << " frame " << frame;
+      cv::Mat image;
+      source.getImage( image );
+      EXPECT_EQ( frameNumber( image ), frame );
+      EXPECT_NEAR( source.timestamp(), frame * 1000.0 / ClipFPS, 1.0 );
+    }
+    EXPECT_FALSE( source.grab() );
+  }
+}
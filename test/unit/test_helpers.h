@@ -0,0 +1,96 @@
+
+#pragma once
+
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "libvideoio/ImageSource.h"
+#include "libvideoio/MapCache.h"
+
+namespace fs = boost::filesystem;
+
+namespace libvideoio {
+namespace test {
+
+// A new temporary directory, removed with everything in it at the end of
+// the test
+class ScratchDir {
+public:
+  ScratchDir( const std::string &prefix = "videoio" )
+    : path( fs::temp_directory_path() / fs::unique_path( prefix + "-%%%%-%%%%" ) )
+  { fs::create_directories( path ); }
+
+  ~ScratchDir()
+  { fs::remove_all( path ); }
+
+  fs::path path;
+};
+
+// Points the MapCache at an empty scratch directory for one test
+class ScopedCacheDir : public ScratchDir {
+public:
+  ScopedCacheDir()
+    : ScratchDir( "videoio-mapcache" ),
+      previous( MapCache::directory() )
+  { MapCache::setDirectory( path.string() ); }
+
+  ~ScopedCacheDir()
+  { MapCache::setDirectory( previous ); }
+
+  std::string previous;
+};
+
+// Writes numFiles PNGs where every pixel of file n is n
+class NumberedFiles : public ScratchDir {
+public:
+  NumberedFiles( int numFiles )
+    : ScratchDir( "videoio-files" )
+  {
+    for( int n = 0; n < numFiles; ++n ) {
+      char name[32];
+      snprintf( name, sizeof(name), "%04d.png", n );
+      paths.push_back( path / name );
+      cv::imwrite( paths.back().string(), cv::Mat( 24, 32, CV_8UC1, cv::Scalar(n) ) );
+    }
+  }
+
+  std::vector<fs::path> paths;
+};
+
+static const int ClipFrames = 90;
+static const int ClipFPS = 30;
+
+// Frame n of the test clip is a flat image of level 10 + 2n
+inline int frameNumber( const cv::Mat &image )
+{
+  return cvRound( ( cv::mean( image )[0] - 10 ) / 2 );
+}
+
+// Writes the 64x48 MJPEG test clip, returning false if this OpenCV build
+// can't write it or read it back
+inline bool writeClip( const std::string &video, int numFrames = ClipFrames )
+{
+  {
+    cv::VideoWriter writer( video, cv::VideoWriter::fourcc('M','J','P','G'), ClipFPS, cv::Size( 64, 48 ) );
+    if( !writer.isOpened() ) {
+      std::cout << "No MJPEG encoder in this OpenCV build, skipping" << std::endl;
+      return false;
+    }
+
+    for( int n = 0; n < numFrames; ++n ) writer.write( cv::Mat( 48, 64, CV_8UC3, cv::Scalar::all( 10 + 2*n ) ) );
+  }
+
+  if( !VideoSource( video ).isOpened() ) {
+    std::cout << "Unable to decode MJPEG with this OpenCV build, skipping" << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+}
+}